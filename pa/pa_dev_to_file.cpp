@@ -1,8 +1,14 @@
 #include <iostream>
-#include <vector>
 #include <sndfile.h>
 #include <portaudio.h>
 
+#include "pa_sample_format.h"
+
+struct CaptureContext {
+    SNDFILE *sndfile;
+    PaSampleFormat format;
+};
+
 // 回调函数用于从音频设备捕获数据
 static int captureCallback(
     const void *inputBuffer, // 
@@ -12,19 +18,16 @@ static int captureCallback(
     PaStreamCallbackFlags statusFlags, //
     void *userData // 
 ) {
-    SF_INFO *sfinfo = (SF_INFO *)userData;
-    const float *in = (const float *)inputBuffer;
-    std::vector<float> buffer(framesPerBuffer * sfinfo->channels);
-    
-    // 将输入缓冲区数据写入文件
-    std::copy(in, in + framesPerBuffer * sfinfo->channels, buffer.begin());
-    sf_writef_float((SNDFILE *)userData, buffer.data(), framesPerBuffer);
+    CaptureContext *ctx = (CaptureContext *)userData;
+
+    // 将输入缓冲区数据直接写入文件, int16 模式下 sf_writef_short 原样落盘
+    writeFrames(ctx->sndfile, ctx->format, inputBuffer, framesPerBuffer);
     
     return paContinue;
 }
 
 // 捕获 dev
-void captureFromDeviceToFile(const char *filename) {
+void captureFromDeviceToFile(const char *filename, bool force_float) {
     SF_INFO sfinfo;
     sfinfo.samplerate = 44100;  // 设定采样率
     sfinfo.channels = 2;        // 立体声
@@ -43,9 +46,24 @@ void captureFromDeviceToFile(const char *filename) {
         return;
     }
 
+    PaStreamParameters inputParameters;
+    inputParameters.device = Pa_GetDefaultInputDevice();
+    if (inputParameters.device == paNoDevice) {
+        std::cerr << "No default input device" << std::endl;
+        return;
+    }
+    inputParameters.channelCount = sfinfo.channels;
+    inputParameters.suggestedLatency = Pa_GetDeviceInfo(inputParameters.device)->defaultLowInputLatency;
+    inputParameters.hostApiSpecificStreamInfo = NULL;
+
+    CaptureContext ctx;
+    ctx.sndfile = sndfile;
+    ctx.format = chooseSampleFormat(&inputParameters, NULL, sfinfo.samplerate, force_float);
+    std::cout << "Sample format: " << sampleFormatName(ctx.format) << std::endl;
+
     PaStream *stream;
-    err = Pa_OpenDefaultStream(&stream, sfinfo.channels, 0, paFloat32, sfinfo.samplerate,
-                               256, captureCallback, (void *)sndfile);
+    err = Pa_OpenStream(&stream, &inputParameters, NULL, sfinfo.samplerate,
+                        256, paClipOff, captureCallback, &ctx);
     if (err != paNoError) {
         std::cerr << "Failed to open PortAudio stream: " << Pa_GetErrorText(err) << std::endl;
         return;
@@ -69,8 +87,9 @@ void captureFromDeviceToFile(const char *filename) {
     sf_close(sndfile);
 }
 
-int main() {
+// 用法: pa_dev_to_file [-f]   -f 强制 float32
+int main(int argc, char *argv[]) {
     const char *outputFile = "output_audio.wav";
-    captureFromDeviceToFile(outputFile);
+    captureFromDeviceToFile(outputFile, forceFloat(argc, argv));
     return 0;
 }
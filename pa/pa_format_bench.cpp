@@ -0,0 +1,100 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+#include <cstdlib>
+#include <sndfile.h>
+#include <portaudio.h>
+
+#include "pa_sample_format.h"
+
+// int16 / float32 路径单流 CPU 开销对比, 不需要音频设备
+// float 路径: sf_readf_float (int16 -> float) + 设备侧 float -> int16, 与 PortAudio 打开 int16 设备时的转换一致
+// int16 路径: sf_readf_short, 无转换
+
+#define FRAMES_PER_BUFFER 256
+
+static double cpuSeconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 模拟设备端的 float -> int16 转换
+static void floatToDevice(const float *src, short *dst, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        float v = src[i] * 32767.0f;
+        if (v > 32767.0f) {
+            v = 32767.0f;
+        }
+        else if (v < -32768.0f) {
+            v = -32768.0f;
+        }
+        dst[i] = (short)v;
+    }
+}
+
+// 返回处理 passes 遍文件消耗的 CPU 秒数, audio_seconds 为对应的音频时长
+static double runPass(const char *filename, PaSampleFormat fmt, int passes, double &audio_seconds)
+{
+    SF_INFO sfinfo;
+    sfinfo.format = 0;
+    SNDFILE *sndfile = sf_open(filename, SFM_READ, &sfinfo);
+    if (!sndfile) {
+        std::cerr << "Failed to open audio file: " << sf_strerror(sndfile) << std::endl;
+        std::exit(1);
+    }
+
+    size_t samples = (size_t)FRAMES_PER_BUFFER * sfinfo.channels;
+    std::vector<float> fbuf(samples);
+    std::vector<short> sbuf(samples);
+    std::vector<short> device(samples);
+    sf_count_t total_frames = 0;
+
+    double start = cpuSeconds();
+    for (int p = 0; p < passes; ++p) {
+        sf_seek(sndfile, 0, SEEK_SET);
+        sf_count_t n;
+        if (fmt == paInt16) {
+            while ((n = readFrames(sndfile, fmt, sbuf.data(), FRAMES_PER_BUFFER)) > 0) {
+                total_frames += n;
+            }
+        }
+        else {
+            while ((n = readFrames(sndfile, fmt, fbuf.data(), FRAMES_PER_BUFFER)) > 0) {
+                floatToDevice(fbuf.data(), device.data(), n * sfinfo.channels);
+                total_frames += n;
+            }
+        }
+    }
+    double cpu = cpuSeconds() - start;
+
+    audio_seconds = (double)total_frames / sfinfo.samplerate;
+    sf_close(sndfile);
+    return cpu;
+}
+
+// 用法: pa_format_bench [file.wav] [passes]
+int main(int argc, char *argv[])
+{
+    const char *audioFile = argc > 1 ? argv[1] : "16k16bit.wav";
+    int passes = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    const PaSampleFormat formats[] = {paFloat32, paInt16};
+    double cpu_per_audio_sec[2];
+    for (int i = 0; i < 2; ++i) {
+        double audio_seconds = 0;
+        double cpu = runPass(audioFile, formats[i], passes, audio_seconds);
+        cpu_per_audio_sec[i] = cpu / audio_seconds;
+        std::cout << sampleFormatName(formats[i]) << ": "
+                  << cpu * 1e3 << " ms CPU for " << audio_seconds << " s audio, "
+                  << cpu_per_audio_sec[i] * 1e6 << " us CPU per stream-second" << std::endl;
+    }
+
+    double saved = cpu_per_audio_sec[0] - cpu_per_audio_sec[1];
+    std::cout << "saved per stream: " << saved * 1e6 << " us CPU per second of audio ("
+              << saved * 100 << "% of one core)" << std::endl;
+    return 0;
+}
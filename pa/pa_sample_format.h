@@ -0,0 +1,78 @@
+#ifndef _PA_SAMPLE_FORMAT_H_
+#define _PA_SAMPLE_FORMAT_H_
+
+#include <cstring>
+#include <portaudio.h>
+#include <sndfile.h>
+
+// 采样格式选择
+// 素材与 voip 端口都是 16bit PCM, 优先用 paInt16 打开流并用 sf_*_short 读写,
+// 省掉 int16 -> float -> int16 两次转换; 仅当设备不支持 paInt16 时回退到 paFloat32
+
+// 命令行带 -f 时强制使用 float, 用于对比
+inline bool
+forceFloat(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-f") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 依次尝试 paInt16 / paFloat32, 返回设备接受的格式, 并写回到 in/out 参数中
+inline PaSampleFormat
+chooseSampleFormat(PaStreamParameters *in, PaStreamParameters *out, double sample_rate, bool force_float = false)
+{
+    if (!force_float) {
+        if (in) {
+            in->sampleFormat = paInt16;
+        }
+        if (out) {
+            out->sampleFormat = paInt16;
+        }
+        if (Pa_IsFormatSupported(in, out, sample_rate) == paFormatIsSupported) {
+            return paInt16;
+        }
+    }
+    if (in) {
+        in->sampleFormat = paFloat32;
+    }
+    if (out) {
+        out->sampleFormat = paFloat32;
+    }
+    return paFloat32;
+}
+
+inline const char *
+sampleFormatName(PaSampleFormat fmt)
+{
+    return fmt == paInt16 ? "int16" : "float32";
+}
+
+inline sf_count_t
+readFrames(SNDFILE *sndfile, PaSampleFormat fmt, void *dst, sf_count_t frames)
+{
+    if (fmt == paInt16) {
+        return sf_readf_short(sndfile, static_cast<short *>(dst), frames);
+    }
+    return sf_readf_float(sndfile, static_cast<float *>(dst), frames);
+}
+
+inline sf_count_t
+writeFrames(SNDFILE *sndfile, PaSampleFormat fmt, const void *src, sf_count_t frames)
+{
+    if (fmt == paInt16) {
+        return sf_writef_short(sndfile, static_cast<const short *>(src), frames);
+    }
+    return sf_writef_float(sndfile, static_cast<const float *>(src), frames);
+}
+
+inline size_t
+sampleBytes(PaSampleFormat fmt)
+{
+    return fmt == paInt16 ? sizeof(short) : sizeof(float);
+}
+
+#endif // _PA_SAMPLE_FORMAT_H_
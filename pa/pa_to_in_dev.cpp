@@ -2,24 +2,32 @@
 #include <portaudio.h>
 #include <sndfile.h>
 
+#include "pa_sample_format.h"
+
 #define SAMPLE_RATE 44100
 #define NUM_CHANNELS 2
 #define FRAMES_PER_BUFFER 256
 
+struct PlaybackContext {
+    SNDFILE *sndfile;
+    PaSampleFormat format;
+};
+
 // 音频回调函数
 static int audioCallback(const void *inputBuffer, void *outputBuffer, unsigned long frameCount,
     const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags,
     void *userData
 ) {
-    SNDFILE *sndfile = (SNDFILE *)userData;
-    sf_count_t framesRead = sf_readf_float(sndfile, (float *)outputBuffer, frameCount);
-    if (framesRead < frameCount) {
+    PlaybackContext *ctx = (PlaybackContext *)userData;
+    sf_count_t framesRead = readFrames(ctx->sndfile, ctx->format, outputBuffer, frameCount);
+    if (framesRead < (sf_count_t)frameCount) {
         return paComplete;  // 如果文件读完了，则结束
     }
     return paContinue;
 }
 
-int main() {
+// 用法: pa_to_in_dev [-f]   -f 强制 float32
+int main(int argc, char *argv[]) {
     PaError err;
 
     // 打开 WAV 文件
@@ -45,19 +53,24 @@ int main() {
     PaStreamParameters outputParameters;
     outputParameters.device = outputDeviceIndex;
     outputParameters.channelCount = 2;  // 例如立体声
-    outputParameters.sampleFormat = paFloat32;  // 32位浮动点数
     outputParameters.suggestedLatency = Pa_GetDeviceInfo(outputDeviceIndex)->defaultLowOutputLatency;
     outputParameters.hostApiSpecificStreamInfo = NULL;
 
+    // 优先 16位整数, 设备不支持时回退 32位浮动点数
+    PlaybackContext ctx;
+    ctx.sndfile = sndfile;
+    ctx.format = chooseSampleFormat(NULL, &outputParameters, SAMPLE_RATE, forceFloat(argc, argv));
+    std::cout << "Sample format: " << sampleFormatName(ctx.format) << std::endl;
+
     // 打开流，使用 Loopback 设备作为输出
     err = Pa_OpenStream(&stream,
                         NULL, // 输入设备为空
                         &outputParameters, // 输出设备为 2 通道
-                        SAMPLE_RATE, // 音频格式为浮动点
+                        SAMPLE_RATE,
                         FRAMES_PER_BUFFER,
                         paClipOff,  // 禁用自动剪辑
                         audioCallback,
-                        sndfile);
+                        &ctx);
     if (err != paNoError) {
         std::cerr << "PortAudio stream open error: " << Pa_GetErrorText(err) << std::endl;
         return 1;
@@ -1,8 +1,15 @@
 #include <iostream>
-#include <vector>
 #include <sndfile.h>
 #include <portaudio.h>
 
+#include "pa_sample_format.h"
+
+struct PlaybackContext {
+    SNDFILE *sndfile;
+    int channels;
+    PaSampleFormat format;
+};
+
 // 回调函数用于将音频数据输出到音频设备
 static int audioCallback(
     const void *inputBuffer,
@@ -12,23 +19,21 @@ static int audioCallback(
     PaStreamCallbackFlags statusFlags,
     void *userData
 ) {
-    SF_INFO *sfinfo = (SF_INFO *)userData;
-    float *out = (float *)outputBuffer;
-    static std::vector<float> buffer(framesPerBuffer * sfinfo->channels);
-    
-    // 读取文件的音频数据
-    sf_count_t framesRead = sf_readf_float((SNDFILE *)userData, buffer.data(), framesPerBuffer);
-    if (framesRead < framesPerBuffer) {
-        std::fill(out, out + framesPerBuffer * sfinfo->channels, 0); // 用零填充，表示音频流结束
+    PlaybackContext *ctx = (PlaybackContext *)userData;
+
+    // 直接读入输出缓冲区, int16 模式下没有格式转换
+    sf_count_t framesRead = readFrames(ctx->sndfile, ctx->format, outputBuffer, framesPerBuffer);
+    if (framesRead < (sf_count_t)framesPerBuffer) {
+        // 用零填充，表示音频流结束
+        size_t frameBytes = sampleBytes(ctx->format) * ctx->channels;
+        std::memset((char *)outputBuffer + framesRead * frameBytes, 0, (framesPerBuffer - framesRead) * frameBytes);
+        return paComplete;
     }
-    
-    // 将数据传递给输出缓冲区
-    std::copy(buffer.begin(), buffer.begin() + framesRead * sfinfo->channels, out);
     return paContinue;
 }
 
 // 流式音频 -> 音频设备
-void streamAudioToDevice(const char *filename) {
+void streamAudioToDevice(const char *filename, bool force_float) {
     SNDFILE *sndfile;
     SF_INFO sfinfo;
     if (!(sndfile = sf_open(filename, SFM_READ, &sfinfo))) {
@@ -43,9 +48,25 @@ void streamAudioToDevice(const char *filename) {
         return;
     }
 
+    PaStreamParameters outputParameters;
+    outputParameters.device = Pa_GetDefaultOutputDevice();
+    if (outputParameters.device == paNoDevice) {
+        std::cerr << "No default output device" << std::endl;
+        return;
+    }
+    outputParameters.channelCount = sfinfo.channels;
+    outputParameters.suggestedLatency = Pa_GetDeviceInfo(outputParameters.device)->defaultLowOutputLatency;
+    outputParameters.hostApiSpecificStreamInfo = NULL;
+
+    PlaybackContext ctx;
+    ctx.sndfile = sndfile;
+    ctx.channels = sfinfo.channels;
+    ctx.format = chooseSampleFormat(NULL, &outputParameters, sfinfo.samplerate, force_float);
+    std::cout << "Sample format: " << sampleFormatName(ctx.format) << std::endl;
+
     PaStream *stream;
-    err = Pa_OpenDefaultStream(&stream, 0, sfinfo.channels, paFloat32, sfinfo.samplerate,
-                               256, audioCallback, (void *)sndfile);
+    err = Pa_OpenStream(&stream, NULL, &outputParameters, sfinfo.samplerate,
+                        256, paClipOff, audioCallback, &ctx);
     if (err != paNoError) {
         std::cerr << "Failed to open PortAudio stream: " << Pa_GetErrorText(err) << std::endl;
         return;
@@ -69,8 +90,14 @@ void streamAudioToDevice(const char *filename) {
     sf_close(sndfile);
 }
 
-int main() {
+// 用法: pa_wav_to_dev [-f] [file.wav]   -f 强制 float32
+int main(int argc, char *argv[]) {
     const char *audioFile = "/home/cells/dev/c-project/pj-demo/pa/16k16bit.wav";
-    streamAudioToDevice(audioFile);
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] != '-') {
+            audioFile = argv[i];
+        }
+    }
+    streamAudioToDevice(audioFile, forceFloat(argc, argv));
     return 0;
 }
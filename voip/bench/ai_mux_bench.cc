@@ -0,0 +1,328 @@
+// AI 后端连接方式对比: 所有呼叫共用的多路复用连接 (VAiMux) 对比每个请求新建一条 TCP 连接
+// VAiStandin (回复无延迟) 在子进程里运行, 每路呼叫一个线程闭环发送: 收齐一轮回复再发下一个分片
+// 输出请求速率, 请求时延 (均值 / p50 / p99), 后端接受的连接数, 以及每个请求的客户端进程 CPU (不含替身)
+//
+// 用法: ai_mux_bench [calls] [requests_per_call] [chunk_ms] [mux_connections]
+
+#include "vaiclient.h"
+#include "vaistandin.h"
+#include "vaiwire.h"
+#include "vconfig.h"
+#include "vlog.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const unsigned CLOCK_RATE = 8000;
+
+int64_t
+cpuNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+struct Result
+{
+    std::vector<double> latency_us;
+    double wall_s = 0;
+    double cpu_s = 0;
+    uint64_t accepts = 0;
+    uint64_t failed = 0;
+};
+
+voip::VAiChunk
+makeChunk(unsigned chunk_ms, uint32_t stream)
+{
+    voip::VAiChunk chunk;
+    chunk.samples.assign(CLOCK_RATE * chunk_ms / 1000, 100);
+    chunk.clock_rate = CLOCK_RATE;
+    chunk.stream = stream;
+    chunk.captured = std::chrono::steady_clock::now();
+    return chunk;
+}
+
+// 共用连接: 经 ai.backend = mux 的 VAiClient 发送
+void
+runMux(const voip::VConfig &cfg, unsigned calls, unsigned requests, unsigned chunk_ms, Result &result)
+{
+    voip::VAiClient client;
+    client.start(cfg);
+    // 等连接建立, 否则首批请求会被丢弃
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::vector<std::vector<double>> latency(calls);
+    std::vector<uint64_t> failed(calls, 0);
+    std::vector<std::thread> threads;
+    int64_t cpu_begin = cpuNs();
+    auto begin = std::chrono::steady_clock::now();
+    // 超时放弃的请求之后仍可能回调, 等待状态由回调共同持有
+    struct Wait
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done = false;
+    };
+    for (unsigned c = 0; c < calls; ++c) {
+        threads.emplace_back([&, c]() {
+            for (unsigned r = 0; r < requests; ++r) {
+                std::shared_ptr<Wait> wait = std::make_shared<Wait>();
+                auto sent = std::chrono::steady_clock::now();
+                bool queued = client.send(makeChunk(chunk_ms, c), [wait](voip::VAiChunk &&packet, const voip::VAiTiming &) {
+                    if (packet.last) {
+                        std::lock_guard<std::mutex> lock(wait->mutex);
+                        wait->done = true;
+                        wait->cv.notify_one();
+                    }
+                });
+                if (!queued) {
+                    ++failed[c];
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(wait->mutex);
+                if (!wait->cv.wait_for(lock, std::chrono::seconds(2), [&]() { return wait->done; })) {
+                    ++failed[c];
+                    continue;
+                }
+                latency[c].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count());
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    result.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    result.cpu_s = (cpuNs() - cpu_begin) / 1e9;
+    client.stop();
+
+    for (unsigned c = 0; c < calls; ++c) {
+        result.latency_us.insert(result.latency_us.end(), latency[c].begin(), latency[c].end());
+        result.failed += failed[c];
+    }
+}
+
+// 每个请求一条连接: 连接, 发出请求, 读到最后一个回复包后关闭
+bool
+requestOnce(uint16_t port, unsigned chunk_ms, uint32_t stream, uint32_t request)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    voip::VAiWireHeader header;
+    header.stream = stream;
+    header.request = request;
+    header.type = voip::VAiWireHeader::REQUEST;
+    header.value = CLOCK_RATE;
+    std::vector<uint8_t> frame;
+    voip::aiWireEncode(header, makeChunk(chunk_ms, stream), frame);
+    bool ok = send(fd, frame.data(), frame.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(frame.size());
+
+    std::vector<uint8_t> rx;
+    size_t offset = 0;
+    bool last = false;
+    while (ok && !last) {
+        uint8_t buf[16 * 1024];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            ok = false;
+            break;
+        }
+        rx.insert(rx.end(), buf, buf + n);
+        voip::VAiWireHeader in;
+        while (voip::aiWireHeader(rx.data() + offset, rx.size() - offset, in)
+               && rx.size() - offset >= voip::VAiWireHeader::SIZE + in.length) {
+            offset += voip::VAiWireHeader::SIZE + in.length;
+            last = last || (in.type == voip::VAiWireHeader::RESPONSE && (in.flags & voip::VAiWireHeader::LAST));
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+void
+runPerRequest(uint16_t port, unsigned calls, unsigned requests, unsigned chunk_ms, Result &result)
+{
+    std::vector<std::vector<double>> latency(calls);
+    std::vector<uint64_t> failed(calls, 0);
+    std::vector<std::thread> threads;
+    int64_t cpu_begin = cpuNs();
+    auto begin = std::chrono::steady_clock::now();
+    for (unsigned c = 0; c < calls; ++c) {
+        threads.emplace_back([&, c]() {
+            for (unsigned r = 0; r < requests; ++r) {
+                auto sent = std::chrono::steady_clock::now();
+                if (!requestOnce(port, chunk_ms, c, r + 1)) {
+                    ++failed[c];
+                    continue;
+                }
+                latency[c].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count());
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    result.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    result.cpu_s = (cpuNs() - cpu_begin) / 1e9;
+
+    for (unsigned c = 0; c < calls; ++c) {
+        result.latency_us.insert(result.latency_us.end(), latency[c].begin(), latency[c].end());
+        result.failed += failed[c];
+    }
+}
+
+// 替身子进程: 启动后把端口写回, 每收到一个字节回报已接受的连接数, 命令管道关闭时退出
+struct Standin
+{
+    pid_t pid = -1;
+    int cmd = -1;
+    int reply = -1;
+    uint16_t port = 0;
+
+    bool
+    start(const voip::VConfig &cfg)
+    {
+        int to_child[2];
+        int to_parent[2];
+        if (pipe(to_child) != 0 || pipe(to_parent) != 0) {
+            return false;
+        }
+        pid = fork();
+        if (pid < 0) {
+            return false;
+        }
+        if (pid == 0) {
+            close(to_child[1]);
+            close(to_parent[0]);
+            voip::VLog::start(VLOG_LEVEL_WARN);
+            voip::VAiStandin standin;
+            uint16_t bound = standin.start("127.0.0.1", 0, cfg);
+            bool ok = write(to_parent[1], &bound, sizeof(bound)) == sizeof(bound);
+            char c;
+            while (ok && read(to_child[0], &c, 1) == 1) {
+                uint64_t accepted = standin.accepted();
+                ok = write(to_parent[1], &accepted, sizeof(accepted)) == sizeof(accepted);
+            }
+            standin.stop();
+            voip::VLog::stop();
+            _exit(0);
+        }
+        close(to_child[0]);
+        close(to_parent[1]);
+        cmd = to_child[1];
+        reply = to_parent[0];
+        return read(reply, &port, sizeof(port)) == sizeof(port) && port != 0;
+    }
+
+    uint64_t
+    accepted()
+    {
+        uint64_t n = 0;
+        char c = 'a';
+        if (write(cmd, &c, 1) != 1 || read(reply, &n, sizeof(n)) != sizeof(n)) {
+            return 0;
+        }
+        return n;
+    }
+
+    void
+    stop()
+    {
+        if (pid > 0) {
+            close(cmd);
+            close(reply);
+            waitpid(pid, nullptr, 0);
+            pid = -1;
+        }
+    }
+};
+
+void
+report(const char *name, Result &result)
+{
+    std::vector<double> &l = result.latency_us;
+    std::sort(l.begin(), l.end());
+    double mean = 0;
+    for (double v : l) {
+        mean += v;
+    }
+    mean = l.empty() ? 0 : mean / l.size();
+    double p50 = l.empty() ? 0 : l[l.size() / 2];
+    double p99 = l.empty() ? 0 : l[std::min(l.size() - 1, l.size() * 99 / 100)];
+    std::printf("%-12s %8.0f req/s, latency mean %7.1f us p50 %7.1f us p99 %8.1f us, "
+                "%6llu accepts, cpu %6.1f us/req, %llu failed\n",
+                name, l.size() / result.wall_s, mean, p50, p99, static_cast<unsigned long long>(result.accepts),
+                result.cpu_s * 1e6 / std::max<size_t>(1, l.size()), static_cast<unsigned long long>(result.failed));
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned calls = argc > 1 ? std::atoi(argv[1]) : 50;
+    unsigned requests = argc > 2 ? std::atoi(argv[2]) : 200;
+    unsigned chunk_ms = argc > 3 ? std::atoi(argv[3]) : 500;
+    unsigned connections = argc > 4 ? std::atoi(argv[4]) : 1;
+
+    voip::VConfig cfg;
+    cfg.set("ai.echo_delay_ms", "0");
+    cfg.set("ai.backend", "mux");
+    cfg.set("ai.mux.connections", std::to_string(connections));
+
+    // 在起任何线程之前 fork
+    Standin standin;
+    if (!standin.start(cfg)) {
+        std::fprintf(stderr, "cannot start the AI stand-in\n");
+        standin.stop();
+        return 1;
+    }
+    uint16_t port = standin.port;
+    voip::VLog::start(VLOG_LEVEL_WARN);
+    cfg.set("ai.mux.port", std::to_string(port));
+
+    std::printf("%u calls x %u requests, %u ms pcm chunks at %u Hz, %u mux connections\n",
+                calls, requests, chunk_ms, CLOCK_RATE, connections);
+
+    Result mux;
+    uint64_t accepts = standin.accepted();
+    runMux(cfg, calls, requests, chunk_ms, mux);
+    mux.accepts = standin.accepted() - accepts;
+    report("mux", mux);
+
+    Result per_request;
+    accepts = standin.accepted();
+    runPerRequest(port, calls, requests, chunk_ms, per_request);
+    per_request.accepts = standin.accepted() - accepts;
+    report("per-request", per_request);
+
+    standin.stop();
+    voip::VLog::stop();
+    return 0;
+}
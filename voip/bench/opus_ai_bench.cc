@@ -0,0 +1,132 @@
+// AI 链路 Opus 编解码开销: 每路呼叫一对 VAiEncoder / VAiDecoder, 按线上流程以 500 ms 分片编码再解码
+// 对若干码率输出每秒音频的编码/解码 CPU 时间 (线程 CPU 时钟), 单核可承载的路数, 以及相对 PCM 节省的带宽
+//
+// 用法: opus_ai_bench [seconds] [calls] [complexity] [file.pcm]
+//   file.pcm 为 8 kHz 16 bit 单声道裸 PCM (如 recv.pcm), 省略时合成带停顿的类语音信号
+
+#include "vaicodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const unsigned CLOCK_RATE = 8000;
+const unsigned CHUNK_MS = 500;
+
+int64_t
+threadCpuNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// 基频缓慢变化的谐波加噪声, 每秒约 300 ms 停顿, 近似通话中的语音
+std::vector<int16_t>
+synthesize(unsigned seconds)
+{
+    std::vector<int16_t> out(static_cast<size_t>(seconds) * CLOCK_RATE);
+    double phase = 0;
+    unsigned seed = 1;
+    for (size_t i = 0; i < out.size(); ++i) {
+        double t = static_cast<double>(i) / CLOCK_RATE;
+        bool pause = std::fmod(t, 1.0) > 0.7;
+        double f0 = 120 + 40 * std::sin(2 * M_PI * 0.5 * t);
+        phase += 2 * M_PI * f0 / CLOCK_RATE;
+        double v = 0;
+        for (int h = 1; h <= 8; ++h) {
+            v += std::sin(h * phase) / h;
+        }
+        seed = seed * 1103515245 + 12345;
+        double noise = static_cast<int>((seed >> 16) & 0x7fff) / 32768.0 - 0.5;
+        out[i] = static_cast<int16_t>(pause ? noise * 200 : v * 6000 + noise * 600);
+    }
+    return out;
+}
+
+bool
+loadPcm(const char *path, std::vector<int16_t> &samples)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    samples.resize(data.size() / sizeof(int16_t));
+    std::copy(data.begin(), data.begin() + samples.size() * sizeof(int16_t), reinterpret_cast<char *>(samples.data()));
+    return !samples.empty();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned seconds = argc > 1 ? std::atoi(argv[1]) : 60;
+    unsigned calls = argc > 2 ? std::atoi(argv[2]) : 8;
+    int complexity = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    std::vector<int16_t> audio;
+    if (argc > 4) {
+        if (!loadPcm(argv[4], audio)) {
+            std::fprintf(stderr, "cannot read %s\n", argv[4]);
+            return 1;
+        }
+    }
+    else {
+        audio = synthesize(seconds);
+    }
+    double audio_s = static_cast<double>(audio.size()) / CLOCK_RATE;
+    size_t chunk_samples = CLOCK_RATE * CHUNK_MS / 1000;
+    size_t chunks = audio.size() / chunk_samples;
+
+    std::printf("%u calls x %.1f s of audio, %u ms chunks, complexity %d; pcm is %.1f kbit/s\n",
+                calls, audio_s, CHUNK_MS, complexity, CLOCK_RATE * 16 / 1000.0);
+    const int bitrates[] = {8000, 12000, 16000, 24000};
+    for (int bitrate : bitrates) {
+        voip::VAiCodecConfig cfg;
+        cfg.opus = true;
+        cfg.bitrate = bitrate;
+        cfg.complexity = complexity;
+
+        std::vector<std::unique_ptr<voip::VAiEncoder>> encoders;
+        std::vector<std::unique_ptr<voip::VAiDecoder>> decoders;
+        for (unsigned c = 0; c < calls; ++c) {
+            encoders.emplace_back(new voip::VAiEncoder(CLOCK_RATE, cfg));
+            decoders.emplace_back(new voip::VAiDecoder(CLOCK_RATE));
+        }
+
+        int64_t encode_ns = 0;
+        int64_t decode_ns = 0;
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < chunks; ++i) {
+            for (unsigned c = 0; c < calls; ++c) {
+                voip::VAiChunk chunk;
+                chunk.samples.assign(audio.begin() + i * chunk_samples, audio.begin() + (i + 1) * chunk_samples);
+                int64_t t0 = threadCpuNs();
+                encoders[c]->encode(chunk);
+                int64_t t1 = threadCpuNs();
+                bytes += chunk.payload.size();
+                decoders[c]->decode(chunk);
+                int64_t t2 = threadCpuNs();
+                encode_ns += t1 - t0;
+                decode_ns += t2 - t1;
+            }
+        }
+
+        double call_s = chunks * CHUNK_MS / 1000.0 * calls;
+        double enc_us = encode_ns / 1000.0 / call_s;
+        double dec_us = decode_ns / 1000.0 / call_s;
+        double kbps = bytes * 8 / call_s / 1000;
+        std::printf("opus %5d bit/s: encode %7.1f us/s, decode %7.1f us/s per call (%6.0f calls/core), "
+                    "%5.1f kbit/s, %4.1f%% of pcm\n",
+                    bitrate, enc_us, dec_us, 1e6 / (enc_us + dec_us), kbps, kbps * 100 / (CLOCK_RATE * 16 / 1000.0));
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+// 帧长对媒体回调开销的影响: 多路呼叫的 VAiProcessor / VAiPlayer 以虚拟时钟逐帧驱动, 与线上的会议桥回调相同
+// 对每个 ptime 输出回调线程的 CPU (每路每秒音频), 单次回调耗时, 以及包含 AI 工作线程在内的进程 CPU
+//
+// 用法: ptime_bench [calls] [seconds] [clock_rate]
+
+#include "vaiclient.h"
+#include "vaiport.h"
+#include "vconfig.h"
+#include "vlog.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <vector>
+
+namespace {
+
+int64_t
+cpuNs(clockid_t clock)
+{
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+struct Call
+{
+    std::unique_ptr<voip::VAiPlayer> player;
+    std::unique_ptr<voip::VAiProcessor> processor;
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned calls = argc > 1 ? std::atoi(argv[1]) : 200;
+    unsigned seconds = argc > 2 ? std::atoi(argv[2]) : 10;
+    unsigned clock_rate = argc > 3 ? std::atoi(argv[3]) : 8000;
+
+    voip::VConfig cfg;
+    cfg.set("ai.echo_delay_ms", "0");
+    voip::VLog::start(VLOG_LEVEL_WARN);
+
+    std::printf("%u calls x %u s at %u Hz\n", calls, seconds, clock_rate);
+    const unsigned ptimes[] = {10, 20, 40, 60};
+    for (unsigned ptime : ptimes) {
+        unsigned spf = clock_rate * ptime / 1000;
+        voip::VAiClient client;
+        client.start(cfg);
+
+        std::vector<Call> pairs(calls);
+        for (unsigned c = 0; c < calls; ++c) {
+            pairs[c].player.reset(new voip::VAiPlayer(clock_rate, spf));
+            pairs[c].processor.reset(new voip::VAiProcessor(client, *pairs[c].player, clock_rate));
+            pairs[c].processor->setChunking(voip::VChunkConfig::fromConfig(cfg));
+            unsigned generation = pairs[c].player->attach(static_cast<int>(c));
+            pairs[c].processor->attach(static_cast<int>(c), generation, std::chrono::steady_clock::now());
+        }
+
+        pj::MediaFrame in;
+        in.type = PJMEDIA_FRAME_TYPE_AUDIO;
+        in.size = spf * sizeof(int16_t);
+        in.buf.resize(in.size);
+        int16_t *pcm = reinterpret_cast<int16_t *>(in.buf.data());
+        unsigned seed = 1;
+        for (unsigned i = 0; i < spf; ++i) {
+            seed = seed * 1103515245 + 12345;
+            pcm[i] = static_cast<int16_t>((seed >> 16) & 0xfff);
+        }
+        pj::MediaFrame out;
+
+        uint64_t ticks = static_cast<uint64_t>(seconds) * 1000 / ptime;
+        int64_t thread_begin = cpuNs(CLOCK_THREAD_CPUTIME_ID);
+        int64_t process_begin = cpuNs(CLOCK_PROCESS_CPUTIME_ID);
+        for (uint64_t t = 0; t < ticks; ++t) {
+            for (Call &call : pairs) {
+                call.processor->onFrameReceived(in);
+                out.size = in.size;
+                call.player->onFrameRequested(out);
+            }
+        }
+        int64_t thread_ns = cpuNs(CLOCK_THREAD_CPUTIME_ID) - thread_begin;
+        int64_t process_ns = cpuNs(CLOCK_PROCESS_CPUTIME_ID) - process_begin;
+
+        for (Call &call : pairs) {
+            call.processor->reset();
+            call.player->reset();
+        }
+        client.stop();
+
+        double call_s = static_cast<double>(calls) * seconds;
+        uint64_t callbacks = ticks * calls * 2;
+        std::printf("ptime %2u ms: %7llu callbacks/s, callback cpu %7.1f us/s per call (%5.2f us per callback), "
+                    "process cpu %7.1f us/s per call, %4.1f%% of a core for %u calls\n",
+                    ptime, static_cast<unsigned long long>(calls * 2 * 1000 / ptime),
+                    thread_ns / 1000.0 / call_s, thread_ns / 1000.0 / callbacks,
+                    process_ns / 1000.0 / call_s, thread_ns / 1e7 / seconds, calls);
+    }
+
+    voip::VLog::stop();
+    return 0;
+}
@@ -0,0 +1,183 @@
+// 多路并发录音的写入开销: 按 20 ms 帧实时驱动 N 路录音, 对比
+//   stdio    每帧打开 - 追加 - 关闭, 即原来 VAudioMediaPort 写 recv.pcm 的方式
+//   fwrite   每路一个 FILE*, 由 stdio 缓冲
+//   threads  VRecordWriter, pwrite 线程池
+//   io_uring VRecordWriter, 批量提交
+// 输出每秒系统调用数 (stdio / fwrite 取 /proc/self/io 的 syscw 加上打开和关闭, VRecordWriter 取 voip_record_syscalls_total)
+// 和进程 CPU (含写入线程与 io_uring 内核线程)
+//
+// 用法: record_bench [recordings] [seconds] [dir]
+
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+#include "vrecorder.h"
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+const unsigned CLOCK_RATE = 8000;
+const unsigned FRAME_MS = 20;
+const unsigned FRAME_SAMPLES = CLOCK_RATE * FRAME_MS / 1000;
+
+double
+cpuSeconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+uint64_t
+writeSyscalls()
+{
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    uint64_t value;
+    while (io >> key >> value) {
+        if (key == "syscw:") {
+            return value;
+        }
+    }
+    return 0;
+}
+
+uint64_t
+writerSyscalls()
+{
+    voip::VMetrics &metrics = voip::VMetrics::instance();
+    const char *help = "System calls made by the recording writer";
+    return metrics.counter("voip_record_syscalls_total", help, "op=\"io_uring_enter\"").value()
+           + metrics.counter("voip_record_syscalls_total", help, "op=\"pwrite\"").value()
+           + metrics.counter("voip_record_syscalls_total", help, "op=\"fallocate\"").value();
+}
+
+// 每 20 ms 调用一次 frame(i), 按绝对时刻对齐
+template <typename Frame>
+void
+drive(unsigned frames, Frame frame)
+{
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (unsigned i = 0; i < frames; ++i) {
+        frame(i);
+        next.tv_nsec += FRAME_MS * 1000000;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            ++next.tv_sec;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+    }
+}
+
+void
+report(const char *name, unsigned seconds, uint64_t syscalls, double cpu, const std::string &dir, unsigned recordings)
+{
+    // 抽查一个文件的长度
+    struct stat st;
+    std::string sample = dir + "/" + name + "-0.wav";
+    long long size = stat(sample.c_str(), &st) == 0 ? static_cast<long long>(st.st_size) : -1;
+    std::printf("%-9s %10.0f syscalls/s %8.1f ms cpu/s %6.2f ms cpu/s per 100 recordings, file %lld bytes\n", name,
+                static_cast<double>(syscalls) / seconds, cpu * 1000 / seconds, cpu * 1000 / seconds * 100 / recordings,
+                size);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned recordings = argc > 1 ? std::atoi(argv[1]) : 300;
+    unsigned seconds = argc > 2 ? std::atoi(argv[2]) : 5;
+    std::string dir = argc > 3 ? argv[3] : "/tmp/record_bench";
+    mkdir(dir.c_str(), 0755);
+    unsigned frames = seconds * 1000 / FRAME_MS;
+
+    std::vector<int16_t> frame(FRAME_SAMPLES);
+    for (unsigned i = 0; i < FRAME_SAMPLES; ++i) {
+        frame[i] = static_cast<int16_t>(8000 * std::sin(i * 2 * M_PI * 400 / CLOCK_RATE));
+    }
+
+    voip::VLog::start(VLOG_LEVEL_WARN);
+    std::printf("%u recordings x %u s, %u Hz, %u ms frames\n", recordings, seconds, CLOCK_RATE, FRAME_MS);
+
+    {
+        uint64_t sys_before = writeSyscalls();
+        double cpu_before = cpuSeconds();
+        drive(frames, [&](unsigned) {
+            for (unsigned r = 0; r < recordings; ++r) {
+                std::fstream out(dir + "/stdio-" + std::to_string(r) + ".wav", std::ios::binary | std::ios::app);
+                out.write(reinterpret_cast<const char *>(frame.data()), frame.size() * sizeof(int16_t));
+            }
+        });
+        // 每帧另有 open 和 close
+        uint64_t syscalls = writeSyscalls() - sys_before + 2ull * frames * recordings;
+        report("stdio", seconds, syscalls, cpuSeconds() - cpu_before, dir, recordings);
+    }
+
+    {
+        uint64_t sys_before = writeSyscalls();
+        double cpu_before = cpuSeconds();
+        std::vector<FILE *> files(recordings);
+        for (unsigned r = 0; r < recordings; ++r) {
+            files[r] = std::fopen((dir + "/fwrite-" + std::to_string(r) + ".wav").c_str(), "wb");
+        }
+        drive(frames, [&](unsigned) {
+            for (FILE *f : files) {
+                std::fwrite(frame.data(), sizeof(int16_t), frame.size(), f);
+            }
+        });
+        for (FILE *f : files) {
+            std::fclose(f);
+        }
+        uint64_t syscalls = writeSyscalls() - sys_before + 2ull * recordings;
+        report("fwrite", seconds, syscalls, cpuSeconds() - cpu_before, dir, recordings);
+    }
+
+    const char *backends[] = {"threads", "io_uring"};
+    for (const char *backend : backends) {
+        voip::VConfig cfg;
+        cfg.set("record.backend", backend);
+        voip::VRecordWriter &writer = voip::VRecordWriter::instance();
+        writer.configure(cfg);
+        writer.start();
+        if (std::string(backend) == "io_uring" && writer.backend() != voip::VRecordWriter::URING) {
+            std::printf("%-9s unavailable\n", backend);
+            writer.stop();
+            continue;
+        }
+
+        uint64_t sys_before = writerSyscalls();
+        double cpu_before = cpuSeconds();
+        std::vector<std::unique_ptr<voip::VRecording>> files(recordings);
+        for (unsigned r = 0; r < recordings; ++r) {
+            files[r].reset(new voip::VRecording);
+            files[r]->open(dir + "/" + backend + "-" + std::to_string(r) + ".wav", CLOCK_RATE);
+        }
+        drive(frames, [&](unsigned) {
+            for (auto &file : files) {
+                file->write(frame.data(), frame.size());
+            }
+        });
+        for (auto &file : files) {
+            file->close();
+        }
+        writer.stop();
+        // 打开和收尾 (WAV 头 pwrite 已计入) 之外的 open / ftruncate / close
+        uint64_t syscalls = writerSyscalls() - sys_before + 3ull * recordings;
+        report(backend, seconds, syscalls, cpuSeconds() - cpu_before, dir, recordings);
+    }
+
+    voip::VLog::stop();
+    return 0;
+}
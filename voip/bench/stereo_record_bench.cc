@@ -0,0 +1,162 @@
+// 双声道录音的时隙对齐检查: 按 VMediaClock 的调度规则生成会议桥周期的到达时刻 (抖动、补跑、放弃补跑),
+// 把两个声道的帧注入 VCallRecorder, 读回 WAV 核对
+//   有声的时隙恰为送达的周期, 顺序不变, 左右声道来自同一周期 (不丢、不重复、不错位)
+//   时钟没有放弃补跑时不插静音, 时长等于送达的周期数; 放弃时补的静音与放弃的帧数相差不超过一帧
+//   前 100 个周期不停顿, 录音端借此校准会议桥的时刻网格
+// 输出每帧处理耗时, 不一致时返回 1
+//
+// 用法: stereo_record_bench [ticks] [jitter_ms] [stall_pct] [max_catchup] [seed]
+
+#include "vcallrecorder.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vrecorder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const unsigned CLOCK_RATE = 8000;
+const unsigned PTIME_MS = 20;
+const unsigned FRAME_SAMPLES = CLOCK_RATE * PTIME_MS / 1000;
+const size_t WAV_HEADER_BYTES = 44;
+
+int16_t
+marker(unsigned tick)
+{
+    return static_cast<int16_t>(tick % 30000 + 1);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned ticks = argc > 1 ? std::atoi(argv[1]) : 15000;
+    unsigned jitter_ms = argc > 2 ? std::atoi(argv[2]) : 15;
+    double stall_pct = argc > 3 ? std::atof(argv[3]) : 1;
+    unsigned max_catchup = argc > 4 ? std::atoi(argv[4]) : 5;
+    unsigned seed = argc > 5 ? std::atoi(argv[5]) : 1;
+    std::string path = "/tmp/stereo_record_bench.wav";
+
+    voip::VLog::start(VLOG_LEVEL_WARN);
+    voip::VConfig cfg;
+    voip::VRecordWriter &writer = voip::VRecordWriter::instance();
+    writer.configure(cfg);
+
+    voip::VCallRecorder recorder;
+    if (!recorder.open(path, CLOCK_RATE, PTIME_MS, max_catchup)) {
+        return 1;
+    }
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int64_t> jitter(0, static_cast<int64_t>(jitter_ms) * 1000);
+    std::uniform_real_distribution<double> chance(0, 100);
+    std::uniform_int_distribution<int64_t> stall(1, 3 * static_cast<int64_t>(max_catchup) + 3);
+    const int64_t period_us = PTIME_MS * 1000;
+
+    // 送达的各周期的标记, 本端无音频时为负
+    std::vector<int16_t> expected;
+    std::vector<int16_t> caller(FRAME_SAMPLES);
+    std::vector<int16_t> agent(FRAME_SAMPLES);
+    unsigned delivered = 0;
+    uint64_t skipped = 0;
+    uint64_t skip_events = 0;
+    uint64_t catchups = 0;
+
+    auto origin = std::chrono::steady_clock::now();
+    int64_t deadline = period_us;
+    int64_t prev = 0;
+    std::chrono::nanoseconds spent(0);
+    for (unsigned t = 0; t < ticks; ++t) {
+        // 与 VMediaClock::run 相同: 醒来晚于一帧时补跑, 落后超过 max_catchup 帧时放弃并重新对齐
+        int64_t late = jitter(rng);
+        if (t >= 100 && chance(rng) < stall_pct) {
+            late += stall(rng) * period_us;
+        }
+        int64_t now = std::max(deadline + late, prev + 50);
+        late = now - deadline;
+        if (late > period_us) {
+            int64_t behind = late / period_us;
+            if (behind > static_cast<int64_t>(max_catchup)) {
+                skipped += behind;
+                ++skip_events;
+                deadline += behind * period_us;
+            }
+            else {
+                catchups += behind;
+            }
+        }
+        prev = now;
+        deadline += period_us;
+
+        // 两个端口的先后随机, 本端约一半周期没有发送端 (NONE 帧)
+        bool agent_audio = chance(rng) < 50;
+        std::fill(caller.begin(), caller.end(), marker(t));
+        std::fill(agent.begin(), agent.end(), marker(t));
+        auto at = origin + std::chrono::microseconds(now);
+        auto begin = std::chrono::steady_clock::now();
+        if (chance(rng) < 50) {
+            recorder.push(voip::VCallRecorder::CALLER, caller.data(), caller.size(), at);
+            recorder.push(voip::VCallRecorder::AGENT, agent_audio ? agent.data() : nullptr, FRAME_SAMPLES, at + std::chrono::microseconds(5));
+        }
+        else {
+            recorder.push(voip::VCallRecorder::AGENT, agent_audio ? agent.data() : nullptr, FRAME_SAMPLES, at);
+            recorder.push(voip::VCallRecorder::CALLER, caller.data(), caller.size(), at + std::chrono::microseconds(5));
+        }
+        spent += std::chrono::steady_clock::now() - begin;
+        expected.push_back(agent_audio ? marker(t) : -marker(t));
+        ++delivered;
+    }
+    recorder.close();
+    writer.stop();
+
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(WAV_HEADER_BYTES);
+    std::vector<char> raw((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t written = raw.size() / (FRAME_SAMPLES * 2 * sizeof(int16_t));
+    const int16_t *pcm = reinterpret_cast<const int16_t *>(raw.data());
+
+    // 有声的时隙依次与送达的周期比对, 静音时隙另计
+    size_t mismatched = 0;
+    size_t silent = 0;
+    size_t next = 0;
+    for (size_t slot = 0; slot < written; ++slot) {
+        const int16_t *frame = pcm + slot * FRAME_SAMPLES * 2;
+        if (frame[0] == 0 && frame[1] == 0) {
+            ++silent;
+            continue;
+        }
+        int16_t want = next < expected.size() ? expected[next] : 0;
+        int16_t want_left = want < 0 ? -want : want;
+        int16_t want_right = want < 0 ? 0 : want;
+        ++next;
+        if (frame[0] != want_left || frame[1] != want_right || frame[FRAME_SAMPLES * 2 - 2] != want_left
+            || frame[FRAME_SAMPLES * 2 - 1] != want_right) {
+            if (mismatched++ == 0) {
+                std::printf("first mismatch at slot %zu: %d/%d, expected %d/%d\n", slot, frame[0], frame[1], want_left,
+                            want_right);
+            }
+        }
+    }
+
+    uint64_t gaps = recorder.gapFrames();
+    uint64_t gap_error = gaps > skipped ? gaps - skipped : skipped - gaps;
+    bool ok = raw.size() % (FRAME_SAMPLES * 4) == 0 && next == delivered && mismatched == 0 && silent == gaps
+              && gap_error <= skip_events && (skip_events > 0 || written == delivered);
+    std::printf("%u ticks delivered, %llu caught up, %llu skipped by the clock in %llu stalls\n", delivered,
+                static_cast<unsigned long long>(catchups), static_cast<unsigned long long>(skipped),
+                static_cast<unsigned long long>(skip_events));
+    std::printf("%zu slots written, %llu gap slots, %zu misaligned, %.0f ns per frame pair: %s\n", written,
+                static_cast<unsigned long long>(gaps), mismatched, static_cast<double>(spent.count()) / delivered,
+                ok ? "ok" : "FAIL");
+
+    voip::VLog::stop();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,256 @@
+// TLS 连接复用的独立演示: 直接用 OpenSSL, 本地 TLS 替身服务器 (模拟 SBC) + 顺序发送 INVITE 大小请求的客户端
+// reuse=on 全部请求走同一条连接, reuse=off 每个请求新建连接并完整握手 (服务端关闭会话缓存, 无会话恢复)
+// 只估算连接复用能省下的握手开销, 不经过 pjsip 传输层, 也不读 sip.reuse
+// 输出服务端握手次数以及单请求建立时延 (含建连和握手) 的均值/p50/p99
+//
+// 用法: tls_reuse_bench [requests]
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// 带多个编解码器的 INVITE 约 1.5 kB, 超过 UDP 安全尺寸
+const size_t REQUEST_BYTES = 1500;
+
+std::atomic<unsigned> handshakes {0};
+std::atomic<bool> server_running {true};
+
+void
+fail(const char *what)
+{
+    std::fprintf(stderr, "%s failed\n", what);
+    ERR_print_errors_fp(stderr);
+    std::exit(1);
+}
+
+// 内存中生成自签名证书
+SSL_CTX *
+createServerCtx()
+{
+    EVP_PKEY *pkey = EVP_EC_gen("P-256");
+    if (!pkey) {
+        fail("EVP_EC_gen");
+    }
+    X509 *cert = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, pkey);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>("sbc.local"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    if (!X509_sign(cert, pkey, EVP_sha256())) {
+        fail("X509_sign");
+    }
+
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx || SSL_CTX_use_certificate(ctx, cert) != 1 || SSL_CTX_use_PrivateKey(ctx, pkey) != 1) {
+        fail("server SSL_CTX");
+    }
+    // 不做会话恢复, 每条新连接都是完整握手, 与 SBC 默认行为一致
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_num_tickets(ctx, 0);
+    X509_free(cert);
+    EVP_PKEY_free(pkey);
+    return ctx;
+}
+
+bool
+readMessage(SSL *ssl, std::string &buf)
+{
+    char tmp[4096];
+    while (buf.find("\r\n\r\n") == std::string::npos) {
+        int n = SSL_read(ssl, tmp, sizeof(tmp));
+        if (n <= 0) {
+            return false;
+        }
+        buf.append(tmp, n);
+    }
+    buf.erase(0, buf.find("\r\n\r\n") + 4);
+    return true;
+}
+
+void
+serveConnection(SSL_CTX *ctx, int fd)
+{
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    if (SSL_accept(ssl) == 1) {
+        handshakes.fetch_add(1);
+        static const char RESPONSE[] = "SIP/2.0 200 OK\r\nContent-Length: 0\r\n\r\n";
+        std::string buf;
+        while (readMessage(ssl, buf)) {
+            SSL_write(ssl, RESPONSE, sizeof(RESPONSE) - 1);
+        }
+    }
+    SSL_free(ssl);
+    close(fd);
+}
+
+void
+serverLoop(SSL_CTX *ctx, int listen_fd)
+{
+    while (server_running) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        // 每条连接一个线程, 模拟 SBC 并行处理
+        std::thread(serveConnection, ctx, fd).detach();
+    }
+}
+
+int
+connectTo(unsigned short port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        fail("connect");
+    }
+    return fd;
+}
+
+SSL *
+openClient(SSL_CTX *ctx, unsigned short port)
+{
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, connectTo(port));
+    if (SSL_connect(ssl) != 1) {
+        fail("SSL_connect");
+    }
+    return ssl;
+}
+
+void
+closeClient(SSL *ssl)
+{
+    int fd = SSL_get_fd(ssl);
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(fd);
+}
+
+struct Result
+{
+    unsigned handshakes;
+    double mean_us, p50_us, p99_us;
+};
+
+Result
+run(SSL_CTX *client_ctx, unsigned short port, unsigned requests, bool reuse)
+{
+    std::string request = "INVITE sip:ai@sbc.local SIP/2.0\r\nContent-Length: 0\r\nX-Pad: ";
+    request.append(REQUEST_BYTES - request.size() - 4, 'x');
+    request += "\r\n\r\n";
+
+    unsigned before = handshakes.load();
+    std::vector<double> latencies;
+    latencies.reserve(requests);
+
+    SSL *ssl = nullptr;
+    for (unsigned i = 0; i < requests; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        if (!ssl) {
+            ssl = openClient(client_ctx, port);
+        }
+        SSL_write(ssl, request.data(), static_cast<int>(request.size()));
+        std::string buf;
+        if (!readMessage(ssl, buf)) {
+            fail("response");
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        if (!reuse) {
+            closeClient(ssl);
+            ssl = nullptr;
+        }
+    }
+    if (ssl) {
+        closeClient(ssl);
+    }
+
+    // 等服务端线程计数完成
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::sort(latencies.begin(), latencies.end());
+    Result r;
+    r.handshakes = handshakes.load() - before;
+    double sum = 0;
+    for (double v : latencies) {
+        sum += v;
+    }
+    r.mean_us = sum / latencies.size();
+    r.p50_us = latencies[latencies.size() / 2];
+    r.p99_us = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 500;
+    if (count <= 0) {
+        std::fprintf(stderr, "requests must be positive\n");
+        return 1;
+    }
+    unsigned requests = static_cast<unsigned>(count);
+
+    SSL_CTX *server_ctx = createServerCtx();
+    SSL_CTX *client_ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_verify(client_ctx, SSL_VERIFY_NONE, nullptr);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listen_fd, 128) < 0 ||
+        getsockname(listen_fd, reinterpret_cast<sockaddr *>(&addr), &len) < 0) {
+        fail("listen");
+    }
+    unsigned short port = ntohs(addr.sin_port);
+    std::thread server(serverLoop, server_ctx, listen_fd);
+
+    std::printf("%u requests of %zu bytes over local TLS\n", requests, REQUEST_BYTES);
+    for (bool reuse : {true, false}) {
+        Result r = run(client_ctx, port, requests, reuse);
+        std::printf("reuse %-3s: handshakes %5u, setup latency mean %8.1f us, p50 %8.1f us, p99 %8.1f us\n",
+                    reuse ? "on" : "off", r.handshakes, r.mean_us, r.p50_us, r.p99_us);
+    }
+
+    server_running = false;
+    shutdown(listen_fd, SHUT_RDWR);
+    close(listen_fd);
+    server.join();
+    SSL_CTX_free(client_ctx);
+    SSL_CTX_free(server_ctx);
+    return 0;
+}
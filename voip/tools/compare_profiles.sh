@@ -0,0 +1,26 @@
+#!/bin/sh
+# 对比 full 与 audio-only 两种构建的可执行文件大小、启动耗时和常驻内存
+# 用法: tools/compare_profiles.sh [voip.conf] [等待秒数]   (在 voip 目录下运行)
+set -e
+
+CONF=${1:-voip.conf}
+WAIT=${2:-3}
+
+for profile in full audio-only; do
+    if [ "$profile" = audio-only ]; then
+        opt=ON
+    else
+        opt=OFF
+    fi
+    dir=build-$profile
+    cmake -S . -B "$dir" -DVOIP_AUDIO_ONLY=$opt >/dev/null
+    cmake --build "$dir" -j >/dev/null
+
+    size=$(stat -c %s "$dir/voip")
+    libs=$(ldd "$dir/voip" | wc -l)
+    # stdin 不是终端时 voip 不会自行退出, 启动后等 WAIT 秒发 SIGTERM 正常退出;
+    # 启动耗时取 voip 自己的 startup 日志, /usr/bin/time 统计含动态加载在内的峰值 RSS
+    report=$(/usr/bin/time -f "max rss %M kB" timeout -s TERM "$WAIT" "$dir/voip" "$CONF" </dev/null 2>&1 \
+        | grep -E "startup \(|max rss " | sed 's/^.*>>> //' | tr '\n' ';')
+    echo "$profile: binary $size bytes, $libs shared libs; $report"
+done
@@ -0,0 +1,61 @@
+// AI 后端替身: 在本机监听, 以 vaiwire.h 的协议回声回复, 配合 ai.backend = mux 使用
+// 回复的延迟、速度和流式分包取配置中的 ai.echo_* / ai.stream, 与进程内回声后端一致
+//
+// 用法: voip_ai_standin [-c voip.conf] [port]
+//   port 缺省取 ai.mux.port, 监听地址取 ai.mux.host; Ctrl-C 退出
+
+#include "vaistandin.h"
+#include "vconfig.h"
+#include "vlog.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+volatile std::sig_atomic_t stopping = 0;
+
+void
+onSignal(int)
+{
+    stopping = 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    voip::VConfig cfg;
+    int i = 1;
+    if (i + 1 < argc && std::strcmp(argv[i], "-c") == 0) {
+        if (!cfg.load(argv[i + 1])) {
+            std::fprintf(stderr, "cannot read %s\n", argv[i + 1]);
+            return 1;
+        }
+        i += 2;
+    }
+    std::string host = cfg.getString("ai.mux.host", "127.0.0.1");
+    int port = i < argc ? std::atoi(argv[i]) : std::atoi(cfg.getString("ai.mux.port", "7070").c_str());
+
+    voip::VLog::start(VLOG_LEVEL_INFO);
+    voip::VAiStandin standin;
+    if (standin.start(host, static_cast<uint16_t>(port), cfg) == 0) {
+        voip::VLog::stop();
+        return 1;
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    while (!stopping) {
+        pause();
+    }
+
+    standin.stop();
+    VLOG_INFO << ">>> AI stand-in stopped, " << standin.accepted() << " connections served";
+    voip::VLog::stop();
+    return 0;
+}
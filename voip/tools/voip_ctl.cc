@@ -0,0 +1,154 @@
+// 控制接口客户端: 经 control.socket 向运行中的 voip 发请求, 协议见 vcontrol.h
+// 请求不等回复连续发出 (最多 window 个在途), 结束时在 stderr 输出请求数和每秒请求数
+//
+// 用法: voip_ctl [-s socket] [-n repeat] [-w window] [-q] [request...]
+//   request 为不带 tag 的一条请求, 如 "call sip:1001@192.168.10.51" "list" "stats 0";
+//   未给出时从标准输入按行读取; -n 把整组请求重复 repeat 次; -q 不输出回复
+//   退出码: 全部 ok 为 0, 有 err 为 2, 连接失败为 1
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+    std::string path = "/tmp/voip-control.sock";
+    long repeat = 1;
+    long window = 1024;
+    bool quiet = false;
+    std::vector<std::string> requests;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            repeat = std::max(1L, std::atol(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            window = std::max(1L, std::atol(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "-q") == 0) {
+            quiet = true;
+        }
+        else {
+            requests.push_back(argv[i]);
+        }
+    }
+    if (requests.empty()) {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (!line.empty()) {
+                requests.push_back(line);
+            }
+        }
+    }
+    if (requests.empty()) {
+        return 0;
+    }
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        std::fprintf(stderr, "cannot connect to %s: %s\n", path.c_str(), std::strerror(errno));
+        return 1;
+    }
+
+    const size_t total = requests.size() * static_cast<size_t>(repeat);
+    size_t sent = 0;
+    size_t answered = 0;
+    size_t errors = 0;
+    std::string out;
+    size_t out_pos = 0;
+    std::string in;
+    char buf[65536];
+    auto begin = std::chrono::steady_clock::now();
+
+    while (answered < total) {
+        // tag 为请求序号, 在途请求不超过 window
+        while (sent < total && sent - answered < static_cast<size_t>(window) && out.size() - out_pos < sizeof(buf)) {
+            out += std::to_string(sent);
+            out += ' ';
+            out += requests[sent % requests.size()];
+            out += '\n';
+            ++sent;
+        }
+
+        pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN | (out_pos < out.size() ? POLLOUT : 0);
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (pfd.revents & POLLOUT) {
+            ssize_t n = send(fd, out.data() + out_pos, out.size() - out_pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                std::fprintf(stderr, "send: %s\n", std::strerror(errno));
+                break;
+            }
+            if (n > 0) {
+                out_pos += static_cast<size_t>(n);
+                if (out_pos == out.size()) {
+                    out.clear();
+                    out_pos = 0;
+                }
+            }
+        }
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (n == 0) {
+                std::fprintf(stderr, "connection closed by voip\n");
+                break;
+            }
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EINTR) {
+                    continue;
+                }
+                std::fprintf(stderr, "recv: %s\n", std::strerror(errno));
+                break;
+            }
+            in.append(buf, static_cast<size_t>(n));
+            size_t pos = 0;
+            size_t eol;
+            while ((eol = in.find('\n', pos)) != std::string::npos) {
+                size_t space = in.find(' ', pos);
+                if (space != std::string::npos && space < eol && in.compare(space + 1, 3, "err") == 0) {
+                    ++errors;
+                }
+                if (!quiet) {
+                    std::fwrite(in.data() + pos, 1, eol - pos + 1, stdout);
+                }
+                ++answered;
+                pos = eol + 1;
+            }
+            in.erase(0, pos);
+        }
+    }
+    close(fd);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::fflush(stdout);
+    std::fprintf(stderr, "%zu requests, %zu errors, %.3f s, %.0f requests/s\n", answered, errors, seconds,
+                 seconds > 0 ? answered / seconds : 0.0);
+    if (answered < total) {
+        return 1;
+    }
+    return errors > 0 ? 2 : 0;
+}
@@ -0,0 +1,327 @@
+// 离线回放: 把录好的 PCM (recv.pcm 或 WAV) 送进与线上相同的 AI 端口 (VAiProcessor -> VAiClient -> VAiPlayer)
+// 媒体时钟是虚拟的, 每帧 (ai.ptime_ms) 立即推进, 以 CPU 能达到的最快速度运行; 多个文件分给多个线程并行处理
+// 输出每个文件的处理时间, 以及总帧率、AI 链路字节数和每轮回复的首音时延 (分片结束到回复开始播放)
+//
+// 用法: voip_replay [-j threads] [-c voip.conf] [-r] file...
+//   -r 按实时节奏推进虚拟时钟, 用于观察分片自适应等与后端时延相关的行为
+//   端口采样率取 ai.clock_rate (为 0 时 8 kHz), .wav 需为 16 bit 单声道, 采样率不同时线性重采样;
+//   其它文件按该采样率 16 bit 单声道裸 PCM 读取
+//   未在配置中指定时 ai.echo_delay_ms 取 0, 只测本地处理开销
+
+#include "vaiclient.h"
+#include "vaiport.h"
+#include "vaudiobudget.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// 由配置决定, 所有文件相同
+unsigned clock_rate = 8000;
+unsigned ptime_ms = 20;
+unsigned samples_per_frame = 160;
+
+struct FileResult
+{
+    std::string path;
+    bool ok = false;
+    uint64_t frames = 0;
+    double wall_ms = 0;
+    voip::VPlayoutStats playout;
+    voip::VChunkStats chunk;
+};
+
+bool realtime = false;
+
+uint32_t
+readLe(const unsigned char *p, unsigned bytes)
+{
+    uint32_t v = 0;
+    for (unsigned i = 0; i < bytes; ++i) {
+        v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+// 线性插值重采样到 clock_rate
+std::vector<int16_t>
+resample(const std::vector<int16_t> &in, unsigned rate)
+{
+    if (rate == clock_rate || in.empty()) {
+        return in;
+    }
+    size_t out_len = in.size() * clock_rate / rate;
+    std::vector<int16_t> out(out_len);
+    for (size_t i = 0; i < out_len; ++i) {
+        double pos = static_cast<double>(i) * rate / clock_rate;
+        size_t idx = static_cast<size_t>(pos);
+        double frac = pos - idx;
+        int16_t a = in[idx];
+        int16_t b = idx + 1 < in.size() ? in[idx + 1] : a;
+        out[i] = static_cast<int16_t>(a + (b - a) * frac);
+    }
+    return out;
+}
+
+bool
+loadPcm(const std::string &path, std::vector<int16_t> &samples)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    bool wav = data.size() >= 12 && std::memcmp(data.data(), "RIFF", 4) == 0 && std::memcmp(data.data() + 8, "WAVE", 4) == 0;
+    if (!wav) {
+        samples.resize(data.size() / sizeof(int16_t));
+        std::memcpy(samples.data(), data.data(), samples.size() * sizeof(int16_t));
+        return true;
+    }
+
+    unsigned rate = 0, channels = 0, bits = 0;
+    size_t pos = 12;
+    while (pos + 8 <= data.size()) {
+        uint32_t size = readLe(&data[pos + 4], 4);
+        const unsigned char *body = data.data() + pos + 8;
+        bool is_data = std::memcmp(&data[pos], "data", 4) == 0;
+        // 其它块必须完整; data 块允许截断 (录音进程未正常收尾时头部的长度不可信), 按实际长度读取
+        if (!is_data && size > data.size() - pos - 8) {
+            std::fprintf(stderr, "%s: truncated WAV chunk\n", path.c_str());
+            return false;
+        }
+        if (std::memcmp(&data[pos], "fmt ", 4) == 0 && size >= 16) {
+            channels = readLe(body + 2, 2);
+            rate = readLe(body + 4, 4);
+            bits = readLe(body + 14, 2);
+        }
+        else if (is_data) {
+            if (channels != 1 || bits != 16) {
+                std::fprintf(stderr, "%s: only 16 bit mono WAV is supported\n", path.c_str());
+                return false;
+            }
+            if (rate == 0) {
+                std::fprintf(stderr, "%s: WAV sample rate is 0\n", path.c_str());
+                return false;
+            }
+            size = std::min<size_t>(size, data.size() - pos - 8);
+            std::vector<int16_t> raw(size / sizeof(int16_t));
+            std::memcpy(raw.data(), body, raw.size() * sizeof(int16_t));
+            samples = resample(raw, rate);
+            return true;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    std::fprintf(stderr, "%s: no data chunk\n", path.c_str());
+    return false;
+}
+
+// 一个文件一路呼叫: 与线上一样, 每帧先收后发
+void
+replayFile(const voip::VConfig &cfg, FileResult &result, int call_id)
+{
+    std::vector<int16_t> samples;
+    if (!loadPcm(result.path, samples)) {
+        return;
+    }
+
+    voip::VAiClient client;
+    client.start(cfg);
+    voip::VAiPlayer player(clock_rate, samples_per_frame);
+    player.setPlayout(voip::VPlayoutConfig::fromConfig(cfg));
+    player.setCodec(voip::VAiCodecConfig::fromConfig(cfg));
+    voip::VAiProcessor processor(client, player, clock_rate);
+    processor.setChunking(voip::VChunkConfig::fromConfig(cfg));
+    processor.setCodec(voip::VAiCodecConfig::fromConfig(cfg));
+    unsigned generation = player.attach(call_id);
+    processor.attach(call_id, generation, std::chrono::steady_clock::now());
+
+    pj::MediaFrame in;
+    in.type = PJMEDIA_FRAME_TYPE_AUDIO;
+    in.size = samples_per_frame * sizeof(int16_t);
+    in.buf.resize(in.size);
+    pj::MediaFrame out;
+
+    auto begin = std::chrono::steady_clock::now();
+    size_t frames = samples.size() / samples_per_frame;
+    for (size_t i = 0; i < frames; ++i) {
+        if (realtime) {
+            std::this_thread::sleep_until(begin + std::chrono::milliseconds(ptime_ms * i));
+        }
+        std::memcpy(in.buf.data(), &samples[i * samples_per_frame], in.size);
+        processor.onFrameReceived(in);
+        out.size = in.size;
+        player.onFrameRequested(out);
+    }
+
+    // 等剩余回复到达并播完, 虚拟时钟继续走, 不计入输入帧数
+    // 队列空时睡一会再查: 实时模式睡一帧, 否则睡 1 ms, 不空转占满一个核
+    auto idle = std::chrono::milliseconds(realtime ? ptime_ms : 1);
+    while (client.pending() > 0 || player.queuedSamples() > 0) {
+        if (player.queuedSamples() == 0) {
+            std::this_thread::sleep_for(idle);
+            continue;
+        }
+        out.size = in.size;
+        player.onFrameRequested(out);
+    }
+    result.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    result.frames = frames;
+    result.playout = player.playoutStats();
+    result.chunk = processor.chunkStats();
+    result.ok = true;
+
+    processor.reset();
+    player.reset();
+    client.stop();
+}
+
+// 由桶估计分位数 (取桶上界), 落在最后一个桶之外时写成 "> 上界"
+std::string
+quantileMs(const voip::VHistogram &hist, double q)
+{
+    uint64_t total = hist.count();
+    uint64_t rank = static_cast<uint64_t>(total * q);
+    uint64_t seen = 0;
+    char buf[32];
+    for (unsigned i = 0; i < voip::VHistogram::BUCKETS; ++i) {
+        seen += hist.bucket(i);
+        if (seen > rank) {
+            std::snprintf(buf, sizeof(buf), "<= %.3f", voip::VHistogram::BOUNDS_US[i] / 1000.0);
+            return buf;
+        }
+    }
+    std::snprintf(buf, sizeof(buf), "> %.3f", voip::VHistogram::BOUNDS_US[voip::VHistogram::BUCKETS - 1] / 1000.0);
+    return buf;
+}
+
+void
+usage()
+{
+    std::fprintf(stderr, "usage: voip_replay [-j threads] [-c voip.conf] [-r] file...\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    voip::VConfig cfg;
+    std::vector<FileResult> results;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "-r") == 0) {
+            realtime = true;
+        }
+        else if (std::strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            if (!cfg.load(argv[++i])) {
+                return 1;
+            }
+        }
+        else {
+            FileResult r;
+            r.path = argv[i];
+            results.push_back(r);
+        }
+    }
+    if (results.empty()) {
+        usage();
+        return 1;
+    }
+    if (!cfg.has("ai.echo_delay_ms")) {
+        cfg.set("ai.echo_delay_ms", "0");
+    }
+
+    clock_rate = cfg.getInt("ai.clock_rate", 8000);
+    clock_rate = clock_rate ? clock_rate : 8000;
+    ptime_ms = cfg.getInt("ai.ptime_ms", 20);
+    ptime_ms = ptime_ms ? ptime_ms : 20;
+    samples_per_frame = clock_rate * ptime_ms / 1000;
+
+    voip::VLog::start(VLOG_LEVEL_WARN);
+    voip::VAudioBudget::instance().configure(cfg);
+
+    std::atomic<size_t> next {0};
+    std::vector<std::thread> workers;
+    auto begin = std::chrono::steady_clock::now();
+    threads = static_cast<unsigned>(std::min<size_t>(threads, results.size()));
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            for (size_t i = next.fetch_add(1); i < results.size(); i = next.fetch_add(1)) {
+                replayFile(cfg, results[i], static_cast<int>(i));
+            }
+        });
+    }
+    for (std::thread &w : workers) {
+        w.join();
+    }
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    uint64_t frames = 0;
+    for (const FileResult &r : results) {
+        if (!r.ok) {
+            std::printf("%-40s failed\n", r.path.c_str());
+            continue;
+        }
+        frames += r.frames;
+        std::printf("%-40s %8llu frames %10.1f ms %8.1fx realtime, playout drop/insert/discard %llu/%llu/%llu\n",
+                    r.path.c_str(), static_cast<unsigned long long>(r.frames), r.wall_ms,
+                    r.wall_ms > 0 ? r.frames * static_cast<double>(ptime_ms) / r.wall_ms : 0.0,
+                    static_cast<unsigned long long>(r.playout.drops),
+                    static_cast<unsigned long long>(r.playout.inserts),
+                    static_cast<unsigned long long>(r.playout.discards));
+        std::printf("%-40s chunk %u ms, rtt %u ms (max %u), backend queue %u ms, %llu requests\n", "",
+                    r.chunk.chunk_ms, r.chunk.rtt_ms, r.chunk.rtt_max_ms, r.chunk.queue_ms,
+                    static_cast<unsigned long long>(r.chunk.requests));
+    }
+
+    const voip::VHistogram &latency = voip::VMetrics::instance().histogram(
+        "voip_ai_time_to_first_audio_seconds", "Time from the end of an uplink chunk to the first audio of its response playing");
+    double audio_s = frames * ptime_ms / 1000.0;
+    std::printf("\n%zu files on %u threads: %llu frames of %u ms at %u Hz in %.3f s, %.0f frames/s (%.1fx realtime)\n",
+                results.size(), threads, static_cast<unsigned long long>(frames), ptime_ms, clock_rate, wall_s,
+                frames / wall_s, audio_s / wall_s);
+    voip::VMetrics &metrics = voip::VMetrics::instance();
+    uint64_t up = metrics.counter("voip_ai_bytes_total", "Audio payload bytes exchanged with the AI backend", "dir=\"up\"").value();
+    uint64_t down = metrics.counter("voip_ai_bytes_total", "Audio payload bytes exchanged with the AI backend", "dir=\"down\"").value();
+    if (frames > 0) {
+        std::printf("AI payload (%s): up %llu bytes, down %llu bytes, %.1f kbit/s per direction\n",
+                    voip::VAiCodecConfig::fromConfig(cfg).opus ? "opus" : "pcm",
+                    static_cast<unsigned long long>(up), static_cast<unsigned long long>(down),
+                    up * 8 / audio_s / 1000);
+    }
+    const char *shed_labels[] = {"buffer=\"playout\",policy=\"drop_oldest\"", "buffer=\"playout\",policy=\"drop_newest\"",
+                                 "buffer=\"uplink\",policy=\"drop_newest\""};
+    uint64_t shed[3];
+    for (int i = 0; i < 3; ++i) {
+        shed[i] = metrics.counter("voip_audio_buffer_shed_bytes_total", "Audio dropped to stay within the buffer memory budget", shed_labels[i]).value();
+    }
+    if (shed[0] + shed[1] + shed[2] > 0) {
+        std::printf("over audio budget: dropped oldest %llu, newest %llu playout bytes, %llu uplink bytes\n",
+                    static_cast<unsigned long long>(shed[0]), static_cast<unsigned long long>(shed[1]),
+                    static_cast<unsigned long long>(shed[2]));
+    }
+    if (latency.count() > 0) {
+        std::printf("time to first audio: %llu turns, mean %.3f ms, p50 %s ms, p99 %s ms\n",
+                    static_cast<unsigned long long>(latency.count()), latency.sumUs() / 1000.0 / latency.count(),
+                    quantileMs(latency, 0.5).c_str(), quantileMs(latency, 0.99).c_str());
+    }
+
+    voip::VLog::stop();
+    return 0;
+}
@@ -1,69 +1,241 @@
 #include "vaccount.h"
+#include "vaipool.h"
+#include "vaudiobudget.h"
 #include "vcall.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+#include "vrecorder.h"
+#include "vtrace.h"
 
-#include <iostream>
 #include <memory>
 
+namespace {
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VGauge &reg_registered = metrics.gauge("voip_registrations", "Accounts by registration state", "state=\"registered\"");
+voip::VGauge &reg_unregistered = metrics.gauge("voip_registrations", "Accounts by registration state", "state=\"unregistered\"");
+voip::VGauge &reg_failed = metrics.gauge("voip_registrations", "Accounts by registration state", "state=\"failed\"");
+
+voip::VCounter &calls_answered = metrics.counter("voip_calls_answered_total", "Incoming calls answered");
+voip::VCounter &calls_rejected = metrics.counter("voip_calls_rejected_total", "Incoming calls rejected");
+voip::VCounter &calls_failed = metrics.counter("voip_calls_failed_total", "Calls that failed before being established");
+
+voip::VHistogram &reg_state_latency = metrics.histogram("voip_callback_latency_seconds", "pjsua2 callback duration", "callback=\"onRegState\"");
+voip::VHistogram &incoming_latency = metrics.histogram("voip_callback_latency_seconds", "pjsua2 callback duration", "callback=\"onIncomingCall\"");
+
+} // namespace
+
 voip::VAccount::VAccount()
 {
 }
 
 voip::VAccount::~VAccount()
 {
+    if (reg_gauge_) {
+        reg_gauge_->dec();
+    }
+    stream_sampler_.stop();
+    for (VCall *call : calls_) {
+        delete call;
+    }
+    // 先停工作线程, 避免回复写入已销毁的端口
+    ai_client_.stop();
+    ai_pool_.reset();
+}
+
+void voip::VAccount::configure(const VConfig &cfg)
+{
+    admission_.configure(cfg);
+    VAudioBudget::instance().configure(cfg);
+    VRecordWriter::instance().configure(cfg);
+    calls_.reserve(cfg.getInt("admission.max_calls", 1));
+
+    // 统计线程只拿呼叫 id 和媒体序号, 呼叫对象仍只由主线程释放
+    stream_sampler_.start(cfg, [this]() {
+        std::vector<VStreamRef> streams;
+        std::lock_guard<std::mutex> lock(calls_mutex_);
+        for (VCall *call : calls_) {
+            if (!call->disconnected()) {
+                streams.push_back(VStreamRef {call->getId(), call->streamIndex()});
+            }
+        }
+        return streams;
+    });
+
+    ai_auto_attach_ = cfg.getBool("ai.auto_attach", true);
+    if (cfg.getBool("ai.enabled", false)) {
+        ai_pool_.reset(new VAiPortPool(ai_client_));
+        ai_pool_->configure(cfg);
+        ai_client_.start(cfg);
+    }
 }
 
 void voip::VAccount::onRegState(pj::OnRegStateParam &prm)
 {
+    VScopedLatency latency(reg_state_latency);
     pj::AccountInfo ai = getInfo();
-    std::cout << (ai.regIsActive ? ">>> Registered:" : ">>> Unregistered:")
+
+    VGauge *gauge = ai.regIsActive ? &reg_registered : (prm.code / 100 == 2 ? &reg_unregistered : &reg_failed);
+    if (gauge != reg_gauge_) {
+        if (reg_gauge_) {
+            reg_gauge_->dec();
+        }
+        gauge->inc();
+        reg_gauge_ = gauge;
+    }
+
+    VLOG_INFO << (ai.regIsActive ? ">>> Registered:" : ">>> Unregistered:")
               << " code=" << prm.code
               << " reason=" << prm.reason
-              << " (" << ai.uri << ")"
-              << std::endl;
+              << " (" << ai.uri << ")";
 }
 
 void voip::VAccount::onIncomingCall(pj::OnIncomingCallParam &iprm)
 {
+    VScopedLatency latency(incoming_latency);
     pj::CallOpParam prm;
 
-    if (cur_call) {
-        std::cout << ">>> Another call is active. Rejecting incoming call ID "
-                  << iprm.callId << " from " << iprm.rdata.srcAddress << std::endl;
+    VTRACE_INSTANT("incoming_call", iprm.callId);
 
-        VCall *rejectCall = nullptr;
-        std::shared_ptr<VCall> reject_call;
-        try {
-            rejectCall = new VCall(*this, iprm.callId);
-            prm.statusCode = PJSIP_SC_BUSY_HERE;
-            rejectCall->hangup(prm);
-            delete rejectCall;
-            rejectCall = nullptr;
-        }
-        catch (pj::Error &err) {
-            std::cerr << ">>> error rejecting call ID " << iprm.callId << ": " << err.info() << std::endl;
-            if (rejectCall) {
-                std::cerr << ">>> attempting cleanup of rejectCall object after rejection error." << std::endl;
-                delete rejectCall;
-            }
-        }
+    VAdmission::Decision decision = admission_.decide();
+    if (decision != VAdmission::ADMIT) {
+        // 呼叫风暴下走这里, 只记 DEBUG
+        VLOG_DEBUG << ">>> rejecting incoming call ID " << iprm.callId << " from " << iprm.rdata.srcAddress
+                   << (decision == VAdmission::REJECT_BUSY ? " (busy)" : " (overload)");
+        admission_.reject(iprm.callId, decision);
+        calls_rejected.inc();
         return;
     }
 
-    std::cout << ">>> incoming call: " << iprm.callId << " from " << iprm.rdata.srcAddress << std::endl;
+    VLOG_INFO << ">>> incoming call: " << iprm.callId << " from " << iprm.rdata.srcAddress;
 
     VCall *call = nullptr;
+    VTRACE_BEGIN("answer", iprm.callId);
     try {
         call = new VCall(*this, iprm.callId);
-        std::cout << ">>> auto-answering incoming call..." << std::endl;
+        VLOG_INFO << ">>> auto-answering incoming call...";
         prm.statusCode = PJSIP_SC_OK;
         call->answer(prm);
+        VTRACE_END("answer", iprm.callId);
+        calls_answered.inc();
+        addCall(call);
         cur_call = call;
     }
     catch (pj::Error &err) {
-        std::cerr << ">>> failed to create or answer call ID " << iprm.callId << ": " << err.info() << std::endl;
+        // answer 之前抛出时补上结束事件, 失败另记一个即时事件
+        VTRACE_END("answer", iprm.callId);
+        VTRACE_INSTANT("answer_failed", iprm.callId);
+        VLOG_ERROR << ">>> failed to create or answer call ID " << iprm.callId << ": " << err.info();
+        calls_failed.inc();
         if (call) {
             delete call;
         }
-        cur_call = nullptr;
     }
+}
+
+void voip::VAccount::addCall(VCall *call)
+{
+    std::lock_guard<std::mutex> lock(calls_mutex_);
+    calls_.push_back(call);
+}
+
+void voip::VAccount::reapCalls()
+{
+    std::vector<VCall *> dead;
+    {
+        std::lock_guard<std::mutex> lock(calls_mutex_);
+        for (auto it = calls_.begin(); it != calls_.end();) {
+            if ((*it)->disconnected()) {
+                dead.push_back(*it);
+                it = calls_.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    for (VCall *call : dead) {
+        delete call;
+    }
+}
+
+void voip::VAccount::hangupAll()
+{
+    std::lock_guard<std::mutex> lock(calls_mutex_);
+    for (VCall *call : calls_) {
+        if (call->disconnected()) {
+            continue;
+        }
+        try {
+            pj::CallOpParam prm;
+            call->hangup(prm);
+        }
+        catch (const pj::Error &err) {
+            VLOG_ERROR << ">>> failed to hang up call: " << err.info();
+        }
+    }
+}
+
+voip::VCall *voip::VAccount::makeCall(const std::string &uri, std::function<void(const VCallOutcome &)> on_outcome)
+{
+    VLOG_INFO << ">>> placing call to: " << uri;
+    VCall *call = new VCall(*this);
+    call->setOutcomeHandler(std::move(on_outcome));
+    pj::CallOpParam prm(true);
+    try {
+        call->makeCall(uri, prm);
+    }
+    catch (const pj::Error &err) {
+        VLOG_ERROR << ">>> failed to make call to " << uri << ": " << err.info();
+        calls_failed.inc();
+        delete call;
+        return nullptr;
+    }
+    addCall(call);
+    return call;
+}
+
+std::vector<voip::VCall *> voip::VAccount::calls()
+{
+    std::vector<VCall *> live;
+    std::lock_guard<std::mutex> lock(calls_mutex_);
+    for (VCall *call : calls_) {
+        if (!call->disconnected()) {
+            live.push_back(call);
+        }
+    }
+    return live;
+}
+
+voip::VCall *voip::VAccount::findCall(int call_id)
+{
+    std::lock_guard<std::mutex> lock(calls_mutex_);
+    for (VCall *call : calls_) {
+        if (!call->disconnected() && call->getId() == call_id) {
+            return call;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<voip::VStreamSample> voip::VAccount::streamHistory(int call_id)
+{
+    return stream_sampler_.history(call_id);
+}
+
+bool voip::VAccount::aiAutoAttach() const
+{
+    return ai_auto_attach_;
+}
+
+voip::VAdmission &voip::VAccount::admission()
+{
+    return admission_;
+}
+
+voip::VAiPortPool *voip::VAccount::aiPool()
+{
+    return ai_pool_.get();
 }
\ No newline at end of file
@@ -1,8 +1,22 @@
+#include "vadmission.h"
+#include "vaiclient.h"
+#include "vstreamstats.h"
+
 #include <pjsua2.hpp>
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 namespace voip {
 
 class VCall;
+struct VCallOutcome;
+class VAiPortPool;
+class VConfig;
+class VGauge;
 
 class VAccount : public pj::Account
 {
@@ -11,6 +25,9 @@ public:
 
     ~VAccount();
 
+    void
+    configure(const VConfig &cfg);
+
     // 注册状态改变
     virtual void
     onRegState(pj::OnRegStateParam &prm) override;
@@ -19,7 +36,61 @@ public:
     virtual void
     onIncomingCall(pj::OnIncomingCallParam &iprm) override;
 
+    // 呼叫对象由账号持有, 断开后由主线程 reapCalls() 释放
+    void
+    addCall(VCall *call);
+
+    void
+    reapCalls();
+
+    void
+    hangupAll();
+
+    // 呼出并登记, 失败时返回空 (已计入 voip_calls_failed_total)
+    // on_outcome 在呼叫断开时于 pjsua 线程调用; 返回空时不会调用
+    VCall *
+    makeCall(const std::string &uri, std::function<void(const VCallOutcome &)> on_outcome = nullptr);
+
+    // 未断开的呼叫快照; 指针在主线程下一次 reapCalls() 之前有效
+    std::vector<VCall *>
+    calls();
+
+    // 按 pjsua 呼叫 id 查找未断开的呼叫, 有效期同 calls()
+    VCall *
+    findCall(int call_id);
+
+    // 该呼叫的 RTP 统计采样, 从旧到新
+    std::vector<VStreamSample>
+    streamHistory(int call_id);
+
+    // ai.auto_attach: 有端口池时新呼叫是否自动接 AI, 否则由控制接口按需打开
+    bool
+    aiAutoAttach() const;
+
+    VAdmission &
+    admission();
+
+    // ai.enabled 关闭时为空, 呼叫继续走本地音频设备
+    VAiPortPool *
+    aiPool();
+
     VCall *cur_call = nullptr;
+
+private:
+    // 当前注册状态对应的 voip_registrations 序列
+    VGauge *reg_gauge_ = nullptr;
+
+    VAdmission admission_;
+
+    VAiClient ai_client_;
+    std::unique_ptr<VAiPortPool> ai_pool_;
+
+    std::mutex calls_mutex_;
+    std::vector<VCall *> calls_;
+
+    VStreamSampler stream_sampler_;
+
+    bool ai_auto_attach_ = true;
 };
 
 } // namespace voip
@@ -0,0 +1,147 @@
+#include "vadmission.h"
+#include "vaudiobudget.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <cstdio>
+#include <ctime>
+#include <unistd.h>
+
+namespace {
+
+const int64_t CPU_SAMPLE_MS = 250;
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VCounter &admit_total = metrics.counter("voip_admission_total", "Incoming call admission decisions", "decision=\"admit\"");
+voip::VCounter &busy_total = metrics.counter("voip_admission_total", "Incoming call admission decisions", "decision=\"busy\"");
+voip::VCounter &cpu_total = metrics.counter("voip_admission_total", "Incoming call admission decisions", "decision=\"overload_cpu\"");
+voip::VCounter &queue_total = metrics.counter("voip_admission_total", "Incoming call admission decisions", "decision=\"overload_queue\"");
+voip::VCounter &memory_total = metrics.counter("voip_admission_total", "Incoming call admission decisions", "decision=\"overload_memory\"");
+voip::VGauge &in_progress_gauge = metrics.gauge("voip_calls_in_progress", "Calls admitted or placed and not yet disconnected");
+voip::VGauge &ai_queue_frames = metrics.gauge("voip_ai_queue_frames", "Audio frames queued towards or from the AI backend");
+
+int64_t
+clockNs(clockid_t clock)
+{
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+} // namespace
+
+voip::VAdmission::VAdmission()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    ncpu_ = n > 0 ? static_cast<unsigned>(n) : 1;
+}
+
+void voip::VAdmission::configure(const VConfig &cfg)
+{
+    max_calls_ = cfg.getInt("admission.max_calls", 1);
+    max_cpu_pct_ = cfg.getInt("admission.max_cpu_pct", 90);
+    max_ai_queue_frames_ = cfg.getInt("admission.max_ai_queue_frames", 0);
+    retry_after_sec_ = cfg.getInt("admission.retry_after_sec", 5);
+    VLOG_INFO << ">>> admission: max_calls=" << max_calls_ << " max_cpu_pct=" << max_cpu_pct_
+              << " max_ai_queue_frames=" << max_ai_queue_frames_;
+}
+
+voip::VAdmission::Decision voip::VAdmission::decide()
+{
+    Decision decision = ADMIT;
+    if (in_progress_.load(std::memory_order_relaxed) >= max_calls_) {
+        decision = REJECT_BUSY;
+    }
+    else if (max_cpu_pct_ > 0 && cpuPercent() >= max_cpu_pct_) {
+        decision = REJECT_OVERLOAD_CPU;
+    }
+    else if (max_ai_queue_frames_ > 0 && ai_queue_frames.value() >= max_ai_queue_frames_) {
+        decision = REJECT_OVERLOAD_QUEUE;
+    }
+    else if (VAudioBudget::instance().rejecting()) {
+        decision = REJECT_OVERLOAD_MEMORY;
+    }
+
+    switch (decision) {
+    case ADMIT:
+        admit_total.inc();
+        break;
+    case REJECT_BUSY:
+        busy_total.inc();
+        break;
+    case REJECT_OVERLOAD_CPU:
+        cpu_total.inc();
+        break;
+    case REJECT_OVERLOAD_QUEUE:
+        queue_total.inc();
+        break;
+    case REJECT_OVERLOAD_MEMORY:
+        memory_total.inc();
+        break;
+    }
+    return decision;
+}
+
+void voip::VAdmission::reject(int call_id, Decision decision)
+{
+    pjsua_msg_data msg_data;
+    pjsua_msg_data_init(&msg_data);
+
+    unsigned code = PJSIP_SC_BUSY_HERE;
+    pjsip_generic_string_hdr retry_after;
+    char name[] = "Retry-After";
+    char value[16];
+    if (decision != REJECT_BUSY) {
+        code = PJSIP_SC_SERVICE_UNAVAILABLE;
+        std::snprintf(value, sizeof(value), "%u", retry_after_sec_);
+        pj_str_t hname = pj_str(name);
+        pj_str_t hvalue = pj_str(value);
+        pjsip_generic_string_hdr_init2(&retry_after, &hname, &hvalue);
+        pj_list_push_back(&msg_data.hdr_list, &retry_after);
+    }
+
+    pj_status_t status = pjsua_call_hangup(call_id, code, nullptr, &msg_data);
+    if (status != PJ_SUCCESS) {
+        VLOG_ERROR << ">>> error rejecting call ID " << call_id << ": status " << status;
+    }
+}
+
+void voip::VAdmission::callStarted()
+{
+    in_progress_.fetch_add(1, std::memory_order_relaxed);
+    in_progress_gauge.inc();
+}
+
+void voip::VAdmission::callEnded()
+{
+    in_progress_.fetch_sub(1, std::memory_order_relaxed);
+    in_progress_gauge.dec();
+}
+
+unsigned voip::VAdmission::callsInProgress() const
+{
+    return in_progress_.load(std::memory_order_relaxed);
+}
+
+unsigned voip::VAdmission::cpuPercent()
+{
+    int64_t wall_ns = clockNs(CLOCK_MONOTONIC);
+    int64_t last_wall_ns = cpu_sample_wall_ns_.load(std::memory_order_relaxed);
+    if (wall_ns - last_wall_ns < CPU_SAMPLE_MS * 1000000) {
+        return cpu_pct_.load(std::memory_order_relaxed);
+    }
+    // 只有抢到本次采样的线程更新, 其余线程沿用上一次的值
+    if (!cpu_sample_wall_ns_.compare_exchange_strong(last_wall_ns, wall_ns)) {
+        return cpu_pct_.load(std::memory_order_relaxed);
+    }
+
+    int64_t cpu_ns = clockNs(CLOCK_PROCESS_CPUTIME_ID);
+    int64_t last_cpu_ns = cpu_sample_cpu_ns_.exchange(cpu_ns);
+    if (last_wall_ns != 0) {
+        int64_t elapsed = (wall_ns - last_wall_ns) * ncpu_;
+        cpu_pct_.store(static_cast<unsigned>((cpu_ns - last_cpu_ns) * 100 / elapsed), std::memory_order_relaxed);
+    }
+    return cpu_pct_.load(std::memory_order_relaxed);
+}
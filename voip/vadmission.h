@@ -0,0 +1,70 @@
+#ifndef _VADMISSION_H_
+#define _VADMISSION_H_
+
+#include <pjsua2.hpp>
+
+#include <atomic>
+#include <cstdint>
+
+namespace voip {
+
+class VConfig;
+
+// 呼入准入控制
+// 在 onIncomingCall 里用几次原子读判断并发数、进程 CPU、AI 队列深度和音频缓冲用量,
+// 超限时直接以 pjsua call id 回 486 / 503 + Retry-After, 不构造 pj::Call 包装对象
+class VAdmission
+{
+public:
+    enum Decision {
+        ADMIT,
+        REJECT_BUSY,          // 并发已满, 486
+        REJECT_OVERLOAD_CPU,  // CPU 过载, 503
+        REJECT_OVERLOAD_QUEUE, // AI 队列积压, 503
+        REJECT_OVERLOAD_MEMORY // 音频缓冲超出内存预算 (audio.budget.policy = reject), 503
+    };
+
+    VAdmission();
+
+    // admission.* 配置
+    void
+    configure(const VConfig &cfg);
+
+    Decision
+    decide();
+
+    // 按决策拒绝呼入
+    void
+    reject(int call_id, Decision decision);
+
+    // 进行中的呼叫计数, 由 VCall 维护
+    void
+    callStarted();
+
+    void
+    callEnded();
+
+    unsigned
+    callsInProgress() const;
+
+private:
+    // 进程 CPU 占用 (占全部核心的百分比), 最多每 CPU_SAMPLE_MS 重新采样一次
+    unsigned
+    cpuPercent();
+
+    unsigned max_calls_ = 1;
+    unsigned max_cpu_pct_ = 90;
+    int64_t max_ai_queue_frames_ = 0;
+    unsigned retry_after_sec_ = 5;
+
+    std::atomic<unsigned> in_progress_ {0};
+
+    std::atomic<int64_t> cpu_sample_wall_ns_ {0};
+    std::atomic<int64_t> cpu_sample_cpu_ns_ {0};
+    std::atomic<unsigned> cpu_pct_ {0};
+    unsigned ncpu_ = 1;
+};
+
+} // namespace voip
+
+#endif // _VADMISSION_H_
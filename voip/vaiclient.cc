@@ -0,0 +1,219 @@
+#include "vaiclient.h"
+#include "vaimux.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <algorithm>
+
+namespace {
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VCounter &requests_total = metrics.counter("voip_ai_requests_total", "Audio chunks sent to the AI backend");
+voip::VCounter &packets_total = metrics.counter("voip_ai_response_packets_total", "Response packets delivered by the AI backend");
+voip::VCounter &bytes_up = metrics.counter("voip_ai_bytes_total", "Audio payload bytes exchanged with the AI backend", "dir=\"up\"");
+voip::VCounter &bytes_down = metrics.counter("voip_ai_bytes_total", "Audio payload bytes exchanged with the AI backend", "dir=\"down\"");
+voip::VHistogram &rtt_hist = metrics.histogram("voip_ai_rtt_seconds", "AI request round-trip time");
+voip::VHistogram &queue_hist = metrics.histogram("voip_ai_backend_queue_seconds", "Time AI requests waited for the backend");
+voip::VGauge &pending_requests = metrics.gauge("voip_ai_pending_requests", "AI requests waiting for a response");
+
+} // namespace
+
+voip::VAiClient::VAiClient()
+{
+}
+
+voip::VAiClient::~VAiClient()
+{
+    stop();
+}
+
+void voip::VAiClient::start(const VConfig &cfg)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return;
+    }
+    if (cfg.getString("ai.backend", "echo") == "mux") {
+        mux_.reset(new VAiMux());
+        mux_->start(cfg);
+        running_ = true;
+        return;
+    }
+    delay_ = std::chrono::milliseconds(cfg.getInt("ai.echo_delay_ms", 500));
+    overhead_ = std::chrono::milliseconds(cfg.getInt("ai.echo_overhead_ms", 0));
+    speed_ = cfg.getDouble("ai.echo_speed", 0);
+    stream_ = cfg.getBool("ai.stream", true);
+    packet_ms_ = std::max(1, static_cast<int>(cfg.getInt("ai.echo_packet_ms", 60)));
+    running_ = true;
+    worker_ = std::thread(&VAiClient::run, this);
+    VLOG_INFO << ">>> AI client started (echo backend, delay " << delay_.count() << " ms, "
+              << (stream_ ? "streaming" : "whole") << " responses)";
+}
+
+void voip::VAiClient::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    if (mux_) {
+        mux_->stop();
+        return;
+    }
+    cv_.notify_one();
+    worker_.join();
+
+    pending_requests.dec(static_cast<int64_t>(queue_.size()));
+    in_flight_ -= queue_.size();
+    queue_.clear();
+}
+
+bool voip::VAiClient::send(VAiChunk &&chunk, Callback on_response)
+{
+    if (mux_) {
+        requests_total.inc();
+        bytes_up.inc(chunk.frame_bytes.empty() ? chunk.samples.size() * sizeof(int16_t) : chunk.payload.size());
+        return mux_->send(std::move(chunk), std::move(on_response));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        // 首次回调: 流式为第一个包生成完, 否则为整段生成完
+        size_t total = duration(chunk);
+        size_t first = stream_ ? std::min(packetSamples(chunk), total) : total;
+        auto due = now + delay_ + generation(first, chunk.clock_rate);
+        bytes_up.inc(chunk.frame_bytes.empty() ? chunk.samples.size() * sizeof(int16_t) : chunk.payload.size());
+        queue_.push_back(Request {now, due, std::move(chunk), 0, 0, std::move(on_response)});
+        std::push_heap(queue_.begin(), queue_.end(), Later());
+        ++in_flight_;
+    }
+    requests_total.inc();
+    pending_requests.inc();
+    cv_.notify_one();
+    return true;
+}
+
+void voip::VAiClient::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        if (queue_.empty()) {
+            cv_.wait(lock);
+            continue;
+        }
+        auto due = queue_.front().due;
+        if (std::chrono::steady_clock::now() < due) {
+            cv_.wait_until(lock, due);
+            continue;
+        }
+
+        std::pop_heap(queue_.begin(), queue_.end(), Later());
+        Request req = std::move(queue_.back());
+        queue_.pop_back();
+        lock.unlock();
+
+        VAiTiming timing {};
+        if (req.offset == 0) {
+            // 回声后端: 到期后才开始处理, 晚于到期的部分即排队
+            auto start = std::chrono::steady_clock::now();
+            if (overhead_.count() > 0) {
+                std::this_thread::sleep_for(overhead_);
+            }
+            timing.queued = std::chrono::duration_cast<std::chrono::microseconds>(start - req.due);
+            timing.rtt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - req.sent);
+            rtt_hist.observeUs(timing.rtt.count());
+            queue_hist.observeUs(timing.queued.count());
+        }
+
+        size_t total = duration(req.chunk);
+        size_t step = packetSamples(req.chunk);
+        size_t n = stream_ ? std::min(step, total - req.offset) : total;
+        VAiChunk packet;
+        packet.captured = req.chunk.captured;
+        packet.clock_rate = req.chunk.clock_rate;
+        packet.first = req.offset == 0;
+        packet.last = req.offset + n >= total;
+        slice(req, n, packet);
+        bool last = packet.last;
+        packets_total.inc();
+        bytes_down.inc(packet.frame_bytes.empty() ? packet.samples.size() * sizeof(int16_t) : packet.payload.size());
+        req.on_response(std::move(packet), timing);
+
+        lock.lock();
+        if (last) {
+            --in_flight_;
+            pending_requests.dec();
+        }
+        else {
+            // 下一个包在生成完后回调
+            req.due += generation(std::min(step, total - req.offset), req.chunk.clock_rate);
+            queue_.push_back(std::move(req));
+            std::push_heap(queue_.begin(), queue_.end(), Later());
+        }
+    }
+}
+
+std::chrono::microseconds voip::VAiClient::generation(size_t samples, unsigned clock_rate) const
+{
+    if (speed_ <= 0) {
+        return std::chrono::microseconds(0);
+    }
+    return std::chrono::microseconds(static_cast<int64_t>(samples * 1000000.0 / clock_rate / speed_));
+}
+
+size_t voip::VAiClient::duration(const VAiChunk &chunk) const
+{
+    return chunk.frame_bytes.empty() ? chunk.samples.size() : chunk.frame_bytes.size() * (chunk.clock_rate / 50);
+}
+
+size_t voip::VAiClient::packetSamples(const VAiChunk &chunk) const
+{
+    size_t packet_samples = std::max<size_t>(1, static_cast<size_t>(packet_ms_) * chunk.clock_rate / 1000);
+    if (chunk.frame_bytes.empty()) {
+        return packet_samples;
+    }
+    size_t frame_samples = chunk.clock_rate / 50;
+    return std::max<size_t>(1, packet_samples / frame_samples) * frame_samples;
+}
+
+void voip::VAiClient::slice(Request &req, size_t n, VAiChunk &packet) const
+{
+    VAiChunk &chunk = req.chunk;
+    if (packet.first && packet.last) {
+        packet.samples = std::move(chunk.samples);
+        packet.payload = std::move(chunk.payload);
+        packet.frame_bytes = std::move(chunk.frame_bytes);
+    }
+    else if (chunk.frame_bytes.empty()) {
+        packet.samples.assign(chunk.samples.begin() + req.offset, chunk.samples.begin() + req.offset + n);
+    }
+    else {
+        size_t frame_samples = chunk.clock_rate / 50;
+        auto frame = chunk.frame_bytes.begin() + req.offset / frame_samples;
+        packet.frame_bytes.assign(frame, frame + n / frame_samples);
+        size_t bytes = 0;
+        for (uint16_t b : packet.frame_bytes) {
+            bytes += b;
+        }
+        packet.payload.assign(chunk.payload.begin() + req.byte_offset, chunk.payload.begin() + req.byte_offset + bytes);
+        req.byte_offset += bytes;
+    }
+    req.offset += n;
+}
+
+size_t voip::VAiClient::pending()
+{
+    if (mux_) {
+        return mux_->pending();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return in_flight_;
+}
@@ -0,0 +1,129 @@
+#ifndef _VAICLIENT_H_
+#define _VAICLIENT_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace voip {
+
+class VConfig;
+class VAiMux;
+
+// 一段 16 bit 单声道 PCM, 或其 Opus 编码 (ai.codec = opus)
+// 上行为一个分片; 下行为一轮回复的全部或其中一个流式包
+struct VAiChunk
+{
+    std::vector<int16_t> samples;
+    // Opus 编码时 samples 为空, payload 依次存放每个 20 ms 帧, frame_bytes 为各帧字节数
+    std::vector<uint8_t> payload;
+    std::vector<uint16_t> frame_bytes;
+    unsigned clock_rate = 8000; // 各路呼叫的端口采样率可以不同, 随分片携带
+    uint32_t stream = 0;        // 所属呼叫, 多路复用连接上的流 id
+    // 上行分片最后一帧到达的时刻, 回复开始播放时据此统计首音时延
+    std::chrono::steady_clock::time_point captured;
+    bool first = true; // 一轮回复的第一个包
+    bool last = true;  // 一轮回复的最后一个包
+};
+
+// 单个请求的耗时, 流式回复时为首包
+struct VAiTiming
+{
+    std::chrono::microseconds rtt;    // 发出到回复
+    std::chrono::microseconds queued; // 在后端排队等待的部分
+};
+
+// AI 服务客户端
+// ai.backend = mux 时请求经所有呼叫共用的多路复用连接发往远端 (见 VAiMux), 回调在连接的 IO 线程上
+// 否则为进程内回声占位: 请求由一个工作线程按序处理, 回复也在该线程上回调; ai.echo_delay_ms 后开始返回, 每个请求另占用后端 ai.echo_overhead_ms (串行),
+// 以 ai.echo_speed 倍实时速度生成回复; ai.stream 打开时每 ai.echo_packet_ms 回调一个包, 否则生成完再整段回调
+// Opus 编码的分片按整帧切包, 原样回送
+class VAiClient
+{
+public:
+    // 流式回复时每个包回调一次, timing 只在 first 包上有意义
+    // 请求作废 (如 mux 连接断开) 时回调一次不带音频的 last 包
+    using Callback = std::function<void(VAiChunk &&, const VAiTiming &)>;
+
+    VAiClient();
+    ~VAiClient();
+
+    void
+    start(const VConfig &cfg);
+
+    void
+    stop();
+
+    // 不阻塞, 可在媒体线程调用
+    // 返回 false 表示分片被丢弃 (未启动或连接断开), on_response 不会被调用, 为它预占的资源由调用方归还
+    bool
+    send(VAiChunk &&chunk, Callback on_response);
+
+    // 已发出但回调尚未返回的请求数
+    size_t
+    pending();
+
+private:
+    struct Request
+    {
+        std::chrono::steady_clock::time_point sent;
+        std::chrono::steady_clock::time_point due; // 下一次回调的时刻
+        VAiChunk chunk;
+        size_t offset;      // 已回调的样本数
+        size_t byte_offset; // Opus 编码时已回调的字节数
+        Callback on_response;
+    };
+
+    // 按 due 排序的小顶堆
+    struct Later
+    {
+        bool
+        operator()(const Request &a, const Request &b) const
+        {
+            return a.due > b.due;
+        }
+    };
+
+    void
+    run();
+
+    // 回声后端以 clock_rate 生成 samples 个样本所需时间
+    std::chrono::microseconds
+    generation(size_t samples, unsigned clock_rate) const;
+
+    // 分片时长 (样本数), 编码与否都适用
+    size_t
+    duration(const VAiChunk &chunk) const;
+
+    // 单个流式包的样本数, Opus 编码时取整帧
+    size_t
+    packetSamples(const VAiChunk &chunk) const;
+
+    // 从 req 中切出接下来 n 个样本作为一个包
+    void
+    slice(Request &req, size_t n, VAiChunk &packet) const;
+
+    std::chrono::milliseconds delay_ {500};
+    std::chrono::milliseconds overhead_ {0};
+    double speed_ = 0;
+    bool stream_ = true;
+    unsigned packet_ms_ = 60;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Request> queue_;
+    size_t in_flight_ = 0;
+    bool running_ = false;
+    std::thread worker_;
+
+    std::unique_ptr<VAiMux> mux_;
+};
+
+} // namespace voip
+
+#endif // _VAICLIENT_H_
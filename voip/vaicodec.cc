@@ -0,0 +1,140 @@
+#include "vaicodec.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <algorithm>
+
+namespace {
+
+// 单帧 Opus 包上限, 见 RFC 6716
+const int MAX_PACKET_BYTES = 1275;
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VHistogram &encode_latency = metrics.histogram("voip_ai_codec_seconds", "Opus time per AI chunk or packet", "op=\"encode\"");
+voip::VHistogram &decode_latency = metrics.histogram("voip_ai_codec_seconds", "Opus time per AI chunk or packet", "op=\"decode\"");
+voip::VCounter &codec_errors = metrics.counter("voip_ai_codec_errors_total", "Opus encode or decode failures on the AI path");
+
+} // namespace
+
+voip::VAiCodecConfig voip::VAiCodecConfig::fromConfig(const VConfig &cfg)
+{
+    VAiCodecConfig c;
+    c.opus = cfg.getString("ai.codec", "pcm") == "opus";
+    c.bitrate = cfg.getInt("ai.opus.bitrate", c.bitrate);
+    c.complexity = cfg.getInt("ai.opus.complexity", c.complexity);
+    return c;
+}
+
+voip::VAiEncoder::VAiEncoder(unsigned clock_rate, const VAiCodecConfig &cfg) :
+    frame_samples_(clock_rate / 50)
+{
+    int err = OPUS_OK;
+    enc_ = opus_encoder_create(static_cast<opus_int32>(clock_rate), 1, OPUS_APPLICATION_VOIP, &err);
+    if (err != OPUS_OK) {
+        VLOG_ERROR << ">>> opus encoder: " << opus_strerror(err);
+        enc_ = nullptr;
+        return;
+    }
+    opus_encoder_ctl(enc_, OPUS_SET_BITRATE(cfg.bitrate));
+    opus_encoder_ctl(enc_, OPUS_SET_COMPLEXITY(cfg.complexity));
+    opus_encoder_ctl(enc_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    pad_.resize(frame_samples_);
+}
+
+voip::VAiEncoder::~VAiEncoder()
+{
+    if (enc_) {
+        opus_encoder_destroy(enc_);
+    }
+}
+
+void voip::VAiEncoder::reset()
+{
+    if (enc_) {
+        opus_encoder_ctl(enc_, OPUS_RESET_STATE);
+    }
+}
+
+void voip::VAiEncoder::encode(VAiChunk &chunk)
+{
+    if (!enc_) {
+        return;
+    }
+    VScopedLatency latency(encode_latency);
+    size_t frames = (chunk.samples.size() + frame_samples_ - 1) / frame_samples_;
+    chunk.payload.resize(frames * MAX_PACKET_BYTES);
+    chunk.frame_bytes.clear();
+    chunk.frame_bytes.reserve(frames);
+
+    size_t used = 0;
+    for (size_t i = 0; i < frames; ++i) {
+        const int16_t *pcm = chunk.samples.data() + i * frame_samples_;
+        size_t left = chunk.samples.size() - i * frame_samples_;
+        if (left < frame_samples_) {
+            std::fill(std::copy(pcm, pcm + left, pad_.begin()), pad_.end(), 0);
+            pcm = pad_.data();
+        }
+        opus_int32 n = opus_encode(enc_, pcm, static_cast<int>(frame_samples_), &chunk.payload[used], MAX_PACKET_BYTES);
+        if (n < 0) {
+            codec_errors.inc();
+            n = 0;
+        }
+        chunk.frame_bytes.push_back(static_cast<uint16_t>(n));
+        used += n;
+    }
+    chunk.payload.resize(used);
+    chunk.samples.clear();
+}
+
+voip::VAiDecoder::VAiDecoder(unsigned clock_rate) :
+    frame_samples_(clock_rate / 50)
+{
+    int err = OPUS_OK;
+    dec_ = opus_decoder_create(static_cast<opus_int32>(clock_rate), 1, &err);
+    if (err != OPUS_OK) {
+        VLOG_ERROR << ">>> opus decoder: " << opus_strerror(err);
+        dec_ = nullptr;
+    }
+}
+
+voip::VAiDecoder::~VAiDecoder()
+{
+    if (dec_) {
+        opus_decoder_destroy(dec_);
+    }
+}
+
+void voip::VAiDecoder::reset()
+{
+    if (dec_) {
+        opus_decoder_ctl(dec_, OPUS_RESET_STATE);
+    }
+}
+
+void voip::VAiDecoder::decode(VAiChunk &chunk)
+{
+    if (!dec_ || chunk.frame_bytes.empty()) {
+        return;
+    }
+    VScopedLatency latency(decode_latency);
+    chunk.samples.resize(chunk.frame_bytes.size() * frame_samples_);
+
+    size_t offset = 0;
+    size_t decoded = 0;
+    for (uint16_t bytes : chunk.frame_bytes) {
+        // 0 字节帧按丢包处理, 由解码器做丢包隐藏
+        const unsigned char *data = bytes > 0 ? &chunk.payload[offset] : nullptr;
+        int n = opus_decode(dec_, data, bytes, chunk.samples.data() + decoded, static_cast<int>(frame_samples_), 0);
+        if (n < 0) {
+            codec_errors.inc();
+            n = 0;
+        }
+        decoded += n;
+        offset += bytes;
+    }
+    chunk.samples.resize(decoded);
+    chunk.payload.clear();
+    chunk.frame_bytes.clear();
+}
@@ -0,0 +1,68 @@
+#ifndef _VAICODEC_H_
+#define _VAICODEC_H_
+
+#include "vaiclient.h"
+
+#include <opus/opus.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace voip {
+
+class VConfig;
+
+// AI 链路的编解码参数 (ai.codec, ai.opus.*)
+struct VAiCodecConfig
+{
+    bool opus = false;
+    int bitrate = 16000;
+    int complexity = 5;
+
+    static VAiCodecConfig
+    fromConfig(const VConfig &cfg);
+};
+
+// 上行 Opus 编码, 每路呼叫一个, 随端口对复用
+// 编码器状态在构造时一次分配, attach 时只重置
+class VAiEncoder
+{
+public:
+    VAiEncoder(unsigned clock_rate, const VAiCodecConfig &cfg);
+    ~VAiEncoder();
+
+    void
+    reset();
+
+    // chunk.samples 编码为 20 ms 一帧写入 chunk.payload / chunk.frame_bytes, 末帧不足时补零
+    void
+    encode(VAiChunk &chunk);
+
+private:
+    OpusEncoder *enc_ = nullptr;
+    unsigned frame_samples_;
+    std::vector<int16_t> pad_;
+};
+
+// 下行 Opus 解码, 与 VAiEncoder 对应
+class VAiDecoder
+{
+public:
+    explicit VAiDecoder(unsigned clock_rate);
+    ~VAiDecoder();
+
+    void
+    reset();
+
+    // chunk.payload 解码到 chunk.samples, 之后 payload 清空
+    void
+    decode(VAiChunk &chunk);
+
+private:
+    OpusDecoder *dec_ = nullptr;
+    unsigned frame_samples_;
+};
+
+} // namespace voip
+
+#endif // _VAICODEC_H_
@@ -0,0 +1,434 @@
+#include "vaimux.h"
+#include "vaiwire.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// 一次 sendmsg 最多聚合的帧数
+const size_t MAX_IOV = 64;
+const size_t READ_SIZE = 64 * 1024;
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VCounter &packets_total = metrics.counter("voip_ai_response_packets_total", "Response packets delivered by the AI backend");
+voip::VCounter &bytes_down = metrics.counter("voip_ai_bytes_total", "Audio payload bytes exchanged with the AI backend", "dir=\"down\"");
+voip::VHistogram &rtt_hist = metrics.histogram("voip_ai_rtt_seconds", "AI request round-trip time");
+voip::VHistogram &queue_hist = metrics.histogram("voip_ai_backend_queue_seconds", "Time AI requests waited for the backend");
+voip::VGauge &pending_requests = metrics.gauge("voip_ai_pending_requests", "AI requests waiting for a response");
+
+voip::VCounter &mux_connects = metrics.counter("voip_ai_mux_connects_total", "AI mux connections established");
+voip::VCounter &mux_errors = metrics.counter("voip_ai_mux_connection_errors_total", "AI mux connections lost or refused");
+voip::VCounter &mux_writes = metrics.counter("voip_ai_mux_writes_total", "Gathered socket writes on AI mux connections");
+voip::VCounter &mux_frames = metrics.counter("voip_ai_mux_frames_written_total", "Frames written on AI mux connections");
+voip::VCounter &mux_blocked = metrics.counter("voip_ai_mux_blocked_total", "AI requests held back by a full stream window");
+voip::VCounter &mux_dropped = metrics.counter("voip_ai_mux_dropped_total", "AI requests dropped because the connection was down");
+
+} // namespace
+
+voip::VAiMux::VAiMux()
+{
+}
+
+voip::VAiMux::~VAiMux()
+{
+    stop();
+}
+
+void voip::VAiMux::start(const VConfig &cfg)
+{
+    if (running_) {
+        return;
+    }
+    host_ = cfg.getString("ai.mux.host", host_);
+    port_ = cfg.getString("ai.mux.port", port_);
+    window_ = std::max<int64_t>(1, cfg.getInt("ai.mux.window_bytes", window_));
+    long n = std::max<long>(1, cfg.getInt("ai.mux.connections", 1));
+
+    running_ = true;
+    for (long i = 0; i < n; ++i) {
+        std::unique_ptr<Connection> conn(new Connection);
+        conn->index = static_cast<unsigned>(i);
+        conn->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        conns_.push_back(std::move(conn));
+    }
+    for (auto &conn : conns_) {
+        Connection *c = conn.get();
+        c->io = std::thread([this, c]() { run(*c); });
+    }
+    VLOG_INFO << ">>> AI mux: " << n << " connections to " << host_ << ":" << port_ << ", window " << window_ << " bytes per stream";
+}
+
+void voip::VAiMux::stop()
+{
+    if (!running_.exchange(false)) {
+        return;
+    }
+    for (auto &conn : conns_) {
+        wake(*conn);
+    }
+    for (auto &conn : conns_) {
+        conn->io.join();
+        if (conn->fd >= 0) {
+            fail(*conn, "stopped");
+        }
+        close(conn->wake_fd);
+    }
+    conns_.clear();
+}
+
+bool voip::VAiMux::send(VAiChunk &&chunk, VAiClient::Callback on_response)
+{
+    if (!running_ || conns_.empty()) {
+        mux_dropped.inc();
+        return false;
+    }
+    Connection &conn = *conns_[chunk.stream % conns_.size()];
+
+    VAiWireHeader header;
+    header.stream = chunk.stream;
+    header.request = next_request_.fetch_add(1, std::memory_order_relaxed);
+    header.type = VAiWireHeader::REQUEST;
+    header.value = chunk.clock_rate;
+    std::vector<uint8_t> frame;
+    aiWireEncode(header, chunk, frame);
+    size_t bytes = frame.size() - VAiWireHeader::SIZE;
+
+    {
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        if (!conn.connected) {
+            mux_dropped.inc();
+            return false;
+        }
+        conn.requests[header.request] = Request {chunk.stream, std::chrono::steady_clock::now(), chunk.captured,
+                                                 chunk.clock_rate,
+                                                 std::make_shared<VAiClient::Callback>(std::move(on_response))};
+        // 帧入队之前计数, 否则 IO 线程收到回复先减, 计数会短暂回绕
+        in_flight_.fetch_add(1, std::memory_order_relaxed);
+        pending_requests.inc();
+        auto ins = conn.streams.emplace(chunk.stream, Stream());
+        Stream &stream = ins.first->second;
+        if (ins.second) {
+            stream.window = window_;
+        }
+        // 窗口全空时单个超大分片也放行, 避免卡死
+        if (stream.blocked.empty() && (stream.window >= static_cast<int64_t>(bytes) || stream.window == window_)) {
+            stream.window -= static_cast<int64_t>(bytes);
+            conn.out.push_back(std::move(frame));
+        }
+        else {
+            stream.blocked.push_back(Blocked {std::move(frame), bytes});
+            mux_blocked.inc();
+        }
+    }
+    wake(conn);
+    return true;
+}
+
+size_t voip::VAiMux::pending() const
+{
+    return in_flight_.load(std::memory_order_relaxed);
+}
+
+void voip::VAiMux::run(Connection &conn)
+{
+    auto backoff = std::chrono::milliseconds(100);
+    while (running_) {
+        if (conn.fd < 0) {
+            if (!connect(conn)) {
+                // 退避期间也响应 stop()
+                pollfd pfd {conn.wake_fd, POLLIN, 0};
+                poll(&pfd, 1, static_cast<int>(backoff.count()));
+                uint64_t v;
+                while (read(conn.wake_fd, &v, sizeof(v)) > 0) {
+                }
+                backoff = std::min(backoff * 2, std::chrono::milliseconds(2000));
+                continue;
+            }
+            backoff = std::chrono::milliseconds(100);
+        }
+
+        bool has_out;
+        {
+            std::lock_guard<std::mutex> lock(conn.mutex);
+            has_out = !conn.out.empty();
+        }
+        pollfd fds[2];
+        fds[0] = pollfd {conn.fd, static_cast<short>(POLLIN | (has_out ? POLLOUT : 0)), 0};
+        fds[1] = pollfd {conn.wake_fd, POLLIN, 0};
+        if (poll(fds, 2, 1000) < 0 && errno != EINTR) {
+            fail(conn, std::strerror(errno));
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t v;
+            while (read(conn.wake_fd, &v, sizeof(v)) > 0) {
+            }
+        }
+        if ((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) && !receive(conn)) {
+            continue;
+        }
+        if (!flush(conn)) {
+            fail(conn, std::strerror(errno));
+        }
+    }
+}
+
+bool voip::VAiMux::connect(Connection &conn)
+{
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *res = nullptr;
+    if (getaddrinfo(host_.c_str(), port_.c_str(), &hints, &res) != 0) {
+        mux_errors.inc();
+        return false;
+    }
+    int fd = -1;
+    for (addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd >= 0 && ::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0) {
+        mux_errors.inc();
+        VLOG_DEBUG << ">>> AI mux connection " << conn.index << ": connect to " << host_ << ":" << port_ << " failed";
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    conn.fd = fd;
+    conn.rx.clear();
+    conn.rx_offset = 0;
+    {
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        conn.connected = true;
+    }
+    mux_connects.inc();
+    VLOG_INFO << ">>> AI mux connection " << conn.index << " established";
+    return true;
+}
+
+void voip::VAiMux::fail(Connection &conn, const char *why)
+{
+    std::vector<std::shared_ptr<VAiClient::Callback>> dropped_callbacks;
+    size_t dropped;
+    {
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        conn.connected = false;
+        dropped = conn.requests.size();
+        for (auto &request : conn.requests) {
+            dropped_callbacks.push_back(request.second.on_response);
+        }
+        conn.requests.clear();
+        conn.streams.clear();
+        conn.out.clear();
+        conn.out_offset = 0;
+    }
+    close(conn.fd);
+    conn.fd = -1;
+    // 作废的请求各回调一个空的 last 包, 调用方据此归还记账
+    for (auto &on_response : dropped_callbacks) {
+        VAiChunk empty;
+        empty.first = false;
+        (*on_response)(std::move(empty), VAiTiming {});
+    }
+    in_flight_.fetch_sub(dropped, std::memory_order_relaxed);
+    pending_requests.dec(static_cast<int64_t>(dropped));
+    if (running_) {
+        mux_errors.inc();
+        VLOG_WARN << ">>> AI mux connection " << conn.index << " lost (" << why << "), " << dropped << " requests dropped";
+    }
+}
+
+bool voip::VAiMux::flush(Connection &conn)
+{
+    while (true) {
+        iovec iov[MAX_IOV];
+        size_t n = 0;
+        {
+            std::lock_guard<std::mutex> lock(conn.mutex);
+            for (auto it = conn.out.begin(); it != conn.out.end() && n < MAX_IOV; ++it, ++n) {
+                size_t skip = n == 0 ? conn.out_offset : 0;
+                iov[n].iov_base = it->data() + skip;
+                iov[n].iov_len = it->size() - skip;
+            }
+        }
+        if (n == 0) {
+            return true;
+        }
+
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        ssize_t written = sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+        if (written < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        mux_writes.inc();
+
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        size_t left = static_cast<size_t>(written);
+        while (left > 0) {
+            size_t rest = conn.out.front().size() - conn.out_offset;
+            if (left < rest) {
+                conn.out_offset += left;
+                return true;
+            }
+            left -= rest;
+            conn.out.pop_front();
+            conn.out_offset = 0;
+            mux_frames.inc();
+        }
+    }
+}
+
+bool voip::VAiMux::receive(Connection &conn)
+{
+    while (true) {
+        size_t used = conn.rx.size();
+        conn.rx.resize(used + READ_SIZE);
+        ssize_t n = recv(conn.fd, conn.rx.data() + used, READ_SIZE, 0);
+        if (n <= 0) {
+            conn.rx.resize(used);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                break;
+            }
+            fail(conn, n == 0 ? "closed by peer" : std::strerror(errno));
+            return false;
+        }
+        conn.rx.resize(used + static_cast<size_t>(n));
+    }
+
+    VAiWireHeader header;
+    while (aiWireHeader(conn.rx.data() + conn.rx_offset, conn.rx.size() - conn.rx_offset, header)) {
+        if (header.length > VAiWireHeader::MAX_LENGTH) {
+            fail(conn, "oversized frame");
+            return false;
+        }
+        size_t size = VAiWireHeader::SIZE + header.length;
+        if (conn.rx.size() - conn.rx_offset < size) {
+            break;
+        }
+        if (!dispatch(conn, conn.rx.data() + conn.rx_offset, size)) {
+            fail(conn, "malformed frame");
+            return false;
+        }
+        conn.rx_offset += size;
+    }
+    // 已处理的前缀积累到一定量再整体前移
+    if (conn.rx_offset == conn.rx.size()) {
+        conn.rx.clear();
+        conn.rx_offset = 0;
+    }
+    else if (conn.rx_offset > READ_SIZE) {
+        conn.rx.erase(conn.rx.begin(), conn.rx.begin() + conn.rx_offset);
+        conn.rx_offset = 0;
+    }
+    return true;
+}
+
+bool voip::VAiMux::dispatch(Connection &conn, const uint8_t *frame, size_t size)
+{
+    VAiWireHeader header;
+    aiWireHeader(frame, size, header);
+
+    if (header.type == VAiWireHeader::WINDOW) {
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        credit(conn, header.stream, header.value);
+        return true;
+    }
+    if (header.type != VAiWireHeader::RESPONSE) {
+        return false;
+    }
+
+    VAiChunk packet;
+    if (!aiWireChunk(header, frame + VAiWireHeader::SIZE, packet)) {
+        return false;
+    }
+    packet.first = (header.flags & VAiWireHeader::FIRST) != 0;
+    packet.last = (header.flags & VAiWireHeader::LAST) != 0;
+    packet.stream = header.stream;
+
+    std::shared_ptr<VAiClient::Callback> on_response;
+    VAiTiming timing {};
+    {
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        auto it = conn.requests.find(header.request);
+        if (it == conn.requests.end()) {
+            return true;
+        }
+        packet.captured = it->second.captured;
+        packet.clock_rate = it->second.clock_rate;
+        if (packet.first) {
+            timing.rtt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - it->second.sent);
+            timing.queued = std::chrono::microseconds(header.value);
+        }
+        on_response = it->second.on_response;
+        if (packet.last) {
+            conn.requests.erase(it);
+        }
+    }
+
+    if (packet.first) {
+        rtt_hist.observeUs(timing.rtt.count());
+        queue_hist.observeUs(timing.queued.count());
+    }
+    packets_total.inc();
+    bytes_down.inc(header.length);
+    bool last = packet.last;
+    (*on_response)(std::move(packet), timing);
+    if (last) {
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+        pending_requests.dec();
+    }
+    return true;
+}
+
+void voip::VAiMux::credit(Connection &conn, uint32_t stream_id, uint32_t bytes)
+{
+    auto it = conn.streams.find(stream_id);
+    if (it == conn.streams.end()) {
+        return;
+    }
+    Stream &stream = it->second;
+    stream.window += bytes;
+    while (!stream.blocked.empty()
+           && (stream.window >= static_cast<int64_t>(stream.blocked.front().bytes) || stream.window == window_)) {
+        stream.window -= static_cast<int64_t>(stream.blocked.front().bytes);
+        conn.out.push_back(std::move(stream.blocked.front().frame));
+        stream.blocked.pop_front();
+    }
+    // 空闲的流不保留状态, 呼叫结束后不会累积
+    if (stream.blocked.empty() && stream.window == window_) {
+        conn.streams.erase(it);
+    }
+}
+
+void voip::VAiMux::wake(Connection &conn)
+{
+    uint64_t one = 1;
+    ssize_t n = write(conn.wake_fd, &one, sizeof(one));
+    (void)n;
+}
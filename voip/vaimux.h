@@ -0,0 +1,131 @@
+#ifndef _VAIMUX_H_
+#define _VAIMUX_H_
+
+#include "vaiclient.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace voip {
+
+class VConfig;
+
+// 所有呼叫共用的 AI 后端连接 (ai.backend = mux)
+// 少量常驻 TCP 连接 (ai.mux.connections) 承载带呼叫流 id 的分帧音频, 帧格式见 vaiwire.h; 流按 id 固定到一条连接
+// 每条连接一个 IO 线程: 发送方只把编好的帧放进队列, IO 线程一次 sendmsg 聚合发出队列中的所有帧 (writev)
+// 每个流有发送窗口 (ai.mux.window_bytes): 已发出未被后端确认 (WINDOW) 的负载超过窗口时, 后续分片在本地排队
+// 连接断开时未完成的请求作废 (回调空的 last 包), IO 线程退避后重连
+class VAiMux
+{
+public:
+    VAiMux();
+    ~VAiMux();
+
+    // ai.mux.host / ai.mux.port / ai.mux.connections / ai.mux.window_bytes
+    void
+    start(const VConfig &cfg);
+
+    void
+    stop();
+
+    // 不阻塞, 可在媒体线程调用; 连接未建立时丢弃并返回 false, 此时不调用 on_response
+    bool
+    send(VAiChunk &&chunk, VAiClient::Callback on_response);
+
+    size_t
+    pending() const;
+
+private:
+    struct Request
+    {
+        uint32_t stream;
+        std::chrono::steady_clock::time_point sent;
+        std::chrono::steady_clock::time_point captured;
+        unsigned clock_rate;
+        std::shared_ptr<VAiClient::Callback> on_response;
+    };
+
+    // 因窗口不足暂存的帧
+    struct Blocked
+    {
+        std::vector<uint8_t> frame;
+        size_t bytes;
+    };
+
+    struct Stream
+    {
+        int64_t window = 0;
+        std::deque<Blocked> blocked;
+    };
+
+    struct Connection
+    {
+        unsigned index = 0;
+        int fd = -1;
+        int wake_fd = -1;
+        std::thread io;
+
+        std::mutex mutex;
+        bool connected = false;
+        // 只在尾部追加、IO 线程从头部取出, 元素引用在追加时保持有效, 发送时无需持锁
+        std::deque<std::vector<uint8_t>> out;
+        size_t out_offset = 0; // 队首帧已写出的字节数
+        std::map<uint32_t, Stream> streams;
+        std::unordered_map<uint32_t, Request> requests;
+
+        // 仅 IO 线程访问
+        std::vector<uint8_t> rx;
+        size_t rx_offset = 0;
+    };
+
+    void
+    run(Connection &conn);
+
+    bool
+    connect(Connection &conn);
+
+    // 连接断开, 作废其上的请求
+    void
+    fail(Connection &conn, const char *why);
+
+    // 聚合写出队列, 出错返回 false
+    bool
+    flush(Connection &conn);
+
+    // 读取并分发响应, 对端关闭或出错返回 false
+    bool
+    receive(Connection &conn);
+
+    // 处理一个完整的帧
+    bool
+    dispatch(Connection &conn, const uint8_t *frame, size_t size);
+
+    // 调用方持有 conn.mutex
+    void
+    credit(Connection &conn, uint32_t stream, uint32_t bytes);
+
+    void
+    wake(Connection &conn);
+
+    std::string host_ = "127.0.0.1";
+    std::string port_ = "7070";
+    int64_t window_ = 64 * 1024;
+
+    std::vector<std::unique_ptr<Connection>> conns_;
+    std::atomic<bool> running_ {false};
+    std::atomic<uint32_t> next_request_ {1};
+    std::atomic<size_t> in_flight_ {0};
+};
+
+} // namespace voip
+
+#endif // _VAIMUX_H_
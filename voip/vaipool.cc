@@ -0,0 +1,120 @@
+#include "vaipool.h"
+#include "vaiclient.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <string>
+
+namespace {
+
+// ai.clock_rate / ai.ptime_ms 跟随协商但协商值未知时使用, 与 test3 一致: 8 kHz 单声道 16 bit, 20 ms 一帧
+const unsigned DEFAULT_CLOCK_RATE = 8000;
+const unsigned DEFAULT_PTIME_MS = 20;
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VCounter &pool_hits = metrics.counter("voip_ai_pool_acquire_total", "AI port pairs taken for a call", "result=\"hit\"");
+voip::VCounter &pool_misses = metrics.counter("voip_ai_pool_acquire_total", "AI port pairs taken for a call", "result=\"miss\"");
+voip::VGauge &pool_free = metrics.gauge("voip_ai_pool_free", "Pre-created AI port pairs available");
+
+} // namespace
+
+voip::VAiPortPool::VAiPortPool(VAiClient &client) :
+    client_(client)
+{
+}
+
+voip::VAiPortPool::~VAiPortPool()
+{
+    pool_free.dec(static_cast<int64_t>(free_count_));
+}
+
+void voip::VAiPortPool::configure(const VConfig &cfg)
+{
+    clock_rate_ = cfg.getInt("ai.clock_rate", DEFAULT_CLOCK_RATE);
+    ptime_ms_ = cfg.getInt("ai.ptime_ms", DEFAULT_PTIME_MS);
+    playout_ = VPlayoutConfig::fromConfig(cfg);
+    chunking_ = VChunkConfig::fromConfig(cfg);
+    codec_ = VAiCodecConfig::fromConfig(cfg);
+
+    Format format(clock_rate_ ? clock_rate_ : DEFAULT_CLOCK_RATE, ptime_ms_ ? ptime_ms_ : DEFAULT_PTIME_MS);
+    long size = cfg.getInt("ai.pool_size", 4);
+    auto begin = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<VAiPorts *> &free = free_[format];
+    for (long i = 0; i < size; ++i) {
+        free.push_back(create(format));
+    }
+    free_count_ += size;
+    pool_free.inc(size);
+    VLOG_INFO << ">>> AI port pool: " << size << " pairs (" << format.first << " Hz, " << format.second << " ms, "
+              << (codec_.opus ? "opus" : "pcm") << ") pre-created in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count()
+              << " us";
+}
+
+voip::VAiPorts *voip::VAiPortPool::acquire(int call_id, std::chrono::steady_clock::time_point setup_begin,
+                                           unsigned codec_rate, unsigned codec_ptime_ms)
+{
+    unsigned rate = clock_rate_ ? clock_rate_ : (codec_rate ? codec_rate : DEFAULT_CLOCK_RATE);
+    unsigned ptime = ptime_ms_ ? ptime_ms_ : (codec_ptime_ms ? codec_ptime_ms : DEFAULT_PTIME_MS);
+    Format format(rate, ptime);
+
+    VAiPorts *ports = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<VAiPorts *> &free = free_[format];
+        if (!free.empty()) {
+            ports = free.back();
+            free.pop_back();
+            --free_count_;
+            pool_free.dec();
+            pool_hits.inc();
+        }
+        else {
+            ports = create(format);
+            pool_misses.inc();
+            VLOG_WARN << ">>> AI port pool has no " << rate << " Hz / " << ptime << " ms pair, creating ports for call " << call_id;
+        }
+    }
+
+    unsigned generation = ports->player->attach(call_id);
+    ports->processor->attach(call_id, generation, setup_begin);
+    return ports;
+}
+
+void voip::VAiPortPool::release(VAiPorts *ports)
+{
+    ports->processor->reset();
+    ports->player->reset();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_[Format(ports->clock_rate, ports->ptime_ms)].push_back(ports);
+    ++free_count_;
+    pool_free.inc();
+}
+
+// 调用方持有 mutex_
+voip::VAiPorts *voip::VAiPortPool::create(const Format &format)
+{
+    std::string index = std::to_string(all_.size());
+    unsigned rate = format.first;
+    unsigned ptime = format.second;
+    pj::MediaFormatAudio fmt;
+    fmt.init(PJMEDIA_FORMAT_PCM, rate, 1, ptime * 1000, 16);
+
+    std::unique_ptr<VAiPorts> ports(new VAiPorts);
+    ports->clock_rate = rate;
+    ports->ptime_ms = ptime;
+    ports->player.reset(new VAiPlayer(rate, rate * ptime / 1000));
+    ports->player->setPlayout(playout_);
+    ports->player->setCodec(codec_);
+    ports->processor.reset(new VAiProcessor(client_, *ports->player, rate));
+    ports->processor->setChunking(chunking_);
+    ports->processor->setCodec(codec_);
+    ports->player->createPort("ai_player" + index, fmt);
+    ports->processor->createPort("ai_processor" + index, fmt);
+    all_.push_back(std::move(ports));
+    return all_.back().get();
+}
@@ -0,0 +1,73 @@
+#ifndef _VAIPOOL_H_
+#define _VAIPOOL_H_
+
+#include "vaiport.h"
+
+#include <pjsua2.hpp>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace voip {
+
+class VAiClient;
+class VConfig;
+
+// 一路呼叫使用的一对 AI 端口
+struct VAiPorts
+{
+    std::unique_ptr<VAiPlayer> player;
+    std::unique_ptr<VAiProcessor> processor;
+    unsigned clock_rate;
+    unsigned ptime_ms;
+};
+
+// 预先创建的 AI 端口池
+// createPort 需要分配 pjmedia pool 和会议桥 slot, 放在启动时做, 呼叫应答后只取用和归还
+// 端口格式 (采样率, 帧长) 取自 ai.clock_rate / ai.ptime_ms, 配为 0 时跟随呼叫协商的编解码器;
+// 池按格式分组, 启动时预建缺省格式, 其它格式首次用到时创建, 归还后同样复用
+class VAiPortPool
+{
+public:
+    explicit VAiPortPool(VAiClient &client);
+    ~VAiPortPool();
+
+    // ai.pool_size / ai.clock_rate / ai.ptime_ms / ai.chunk_ms / ai.codec, 需在 libStart 之后调用
+    void
+    configure(const VConfig &cfg);
+
+    // codec_rate / codec_ptime_ms 为呼叫协商的编解码器参数, 未知时传 0
+    // 池空时现场创建 (计入 miss)
+    VAiPorts *
+    acquire(int call_id, std::chrono::steady_clock::time_point setup_begin, unsigned codec_rate = 0,
+            unsigned codec_ptime_ms = 0);
+
+    void
+    release(VAiPorts *ports);
+
+private:
+    using Format = std::pair<unsigned, unsigned>; // 采样率, 帧长 (ms)
+
+    VAiPorts *
+    create(const Format &format);
+
+    VAiClient &client_;
+    unsigned clock_rate_ = 8000; // 0 跟随协商
+    unsigned ptime_ms_ = 20;     // 0 跟随协商
+    VPlayoutConfig playout_;
+    VChunkConfig chunking_;
+    VAiCodecConfig codec_;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<VAiPorts>> all_;
+    std::map<Format, std::vector<VAiPorts *>> free_;
+    size_t free_count_ = 0;
+};
+
+} // namespace voip
+
+#endif // _VAIPOOL_H_
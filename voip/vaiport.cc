@@ -0,0 +1,529 @@
+#include "vaiport.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+#include "vtrace.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VCounter &frames_tx = metrics.counter("voip_media_frames_total", "Frames handled by custom media ports", "dir=\"tx\"");
+voip::VCounter &frames_rx = metrics.counter("voip_media_frames_total", "Frames handled by custom media ports", "dir=\"rx\"");
+voip::VCounter &underruns = metrics.counter("voip_ai_playout_underruns_total", "AI player frames padded with silence while a response was playing");
+voip::VCounter &stale_responses = metrics.counter("voip_ai_stale_responses_total", "AI responses dropped because their call had ended");
+voip::VGauge &ai_queue_frames = metrics.gauge("voip_ai_queue_frames", "Audio frames queued towards or from the AI backend");
+
+voip::VHistogram &frame_requested_latency = metrics.histogram("voip_callback_latency_seconds", "pjsua2 callback duration", "callback=\"onFrameRequested\"");
+voip::VHistogram &frame_received_latency = metrics.histogram("voip_callback_latency_seconds", "pjsua2 callback duration", "callback=\"onFrameReceived\"");
+voip::VHistogram &time_to_first_audio = metrics.histogram("voip_ai_time_to_first_audio_seconds", "Time from the end of an uplink chunk to the first audio of its response playing");
+voip::VCounter &rebuffers = metrics.counter("voip_ai_playout_rebuffers_total", "Streaming responses that ran dry mid-turn and were buffered again");
+voip::VHistogram &playout_delay = metrics.histogram("voip_ai_playout_delay_seconds", "AI player queueing delay, sampled every frame while a response is queued");
+voip::VCounter &playout_drops = metrics.counter("voip_ai_playout_corrections_total", "AI playout corrections", "type=\"drop\"");
+voip::VCounter &playout_inserts = metrics.counter("voip_ai_playout_corrections_total", "AI playout corrections", "type=\"insert\"");
+voip::VCounter &playout_discards = metrics.counter("voip_ai_playout_corrections_total", "AI playout corrections", "type=\"discard\"");
+voip::VHistogram &chunk_size_hist = metrics.histogram("voip_ai_chunk_seconds", "Duration of uplink chunks sent to the AI backend");
+voip::VCounter &chunk_resizes = metrics.counter("voip_ai_chunk_resizes_total", "Adaptive uplink chunk size changes");
+voip::VCounter &shed_oldest = metrics.counter("voip_audio_buffer_shed_bytes_total", "Audio dropped to stay within the buffer memory budget", "buffer=\"playout\",policy=\"drop_oldest\"");
+voip::VCounter &shed_newest = metrics.counter("voip_audio_buffer_shed_bytes_total", "Audio dropped to stay within the buffer memory budget", "buffer=\"playout\",policy=\"drop_newest\"");
+voip::VCounter &shed_uplink = metrics.counter("voip_audio_buffer_shed_bytes_total", "Audio dropped to stay within the buffer memory budget", "buffer=\"uplink\",policy=\"drop_newest\"");
+voip::VHistogram &answer_to_first_frame = metrics.histogram("voip_answer_to_first_frame_seconds", "Time from answering a call to the first caller frame reaching the AI pipeline");
+
+} // namespace
+
+voip::VPlayoutConfig voip::VPlayoutConfig::fromConfig(const VConfig &cfg)
+{
+    VPlayoutConfig c;
+    c.target_ms = cfg.getInt("ai.playout.target_ms", c.target_ms);
+    c.max_ms = cfg.getInt("ai.playout.max_ms", c.max_ms);
+    c.silence_level = cfg.getInt("ai.playout.silence_level", c.silence_level);
+    c.preroll_ms = cfg.getInt("ai.playout.preroll_ms", c.preroll_ms);
+    return c;
+}
+
+voip::VAiPlayer::VAiPlayer(unsigned clock_rate, unsigned samples_per_frame) :
+    clock_rate_(clock_rate),
+    samples_per_frame_(samples_per_frame)
+{
+}
+
+voip::VAiPlayer::~VAiPlayer()
+{
+    reset();
+}
+
+void voip::VAiPlayer::setPlayout(const VPlayoutConfig &cfg)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    playout_ = cfg;
+}
+
+void voip::VAiPlayer::setCodec(const VAiCodecConfig &cfg)
+{
+    std::lock_guard<std::mutex> lock(codec_mutex_);
+    decoder_.reset(cfg.opus ? new VAiDecoder(clock_rate_) : nullptr);
+}
+
+voip::VPlayoutStats voip::VAiPlayer::playoutStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    VPlayoutStats stats = stats_;
+    stats.delay_ms = samplesToMs(queued_samples_);
+    return stats;
+}
+
+unsigned voip::VAiPlayer::attach(int call_id)
+{
+    {
+        std::lock_guard<std::mutex> lock(codec_mutex_);
+        if (decoder_) {
+            decoder_->reset();
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    call_id_ = call_id;
+    first_response_ = false;
+    account_.attach(call_id);
+    return ++generation_;
+}
+
+void voip::VAiPlayer::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (call_id_ != PJSUA_INVALID_ID) {
+        VLOG_INFO << ">>> call " << call_id_ << " playout: delay " << samplesToMs(queued_samples_)
+                  << " ms, floor " << stats_.floor_ms << " ms, dropped " << stats_.drops
+                  << ", inserted " << stats_.inserts << ", discarded " << stats_.discards
+                  << ", " << stats_.turns << " turns, last ttfa " << stats_.ttfa_ms << " ms";
+    }
+    ++generation_;
+    queue_.clear();
+    current_.samples.clear();
+    pos_ = 0;
+    queued_samples_ = 0;
+    updateQueueGauge();
+    account_.reset();
+    call_id_ = PJSUA_INVALID_ID;
+
+    stats_ = VPlayoutStats();
+    window_min_ = SIZE_MAX;
+    window_frames_ = 0;
+    window_underrun_ = false;
+    underrun_seen_ = false;
+    since_insert_ = 0;
+    last_full_ = false;
+    prerolling_ = false;
+    in_turn_ = false;
+    lasts_queued_ = 0;
+}
+
+void voip::VAiPlayer::addAudio(unsigned generation, VAiChunk &&chunk)
+{
+    if (!chunk.frame_bytes.empty()) {
+        std::lock_guard<std::mutex> lock(codec_mutex_);
+        if (!decoder_) {
+            VLOG_WARN << ">>> Opus response without a decoder, dropped";
+            return;
+        }
+        decoder_->decode(chunk);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (generation != generation_.load(std::memory_order_relaxed)) {
+        stale_responses.inc();
+        return;
+    }
+    if (!chunk.samples.empty() && !account_.charge(chunk.samples.size() * sizeof(int16_t))) {
+        shed(chunk);
+    }
+    // 空闲时来了新一轮回复, 先预缓冲
+    if (chunk.first && queued_samples_ == 0 && !in_turn_) {
+        prerolling_ = true;
+    }
+    if (chunk.last) {
+        ++lasts_queued_;
+    }
+    queued_samples_ += chunk.samples.size();
+    queue_.push_back(std::move(chunk));
+    updateQueueGauge();
+}
+
+void voip::VAiPlayer::onFrameRequested(pj::MediaFrame &frame)
+{
+    VScopedLatency latency(frame_requested_latency);
+    frames_tx.inc();
+
+    size_t capacity = frame.size / sizeof(int16_t);
+    frame.buf.resize(capacity * sizeof(int16_t));
+    frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+    int16_t *out = reinterpret_cast<int16_t *>(frame.buf.data());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 上一帧是完整音频, 或当前分片未播完, 视为回复播放中
+    bool playing = last_full_ || pos_ < current_.samples.size();
+    if (prerolling_ && (queued_samples_ >= static_cast<size_t>(playout_.preroll_ms) * clock_rate_ / 1000 || lasts_queued_ > 0)) {
+        prerolling_ = false;
+    }
+    bool inserted = !prerolling_ && controlPlayout(capacity);
+    size_t filled = prerolling_ || inserted ? 0 : consume(out, capacity);
+
+    if (filled < capacity) {
+        std::fill(out + filled, out + capacity, 0);
+        if (playing && !inserted && !prerolling_) {
+            underruns.inc();
+            window_underrun_ = true;
+            if (in_turn_) {
+                prerolling_ = true;
+                rebuffers.inc();
+            }
+        }
+    }
+    last_full_ = filled == capacity;
+    updateQueueGauge();
+}
+
+size_t voip::VAiPlayer::queuedSamples()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queued_samples_;
+}
+
+voip::VAudioAccount &voip::VAiPlayer::account()
+{
+    return account_;
+}
+
+void voip::VAiPlayer::shed(VAiChunk &chunk)
+{
+    size_t bytes = chunk.samples.size() * sizeof(int16_t);
+    if (VAudioBudget::instance().policy() == VAudioBudget::DROP_OLDEST && queued_samples_ > 0) {
+        // 先丢本路最旧的待播音频; 总预算被其它呼叫占满时仍可能放不下
+        size_t n = std::min(queued_samples_, (account_.excess(bytes) + sizeof(int16_t) - 1) / sizeof(int16_t));
+        consume(nullptr, n);
+        shed_oldest.inc(n * sizeof(int16_t));
+        if (account_.charge(bytes)) {
+            return;
+        }
+    }
+    // 只丢音频, 保留首尾标记, 轮次状态不乱
+    shed_newest.inc(bytes);
+    chunk.samples.clear();
+    VLOG_DEBUG << ">>> call " << call_id_ << " over audio budget, dropped " << bytes << " bytes of response";
+}
+
+size_t voip::VAiPlayer::consume(int16_t *out, size_t n)
+{
+    size_t filled = 0;
+    while (filled < n) {
+        if (pos_ >= current_.samples.size()) {
+            if (queue_.empty()) {
+                break;
+            }
+            current_ = std::move(queue_.front());
+            queue_.pop_front();
+            pos_ = 0;
+            in_turn_ = !current_.last;
+            if (current_.last) {
+                --lasts_queued_;
+            }
+            if (current_.first) {
+                auto ttfa = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - current_.captured);
+                time_to_first_audio.observeUs(ttfa.count());
+                stats_.ttfa_ms = static_cast<unsigned>(ttfa.count() / 1000);
+                ++stats_.turns;
+                VLOG_DEBUG << ">>> call " << call_id_ << " turn " << stats_.turns << " ttfa " << stats_.ttfa_ms << " ms";
+            }
+            if (!first_response_) {
+                first_response_ = true;
+                VTRACE_END("first_ai_response", call_id_);
+            }
+        }
+        size_t k = std::min(n - filled, current_.samples.size() - pos_);
+        if (out) {
+            std::memcpy(out + filled, current_.samples.data() + pos_, k * sizeof(int16_t));
+        }
+        filled += k;
+        pos_ += k;
+    }
+    queued_samples_ -= filled;
+    account_.release(filled * sizeof(int16_t));
+    return filled;
+}
+
+bool voip::VAiPlayer::nextSilent(size_t n) const
+{
+    if (queued_samples_ < n) {
+        return false;
+    }
+    uint64_t sum = 0;
+    size_t seen = 0;
+    const VAiChunk *chunk = &current_;
+    size_t pos = pos_;
+    auto it = queue_.begin();
+    while (seen < n) {
+        if (pos >= chunk->samples.size()) {
+            chunk = &*it++;
+            pos = 0;
+            continue;
+        }
+        int16_t s = chunk->samples[pos++];
+        sum += s < 0 ? -static_cast<int32_t>(s) : s;
+        ++seen;
+    }
+    return sum < static_cast<uint64_t>(playout_.silence_level) * n;
+}
+
+bool voip::VAiPlayer::controlPlayout(size_t frame_samples)
+{
+    if (queued_samples_ == 0) {
+        // 一段回复播完, 窗口重新开始
+        window_min_ = SIZE_MAX;
+        window_frames_ = 0;
+        return false;
+    }
+
+    unsigned delay_ms = samplesToMs(queued_samples_);
+    playout_delay.observeUs(static_cast<uint64_t>(delay_ms) * 1000);
+
+    window_min_ = std::min(window_min_, queued_samples_);
+    // 约 1 s 一个窗口
+    if (++window_frames_ * frame_samples >= clock_rate_) {
+        stats_.floor_ms = samplesToMs(window_min_);
+        underrun_seen_ = window_underrun_;
+        window_min_ = SIZE_MAX;
+        window_frames_ = 0;
+        window_underrun_ = false;
+    }
+    ++since_insert_;
+
+    size_t keep = static_cast<size_t>(playout_.target_ms) * clock_rate_ / 1000;
+    if (playout_.max_ms > 0 && delay_ms > playout_.max_ms && keep < queued_samples_) {
+        consume(nullptr, queued_samples_ - keep);
+        ++stats_.discards;
+        playout_discards.inc();
+        stats_.floor_ms = playout_.target_ms;
+        return false;
+    }
+
+    // 持续积压: 删掉一个静音帧, 下限同步下调, 避免过度删除
+    if (stats_.floor_ms > playout_.target_ms && nextSilent(frame_samples)) {
+        consume(nullptr, frame_samples);
+        ++stats_.drops;
+        playout_drops.inc();
+        stats_.floor_ms -= std::min(stats_.floor_ms, samplesToMs(frame_samples));
+        return false;
+    }
+
+    // 上个窗口有欠载且余量不足: 在静音处插一帧, 最多每 5 帧一次
+    if (underrun_seen_ && delay_ms < playout_.target_ms && since_insert_ >= 5 && nextSilent(frame_samples)) {
+        ++stats_.inserts;
+        playout_inserts.inc();
+        since_insert_ = 0;
+        return true;
+    }
+    return false;
+}
+
+unsigned voip::VAiPlayer::samplesToMs(size_t samples) const
+{
+    return static_cast<unsigned>(samples * 1000 / clock_rate_);
+}
+
+void voip::VAiPlayer::updateQueueGauge()
+{
+    int64_t frames = static_cast<int64_t>(queued_samples_ / samples_per_frame_);
+    if (frames != queued_frames_) {
+        ai_queue_frames.inc(frames - queued_frames_);
+        queued_frames_ = frames;
+    }
+}
+
+voip::VChunkConfig voip::VChunkConfig::fromConfig(const VConfig &cfg)
+{
+    VChunkConfig c;
+    c.initial_ms = cfg.getInt("ai.chunk_ms", c.initial_ms);
+    c.min_ms = cfg.getInt("ai.chunk.min_ms", c.min_ms);
+    c.max_ms = cfg.getInt("ai.chunk.max_ms", c.max_ms);
+    c.step_ms = cfg.getInt("ai.chunk.step_ms", c.step_ms);
+    c.queue_ms = cfg.getInt("ai.chunk.queue_ms", c.queue_ms);
+    c.adaptive = cfg.getBool("ai.chunk.adaptive", c.adaptive);
+    c.min_ms = std::min(c.min_ms, c.initial_ms);
+    c.max_ms = std::max(c.max_ms, c.initial_ms);
+    return c;
+}
+
+voip::VAiProcessor::VAiProcessor(VAiClient &client, VAiPlayer &player, unsigned clock_rate) :
+    client_(client),
+    player_(player),
+    clock_rate_(clock_rate)
+{
+}
+
+voip::VAiProcessor::~VAiProcessor()
+{
+}
+
+void voip::VAiProcessor::setChunking(const VChunkConfig &cfg)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    chunking_ = cfg;
+}
+
+void voip::VAiProcessor::setCodec(const VAiCodecConfig &cfg)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    encoder_.reset(cfg.opus ? new VAiEncoder(clock_rate_, cfg) : nullptr);
+}
+
+void voip::VAiProcessor::attach(int call_id, unsigned generation, std::chrono::steady_clock::time_point setup_begin)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (encoder_) {
+        encoder_->reset();
+    }
+    call_id_ = call_id;
+    generation_ = generation;
+    chunk_samples_ = static_cast<size_t>(chunking_.initial_ms) * clock_rate_ / 1000;
+    buffer_.reserve(static_cast<size_t>(chunking_.max_ms) * clock_rate_ / 1000 * 2);
+    first_frame_ = false;
+    first_sent_ = false;
+    setup_begin_ = setup_begin;
+
+    stats_ = VChunkStats();
+    stats_.chunk_ms = chunking_.initial_ms;
+    rtt_ewma_ms_ = 0;
+    queue_ewma_ms_ = 0;
+}
+
+void voip::VAiProcessor::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (call_id_ != PJSUA_INVALID_ID && stats_.requests > 0) {
+        VLOG_INFO << ">>> call " << call_id_ << " uplink: chunk " << stats_.chunk_ms << " ms, rtt "
+                  << stats_.rtt_ms << " ms (max " << stats_.rtt_max_ms << "), backend queue "
+                  << stats_.queue_ms << " ms, " << stats_.requests << " requests, " << stats_.resizes << " resizes";
+    }
+    buffer_.clear();
+    call_id_ = PJSUA_INVALID_ID;
+}
+
+voip::VChunkStats voip::VAiProcessor::chunkStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void voip::VAiProcessor::onTiming(unsigned generation, const VAiTiming &timing)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (generation != generation_ || call_id_ == PJSUA_INVALID_ID) {
+        return;
+    }
+
+    double rtt_ms = timing.rtt.count() / 1000.0;
+    double queue_ms = std::max<double>(0, timing.queued.count() / 1000.0);
+    bool first = stats_.requests++ == 0;
+    rtt_ewma_ms_ = first ? rtt_ms : rtt_ewma_ms_ * 0.8 + rtt_ms * 0.2;
+    queue_ewma_ms_ = first ? queue_ms : queue_ewma_ms_ * 0.8 + queue_ms * 0.2;
+    stats_.rtt_ms = static_cast<unsigned>(rtt_ewma_ms_);
+    stats_.rtt_max_ms = std::max(stats_.rtt_max_ms, static_cast<unsigned>(rtt_ms));
+    stats_.queue_ms = static_cast<unsigned>(queue_ewma_ms_);
+
+    if (!chunking_.adaptive) {
+        return;
+    }
+    // 排队: 乘性加大, 分散请求; 无排队: 按步长缩小
+    unsigned chunk_ms = stats_.chunk_ms;
+    if (queue_ewma_ms_ > chunking_.queue_ms) {
+        chunk_ms = std::min(chunking_.max_ms, chunk_ms + std::max(chunking_.step_ms, chunk_ms / 4));
+    }
+    else if (queue_ewma_ms_ < chunking_.queue_ms / 4.0) {
+        chunk_ms = std::max(chunking_.min_ms, chunk_ms - std::min(chunk_ms, chunking_.step_ms));
+    }
+    if (chunk_ms != stats_.chunk_ms) {
+        stats_.chunk_ms = chunk_ms;
+        ++stats_.resizes;
+        chunk_resizes.inc();
+        chunk_samples_ = static_cast<size_t>(chunk_ms) * clock_rate_ / 1000;
+        VLOG_DEBUG << ">>> call " << call_id_ << " chunk " << chunk_ms << " ms (rtt " << stats_.rtt_ms
+                   << " ms, queue " << stats_.queue_ms << " ms)";
+    }
+}
+
+void voip::VAiProcessor::onDelivered(unsigned generation, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 呼叫已结束时整路记账已在 VAiPlayer::reset() 归还
+    if (generation == generation_ && call_id_ != PJSUA_INVALID_ID) {
+        player_.account().release(bytes);
+    }
+}
+
+void voip::VAiProcessor::onFrameReceived(pj::MediaFrame &frame)
+{
+    VScopedLatency latency(frame_received_latency);
+    if (frame.type != PJMEDIA_FRAME_TYPE_AUDIO || frame.size == 0) {
+        return;
+    }
+    frames_rx.inc();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (call_id_ == PJSUA_INVALID_ID) {
+        return;
+    }
+    if (!first_frame_) {
+        first_frame_ = true;
+        answer_to_first_frame.observeUs(std::chrono::duration_cast<std::chrono::microseconds>(
+                                            std::chrono::steady_clock::now() - setup_begin_)
+                                            .count());
+        VTRACE_END("media_to_first_frame", call_id_);
+        VTRACE_INSTANT("first_frame", call_id_);
+    }
+
+    const int16_t *in = reinterpret_cast<const int16_t *>(frame.buf.data());
+    buffer_.insert(buffer_.end(), in, in + frame.size / sizeof(int16_t));
+
+    while (buffer_.size() >= chunk_samples_) {
+        VAiChunk chunk;
+        chunk.samples.assign(buffer_.begin(), buffer_.begin() + chunk_samples_);
+        buffer_.erase(buffer_.begin(), buffer_.begin() + chunk_samples_);
+        chunk.captured = std::chrono::steady_clock::now();
+        chunk.clock_rate = clock_rate_;
+        chunk.stream = static_cast<uint32_t>(call_id_);
+        chunk_size_hist.observeUs(static_cast<uint64_t>(chunk_samples_) * 1000000 / clock_rate_);
+        if (encoder_) {
+            encoder_->encode(chunk);
+        }
+        size_t bytes = chunk.frame_bytes.empty() ? chunk.samples.size() * sizeof(int16_t) : chunk.payload.size();
+        if (!player_.account().charge(bytes)) {
+            shed_uplink.inc(bytes);
+            continue;
+        }
+
+        if (!first_sent_) {
+            first_sent_ = true;
+            VTRACE_BEGIN("first_ai_response", call_id_);
+        }
+        VAiPlayer *player = &player_;
+        unsigned generation = generation_;
+        bool queued = client_.send(std::move(chunk), [this, player, generation, bytes](VAiChunk &&response, const VAiTiming &timing) {
+            if (response.last) {
+                onDelivered(generation, bytes);
+            }
+            // 请求作废时只回调一个空的 last 包
+            if (response.samples.empty() && response.frame_bytes.empty()) {
+                return;
+            }
+            if (response.first) {
+                onTiming(generation, timing);
+            }
+            player->addAudio(generation, std::move(response));
+        });
+        // 后端不可用时分片被丢弃, 不会有回调来归还记账
+        if (!queued) {
+            player_.account().release(bytes);
+        }
+    }
+}
@@ -0,0 +1,236 @@
+#ifndef _VAIPORT_H_
+#define _VAIPORT_H_
+
+#include "vaiclient.h"
+#include "vaicodec.h"
+#include "vaudiobudget.h"
+
+#include <pjsua2.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace voip {
+
+class VConfig;
+
+// 播放缓冲控制参数 (ai.playout.*)
+struct VPlayoutConfig
+{
+    unsigned target_ms = 60;      // 持续排队时延的目标
+    unsigned max_ms = 2000;       // 超过后丢弃最旧的音频, 0 关闭
+    unsigned silence_level = 300; // 帧平均幅度低于该值视为静音, 可删可插
+    unsigned preroll_ms = 100;    // 流式回复攒够该时长 (或收到最后一个包) 才开始播放
+
+    static VPlayoutConfig
+    fromConfig(const VConfig &cfg);
+};
+
+// 一路呼叫的播放缓冲统计
+struct VPlayoutStats
+{
+    unsigned delay_ms = 0; // 当前排队时延
+    unsigned floor_ms = 0; // 上一个窗口内的最小排队时延
+    uint64_t drops = 0;    // 删掉的静音帧
+    uint64_t inserts = 0;  // 插入的静音帧
+    uint64_t discards = 0; // 超过 max_ms 时的整段丢弃
+    uint64_t turns = 0;    // 已开始播放的回复轮数
+    unsigned ttfa_ms = 0;  // 最近一轮的首音时延
+};
+
+// 上行分片参数 (ai.chunk_ms, ai.chunk.*)
+struct VChunkConfig
+{
+    unsigned initial_ms = 500;
+    unsigned min_ms = 100;
+    unsigned max_ms = 1000;
+    unsigned step_ms = 20;
+    unsigned queue_ms = 20; // 后端排队超过该值时加大分片
+    bool adaptive = true;
+
+    static VChunkConfig
+    fromConfig(const VConfig &cfg);
+};
+
+// 一路呼叫的上行分片统计
+struct VChunkStats
+{
+    unsigned chunk_ms = 0;   // 当前分片长度
+    unsigned rtt_ms = 0;     // RTT 平滑值
+    unsigned rtt_max_ms = 0;
+    unsigned queue_ms = 0;   // 后端排队平滑值
+    uint64_t requests = 0;
+    uint64_t resizes = 0;
+};
+
+// 播放 AI 回复, 接到呼叫媒体的输入端
+// 端口预先创建并由 VAiPortPool 复用, attach() 换代后旧呼叫迟到的回复会被丢弃
+// Opus 编码的回复在 AI 工作线程上解码后入队, 不占媒体时钟线程
+// 流式回复边收边播: 一轮回复先攒 preroll_ms 再开播, 轮中途欠载时重新攒
+// AI 产出速率与媒体时钟的偏差由播放控制吸收: 窗口内最小排队时延高于目标时删静音帧,
+// 播放中途欠载时在静音处插帧, 超过上限直接丢弃
+// 待播音频记入本路的内存预算 (account()), 超出时按 audio.budget.policy 丢最旧或最新的音频
+class VAiPlayer : public pj::AudioMediaPort
+{
+public:
+    VAiPlayer(unsigned clock_rate, unsigned samples_per_frame);
+    ~VAiPlayer();
+
+    void
+    setPlayout(const VPlayoutConfig &cfg);
+
+    // ai.codec = opus 时创建解码器, 随端口复用
+    void
+    setCodec(const VAiCodecConfig &cfg);
+
+    VPlayoutStats
+    playoutStats();
+
+    // 绑定到呼叫, 返回本次的代号
+    unsigned
+    attach(int call_id);
+
+    // 清空队列, 归还到池前调用
+    void
+    reset();
+
+    // AI 工作线程调用
+    void
+    addAudio(unsigned generation, VAiChunk &&chunk);
+
+    // 待播放的样本数
+    size_t
+    queuedSamples();
+
+    // 本路呼叫的缓冲记账, 配对的 VAiProcessor 也记入这里
+    VAudioAccount &
+    account();
+
+    virtual void
+    onFrameRequested(pj::MediaFrame &frame) override;
+
+private:
+    // 从队列取出 n 个样本写入 out (为空时只丢弃), 返回实际取出数
+    size_t
+    consume(int16_t *out, size_t n);
+
+    // 超出内存预算时按策略处理新到的 chunk, 放不下时清空其音频
+    void
+    shed(VAiChunk &chunk);
+
+    // 接下来 n 个样本是否为静音, 不足 n 个时返回 false
+    bool
+    nextSilent(size_t n) const;
+
+    // 每帧调用一次, 返回 true 表示本帧输出插入的静音
+    bool
+    controlPlayout(size_t frame_samples);
+
+    unsigned
+    samplesToMs(size_t samples) const;
+
+    // 队列长度变化时更新 voip_ai_queue_frames
+    void
+    updateQueueGauge();
+
+    const unsigned clock_rate_;
+    const unsigned samples_per_frame_;
+    VPlayoutConfig playout_;
+
+    std::mutex mutex_;
+    std::deque<VAiChunk> queue_;
+    VAiChunk current_;
+    size_t pos_ = 0;
+    size_t queued_samples_ = 0;
+    int64_t queued_frames_ = 0;
+    VAudioAccount account_;
+
+    std::atomic<unsigned> generation_ {0};
+    int call_id_ = PJSUA_INVALID_ID;
+    bool first_response_ = false;
+
+    // 解码只在 AI 工作线程上进行, 与 mutex_ 分开, 解码时不阻塞取帧
+    std::mutex codec_mutex_;
+    std::unique_ptr<VAiDecoder> decoder_;
+
+    // 播放控制状态
+    VPlayoutStats stats_;
+    size_t window_min_ = SIZE_MAX;
+    unsigned window_frames_ = 0;
+    bool window_underrun_ = false;
+    bool underrun_seen_ = false;
+    unsigned since_insert_ = 0;
+    bool last_full_ = false;
+
+    // 预缓冲状态
+    bool prerolling_ = false;
+    bool in_turn_ = false;      // 当前分片之后还有同一轮的包
+    unsigned lasts_queued_ = 0; // 队列中各轮最后一个包的数量
+};
+
+// 截取呼叫方音频, 分片发给 AI, 回复交给配对的 VAiPlayer
+// ai.codec = opus 时分片在媒体线程上编码后发出, 编码器按呼叫复用
+// 已发出未回复完的分片记入本路内存预算, 超出时新分片直接丢弃
+// 分片长度按回复测得的 RTT 和后端排队调整: 后端排队说明请求过密, 加大分片;
+// 没有排队时逐步缩小, 减少等待凑满分片的时延
+class VAiProcessor : public pj::AudioMediaPort
+{
+public:
+    VAiProcessor(VAiClient &client, VAiPlayer &player, unsigned clock_rate);
+    ~VAiProcessor();
+
+    void
+    setChunking(const VChunkConfig &cfg);
+
+    void
+    setCodec(const VAiCodecConfig &cfg);
+
+    // setup_begin 为应答时刻, 用于统计应答到首帧时延
+    void
+    attach(int call_id, unsigned generation, std::chrono::steady_clock::time_point setup_begin);
+
+    void
+    reset();
+
+    VChunkStats
+    chunkStats();
+
+    virtual void
+    onFrameReceived(pj::MediaFrame &frame) override;
+
+private:
+    // AI 工作线程上回调
+    void
+    onTiming(unsigned generation, const VAiTiming &timing);
+
+    // 一个上行分片的回复收完 (或请求作废), 归还其记账
+    void
+    onDelivered(unsigned generation, size_t bytes);
+
+    VAiClient &client_;
+    VAiPlayer &player_;
+    const unsigned clock_rate_;
+    VChunkConfig chunking_;
+    VChunkStats stats_;
+    double rtt_ewma_ms_ = 0;
+    double queue_ewma_ms_ = 0;
+
+    std::mutex mutex_;
+    std::vector<int16_t> buffer_;
+    size_t chunk_samples_ = 0;
+    std::unique_ptr<VAiEncoder> encoder_;
+
+    int call_id_ = PJSUA_INVALID_ID;
+    unsigned generation_ = 0;
+    bool first_frame_ = false;
+    bool first_sent_ = false;
+    std::chrono::steady_clock::time_point setup_begin_;
+};
+
+} // namespace voip
+
+#endif // _VAIPORT_H_
@@ -0,0 +1,318 @@
+#include "vaistandin.h"
+#include "vaiwire.h"
+#include "vconfig.h"
+#include "vlog.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+struct Pending
+{
+    std::chrono::steady_clock::time_point due;
+    voip::VAiWireHeader header; // 请求头, value 为采样率
+    voip::VAiChunk chunk;
+    size_t offset;      // 已回复的样本数
+    size_t byte_offset; // Opus 时已回复的字节数
+};
+
+struct Later
+{
+    bool
+    operator()(const Pending &a, const Pending &b) const
+    {
+        return a.due > b.due;
+    }
+};
+
+size_t
+frameSamples(const voip::VAiChunk &chunk)
+{
+    return chunk.clock_rate / 50;
+}
+
+size_t
+duration(const voip::VAiChunk &chunk)
+{
+    return chunk.frame_bytes.empty() ? chunk.samples.size() : chunk.frame_bytes.size() * frameSamples(chunk);
+}
+
+// 与进程内回声后端相同: Opus 按整帧切包
+size_t
+packetSamples(const voip::VAiChunk &chunk, unsigned packet_ms)
+{
+    size_t n = std::max<size_t>(1, static_cast<size_t>(packet_ms) * chunk.clock_rate / 1000);
+    if (chunk.frame_bytes.empty()) {
+        return n;
+    }
+    return std::max<size_t>(1, n / frameSamples(chunk)) * frameSamples(chunk);
+}
+
+void
+slice(Pending &p, size_t n, voip::VAiChunk &packet)
+{
+    const voip::VAiChunk &chunk = p.chunk;
+    if (chunk.frame_bytes.empty()) {
+        packet.samples.assign(chunk.samples.begin() + p.offset, chunk.samples.begin() + p.offset + n);
+    }
+    else {
+        auto frame = chunk.frame_bytes.begin() + p.offset / frameSamples(chunk);
+        packet.frame_bytes.assign(frame, frame + n / frameSamples(chunk));
+        size_t bytes = 0;
+        for (uint16_t b : packet.frame_bytes) {
+            bytes += b;
+        }
+        packet.payload.assign(chunk.payload.begin() + p.byte_offset, chunk.payload.begin() + p.byte_offset + bytes);
+        p.byte_offset += bytes;
+    }
+    p.offset += n;
+}
+
+bool
+sendAll(int fd, const std::vector<uint8_t> &data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+voip::VAiStandin::VAiStandin()
+{
+}
+
+voip::VAiStandin::~VAiStandin()
+{
+    stop();
+}
+
+uint16_t voip::VAiStandin::start(const std::string &host, uint16_t port, const VConfig &cfg)
+{
+    if (running_) {
+        return 0;
+    }
+    delay_ = std::chrono::milliseconds(cfg.getInt("ai.echo_delay_ms", 500));
+    overhead_ = std::chrono::milliseconds(cfg.getInt("ai.echo_overhead_ms", 0));
+    speed_ = cfg.getDouble("ai.echo_speed", 0);
+    stream_ = cfg.getBool("ai.stream", true);
+    packet_ms_ = std::max(1, static_cast<int>(cfg.getInt("ai.echo_packet_ms", 60)));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+        VLOG_ERROR << ">>> AI stand-in: bad address " << host;
+        return 0;
+    }
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    socklen_t len = sizeof(addr);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+        || ::listen(listen_fd_, 128) != 0
+        || getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+        VLOG_ERROR << ">>> AI stand-in: cannot listen on " << host << ":" << port << ": " << std::strerror(errno);
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return 0;
+    }
+
+    running_ = true;
+    listener_ = std::thread(&VAiStandin::listen, this);
+    uint16_t bound = ntohs(addr.sin_port);
+    VLOG_INFO << ">>> AI stand-in listening on " << host << ":" << bound << " (delay " << delay_.count() << " ms, "
+              << (stream_ ? "streaming" : "whole") << " responses)";
+    return bound;
+}
+
+void voip::VAiStandin::stop()
+{
+    if (!running_.exchange(false)) {
+        return;
+    }
+    // shutdown 让阻塞的 accept 返回
+    shutdown(listen_fd_, SHUT_RDWR);
+    listener_.join();
+    close(listen_fd_);
+    listen_fd_ = -1;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &session : sessions_) {
+        shutdown(session->fd, SHUT_RDWR);
+        session->thread.join();
+        close(session->fd);
+    }
+    sessions_.clear();
+}
+
+uint64_t voip::VAiStandin::accepted() const
+{
+    return accepted_.load();
+}
+
+void voip::VAiStandin::listen()
+{
+    while (running_) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        ++accepted_;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 回收已结束的连接
+        for (auto it = sessions_.begin(); it != sessions_.end();) {
+            if ((*it)->done) {
+                (*it)->thread.join();
+                close((*it)->fd);
+                it = sessions_.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        std::unique_ptr<Session> session(new Session);
+        session->fd = fd;
+        Session *s = session.get();
+        session->thread = std::thread([this, s]() { serve(*s); });
+        sessions_.push_back(std::move(session));
+    }
+}
+
+void voip::VAiStandin::serve(Session &session)
+{
+    std::vector<Pending> queue;
+    std::vector<uint8_t> rx;
+    std::vector<uint8_t> out;
+    bool open = true;
+
+    while (running_ && open) {
+        auto now = std::chrono::steady_clock::now();
+        int timeout = 200;
+        if (!queue.empty()) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(queue.front().due - now).count();
+            timeout = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(wait, timeout)));
+        }
+        pollfd pfd {session.fd, POLLIN, 0};
+        if (poll(&pfd, 1, timeout) < 0 && errno != EINTR) {
+            break;
+        }
+
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            size_t used = rx.size();
+            rx.resize(used + 64 * 1024);
+            ssize_t n = recv(session.fd, rx.data() + used, 64 * 1024, 0);
+            rx.resize(used + static_cast<size_t>(std::max<ssize_t>(0, n)));
+            open = n > 0;
+
+            size_t offset = 0;
+            VAiWireHeader header;
+            while (aiWireHeader(rx.data() + offset, rx.size() - offset, header)) {
+                if (header.length > VAiWireHeader::MAX_LENGTH || header.type != VAiWireHeader::REQUEST) {
+                    open = false;
+                    break;
+                }
+                if (rx.size() - offset < VAiWireHeader::SIZE + header.length) {
+                    break;
+                }
+                Pending p {};
+                p.header = header;
+                p.chunk.clock_rate = header.value ? header.value : 8000;
+                if (!aiWireChunk(header, rx.data() + offset + VAiWireHeader::SIZE, p.chunk)) {
+                    open = false;
+                    break;
+                }
+                offset += VAiWireHeader::SIZE + header.length;
+
+                // 已接收, 归还额度
+                VAiWireHeader window;
+                window.stream = header.stream;
+                window.request = header.request;
+                window.type = VAiWireHeader::WINDOW;
+                window.value = header.length;
+                aiWireEncode(window, out);
+
+                size_t total = duration(p.chunk);
+                size_t first = stream_ ? std::min(packetSamples(p.chunk, packet_ms_), total) : total;
+                p.due = std::chrono::steady_clock::now() + delay_ + generation(first, p.chunk.clock_rate);
+                queue.push_back(std::move(p));
+                std::push_heap(queue.begin(), queue.end(), Later());
+            }
+            rx.erase(rx.begin(), rx.begin() + offset);
+        }
+
+        while (!queue.empty() && queue.front().due <= std::chrono::steady_clock::now()) {
+            std::pop_heap(queue.begin(), queue.end(), Later());
+            Pending p = std::move(queue.back());
+            queue.pop_back();
+
+            VAiWireHeader header;
+            header.stream = p.header.stream;
+            header.request = p.header.request;
+            header.type = VAiWireHeader::RESPONSE;
+            if (p.offset == 0) {
+                auto start = std::chrono::steady_clock::now();
+                if (overhead_.count() > 0) {
+                    std::this_thread::sleep_for(overhead_);
+                }
+                header.value = static_cast<uint32_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(start - p.due).count());
+                header.flags |= VAiWireHeader::FIRST;
+            }
+
+            size_t total = duration(p.chunk);
+            size_t step = packetSamples(p.chunk, packet_ms_);
+            size_t n = stream_ ? std::min(step, total - p.offset) : total;
+            VAiChunk packet;
+            slice(p, n, packet);
+            if (p.offset >= total) {
+                header.flags |= VAiWireHeader::LAST;
+            }
+            aiWireEncode(header, packet, out);
+
+            if (p.offset < total) {
+                p.due += generation(std::min(step, total - p.offset), p.chunk.clock_rate);
+                queue.push_back(std::move(p));
+                std::push_heap(queue.begin(), queue.end(), Later());
+            }
+        }
+
+        if (!out.empty()) {
+            open = sendAll(session.fd, out) && open;
+            out.clear();
+        }
+    }
+    session.done = true;
+}
+
+std::chrono::microseconds voip::VAiStandin::generation(size_t samples, unsigned clock_rate) const
+{
+    if (speed_ <= 0) {
+        return std::chrono::microseconds(0);
+    }
+    return std::chrono::microseconds(static_cast<int64_t>(samples * 1000000.0 / clock_rate / speed_));
+}
@@ -0,0 +1,73 @@
+#ifndef _VAISTANDIN_H_
+#define _VAISTANDIN_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace voip {
+
+class VConfig;
+
+// 本地的 AI 后端替身, 讲 vaiwire.h 的协议, 供 ai.backend = mux 联调与压测
+// 行为与进程内回声后端相同: ai.echo_delay_ms 后开始回复, 按 ai.echo_speed 倍实时生成,
+// ai.stream 打开时每 ai.echo_packet_ms 一个包; ai.echo_overhead_ms 在每条连接上串行占用
+// 每个请求读入后立即归还窗口额度 (WINDOW), 即后端已接收
+// 每条连接一个线程
+class VAiStandin
+{
+public:
+    VAiStandin();
+    ~VAiStandin();
+
+    // port 为 0 时由系统分配, 返回实际监听的端口, 失败返回 0
+    uint16_t
+    start(const std::string &host, uint16_t port, const VConfig &cfg);
+
+    void
+    stop();
+
+    // 累计接受的连接数
+    uint64_t
+    accepted() const;
+
+private:
+    struct Session
+    {
+        int fd = -1;
+        std::atomic<bool> done {false};
+        std::thread thread;
+    };
+
+    void
+    listen();
+
+    void
+    serve(Session &session);
+
+    std::chrono::microseconds
+    generation(size_t samples, unsigned clock_rate) const;
+
+    std::chrono::milliseconds delay_ {500};
+    std::chrono::milliseconds overhead_ {0};
+    double speed_ = 0;
+    bool stream_ = true;
+    unsigned packet_ms_ = 60;
+
+    int listen_fd_ = -1;
+    std::thread listener_;
+    std::atomic<bool> running_ {false};
+    std::atomic<uint64_t> accepted_ {0};
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Session>> sessions_;
+};
+
+} // namespace voip
+
+#endif // _VAISTANDIN_H_
@@ -0,0 +1,126 @@
+#include "vaiwire.h"
+
+#include <arpa/inet.h>
+#include <cstring>
+
+namespace {
+
+void
+put16(std::vector<uint8_t> &out, uint16_t v)
+{
+    v = htons(v);
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&v);
+    out.insert(out.end(), p, p + 2);
+}
+
+void
+put32(std::vector<uint8_t> &out, uint32_t v)
+{
+    v = htonl(v);
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&v);
+    out.insert(out.end(), p, p + 4);
+}
+
+uint16_t
+get16(const uint8_t *p)
+{
+    uint16_t v;
+    std::memcpy(&v, p, 2);
+    return ntohs(v);
+}
+
+uint32_t
+get32(const uint8_t *p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+} // namespace
+
+void voip::aiWireEncode(const VAiWireHeader &header, const VAiChunk &chunk, std::vector<uint8_t> &out)
+{
+    bool opus = !chunk.frame_bytes.empty();
+    uint32_t length = opus ? static_cast<uint32_t>(2 + chunk.frame_bytes.size() * 2 + chunk.payload.size())
+                           : static_cast<uint32_t>(chunk.samples.size() * sizeof(int16_t));
+    out.reserve(out.size() + VAiWireHeader::SIZE + length);
+    put32(out, length);
+    put32(out, header.stream);
+    put32(out, header.request);
+    put16(out, header.type);
+    put16(out, static_cast<uint16_t>(header.flags | (opus ? VAiWireHeader::OPUS : 0)));
+    put32(out, header.value);
+
+    if (opus) {
+        put16(out, static_cast<uint16_t>(chunk.frame_bytes.size()));
+        for (uint16_t bytes : chunk.frame_bytes) {
+            put16(out, bytes);
+        }
+        out.insert(out.end(), chunk.payload.begin(), chunk.payload.end());
+    }
+    else {
+        // 本机字节序的样本原样写出, 两端同为小端
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(chunk.samples.data());
+        out.insert(out.end(), p, p + length);
+    }
+}
+
+void voip::aiWireEncode(const VAiWireHeader &header, std::vector<uint8_t> &out)
+{
+    put32(out, 0);
+    put32(out, header.stream);
+    put32(out, header.request);
+    put16(out, header.type);
+    put16(out, header.flags);
+    put32(out, header.value);
+}
+
+bool voip::aiWireHeader(const uint8_t *data, size_t size, VAiWireHeader &header)
+{
+    if (size < VAiWireHeader::SIZE) {
+        return false;
+    }
+    header.length = get32(data);
+    header.stream = get32(data + 4);
+    header.request = get32(data + 8);
+    header.type = get16(data + 12);
+    header.flags = get16(data + 14);
+    header.value = get32(data + 16);
+    return true;
+}
+
+bool voip::aiWireChunk(const VAiWireHeader &header, const uint8_t *payload, VAiChunk &chunk)
+{
+    if (!(header.flags & VAiWireHeader::OPUS)) {
+        if (header.length % sizeof(int16_t) != 0) {
+            return false;
+        }
+        chunk.samples.resize(header.length / sizeof(int16_t));
+        // 长度为 0 时 payload 可以是空指针, 不能交给 memcpy
+        if (header.length > 0) {
+            std::memcpy(chunk.samples.data(), payload, header.length);
+        }
+        return true;
+    }
+
+    if (header.length < 2) {
+        return false;
+    }
+    size_t frames = get16(payload);
+    size_t table = 2 + frames * 2;
+    if (header.length < table) {
+        return false;
+    }
+    chunk.frame_bytes.resize(frames);
+    size_t bytes = 0;
+    for (size_t i = 0; i < frames; ++i) {
+        chunk.frame_bytes[i] = get16(payload + 2 + i * 2);
+        bytes += chunk.frame_bytes[i];
+    }
+    if (table + bytes != header.length) {
+        return false;
+    }
+    chunk.payload.assign(payload + table, payload + header.length);
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef _VAIWIRE_H_
+#define _VAIWIRE_H_
+
+#include "vaiclient.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace voip {
+
+// AI 多路复用连接的帧格式, 头部和 OPUS 帧表为网络字节序
+// 一条 TCP 连接上承载多路呼叫, 每路一个 stream, 每个分片一个 request
+//
+//   u32 length   负载字节数
+//   u32 stream   呼叫的流 id
+//   u32 request  请求 id, 响应沿用
+//   u16 type     REQUEST / RESPONSE / WINDOW
+//   u16 flags    FIRST / LAST / OPUS
+//   u32 value    REQUEST: 采样率; RESPONSE 首包: 后端排队 (us); WINDOW: 归还的额度 (字节)
+//
+// 负载: PCM 为 16 bit 小端样本 (本机字节序原样收发, 两端须同为小端主机);
+//       OPUS 为 u16 帧数 + 每帧 u16 字节数 + 各帧数据
+struct VAiWireHeader
+{
+    enum Type : uint16_t {
+        REQUEST = 1,
+        RESPONSE = 2,
+        WINDOW = 3
+    };
+
+    enum Flags : uint16_t {
+        FIRST = 1,
+        LAST = 2,
+        OPUS = 4
+    };
+
+    static const size_t SIZE = 20;
+    // 单帧负载上限, 超过视为协议错误
+    static const uint32_t MAX_LENGTH = 1 << 20;
+
+    uint32_t length = 0;
+    uint32_t stream = 0;
+    uint32_t request = 0;
+    uint16_t type = 0;
+    uint16_t flags = 0;
+    uint32_t value = 0;
+};
+
+// 写入头部和分片负载, 追加到 out
+void
+aiWireEncode(const VAiWireHeader &header, const VAiChunk &chunk, std::vector<uint8_t> &out);
+
+// 只有头部的帧 (WINDOW)
+void
+aiWireEncode(const VAiWireHeader &header, std::vector<uint8_t> &out);
+
+// 从 data 解析一个头部, 数据不足时返回 false
+bool
+aiWireHeader(const uint8_t *data, size_t size, VAiWireHeader &header);
+
+// 按 flags 解析负载到 chunk (samples 或 payload / frame_bytes), 格式错误返回 false
+bool
+aiWireChunk(const VAiWireHeader &header, const uint8_t *payload, VAiChunk &chunk);
+
+} // namespace voip
+
+#endif // _VAIWIRE_H_
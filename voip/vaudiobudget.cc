@@ -0,0 +1,179 @@
+#include "vaudiobudget.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VGauge &used_bytes = metrics.gauge("voip_audio_buffer_bytes", "Audio buffered for all calls: queued responses and uplink chunks awaiting a response");
+voip::VGauge &total_limit_bytes = metrics.gauge("voip_audio_buffer_limit_bytes", "Audio buffer memory budget, 0 when unlimited", "scope=\"total\"");
+voip::VGauge &call_limit_bytes = metrics.gauge("voip_audio_buffer_limit_bytes", "Audio buffer memory budget, 0 when unlimited", "scope=\"call\"");
+
+const char *
+policyName(voip::VAudioBudget::Policy policy)
+{
+    switch (policy) {
+    case voip::VAudioBudget::DROP_OLDEST:
+        return "drop_oldest";
+    case voip::VAudioBudget::DROP_NEWEST:
+        return "drop_newest";
+    case voip::VAudioBudget::REJECT:
+        return "reject";
+    }
+    return "";
+}
+
+} // namespace
+
+voip::VAudioBudget &voip::VAudioBudget::instance()
+{
+    static VAudioBudget budget;
+    return budget;
+}
+
+void voip::VAudioBudget::configure(const VConfig &cfg)
+{
+    total_limit_ = static_cast<size_t>(std::max<long>(0, cfg.getInt("audio.budget.total_kb", 0))) * 1024;
+    call_limit_ = static_cast<size_t>(std::max<long>(0, cfg.getInt("audio.budget.call_kb", 0))) * 1024;
+    reject_pct_ = cfg.getInt("audio.budget.reject_pct", 80);
+    std::string policy = cfg.getString("audio.budget.policy", "drop_oldest");
+    if (policy == "drop_newest") {
+        policy_ = DROP_NEWEST;
+    }
+    else if (policy == "reject") {
+        policy_ = REJECT;
+    }
+    else {
+        if (policy != "drop_oldest") {
+            VLOG_WARN << ">>> unknown audio.budget.policy " << policy << ", using drop_oldest";
+        }
+        policy_ = DROP_OLDEST;
+    }
+    total_limit_bytes.set(static_cast<int64_t>(total_limit_));
+    call_limit_bytes.set(static_cast<int64_t>(call_limit_));
+    VLOG_INFO << ">>> audio budget: total " << total_limit_ / 1024 << " KiB, per call " << call_limit_ / 1024
+              << " KiB, " << policyName(policy_);
+}
+
+voip::VAudioBudget::Policy voip::VAudioBudget::policy() const
+{
+    return policy_;
+}
+
+bool voip::VAudioBudget::rejecting() const
+{
+    return policy_ == REJECT && total_limit_ > 0
+           && used_.load(std::memory_order_relaxed) * 100 >= total_limit_ * reject_pct_;
+}
+
+size_t voip::VAudioBudget::used() const
+{
+    return used_.load(std::memory_order_relaxed);
+}
+
+bool voip::VAudioBudget::reserve(size_t held, size_t bytes)
+{
+    if (call_limit_ > 0 && held + bytes > call_limit_) {
+        return false;
+    }
+    size_t used = used_.load(std::memory_order_relaxed);
+    do {
+        if (total_limit_ > 0 && used + bytes > total_limit_) {
+            return false;
+        }
+    } while (!used_.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed));
+    used_bytes.inc(static_cast<int64_t>(bytes));
+    return true;
+}
+
+void voip::VAudioBudget::release(size_t bytes)
+{
+    used_.fetch_sub(bytes, std::memory_order_relaxed);
+    used_bytes.dec(static_cast<int64_t>(bytes));
+}
+
+size_t voip::VAudioBudget::excess(size_t held, size_t bytes) const
+{
+    size_t need = 0;
+    if (call_limit_ > 0 && held + bytes > call_limit_) {
+        need = held + bytes - call_limit_;
+    }
+    size_t used = used_.load(std::memory_order_relaxed);
+    if (total_limit_ > 0 && used + bytes > total_limit_) {
+        need = std::max(need, used + bytes - total_limit_);
+    }
+    return need;
+}
+
+voip::VAudioAccount::VAudioAccount()
+{
+}
+
+voip::VAudioAccount::~VAudioAccount()
+{
+    reset();
+}
+
+void voip::VAudioAccount::attach(int call_id)
+{
+    call_id_ = call_id;
+    peak_ = 0;
+    // pjsua 呼叫 id 有上限且会复用, 按 id 建的指标数量有界
+    gauge_ = &metrics.gauge("voip_call_audio_buffer_bytes", "Audio buffered for one call", "call=\"" + std::to_string(call_id) + "\"");
+}
+
+void voip::VAudioAccount::reset()
+{
+    size_t bytes = bytes_.exchange(0);
+    VGauge *gauge = gauge_.exchange(nullptr);
+    if (bytes > 0) {
+        VAudioBudget::instance().release(bytes);
+    }
+    if (gauge) {
+        gauge->dec(static_cast<int64_t>(bytes));
+    }
+    if (call_id_ >= 0 && peak_ > 0) {
+        VLOG_INFO << ">>> call " << call_id_ << " audio buffers peaked at " << peak_ / 1024 << " KiB";
+    }
+    call_id_ = -1;
+}
+
+bool voip::VAudioAccount::charge(size_t bytes)
+{
+    size_t held = bytes_.load(std::memory_order_relaxed);
+    if (!VAudioBudget::instance().reserve(held, bytes)) {
+        return false;
+    }
+    held = bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = peak_.load(std::memory_order_relaxed);
+    while (held > peak && !peak_.compare_exchange_weak(peak, held, std::memory_order_relaxed)) {
+    }
+    if (VGauge *gauge = gauge_.load(std::memory_order_relaxed)) {
+        gauge->inc(static_cast<int64_t>(bytes));
+    }
+    return true;
+}
+
+void voip::VAudioAccount::release(size_t bytes)
+{
+    bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    VAudioBudget::instance().release(bytes);
+    if (VGauge *gauge = gauge_.load(std::memory_order_relaxed)) {
+        gauge->dec(static_cast<int64_t>(bytes));
+    }
+}
+
+size_t voip::VAudioAccount::excess(size_t bytes) const
+{
+    return VAudioBudget::instance().excess(bytes_.load(std::memory_order_relaxed), bytes);
+}
+
+size_t voip::VAudioAccount::bytes() const
+{
+    return bytes_.load(std::memory_order_relaxed);
+}
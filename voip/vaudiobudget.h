@@ -0,0 +1,102 @@
+#ifndef _VAUDIOBUDGET_H_
+#define _VAUDIOBUDGET_H_
+
+#include <atomic>
+#include <cstddef>
+
+namespace voip {
+
+class VConfig;
+class VGauge;
+
+// 音频缓冲的内存预算 (audio.budget.*), 防止 AI 后端卡住时各路缓冲无限增长
+// 全进程一份总预算, 每路呼叫一份单路预算, 记账的是待播放的回复和已发出未回复完的上行分片
+// 超出时按策略削减: drop_oldest 丢弃该路最旧的待播音频腾出空间, drop_newest 丢弃新到的音频,
+// reject 同 drop_newest, 另外总用量超过 reject_pct 时准入控制以 503 拒绝新呼叫
+// 上行分片发出后无法撤回, 任何策略下超出时都丢弃新的分片
+class VAudioBudget
+{
+public:
+    enum Policy {
+        DROP_OLDEST,
+        DROP_NEWEST,
+        REJECT
+    };
+
+    static VAudioBudget &
+    instance();
+
+    void
+    configure(const VConfig &cfg);
+
+    Policy
+    policy() const;
+
+    // 策略为 reject 且总用量超过 reject_pct
+    bool
+    rejecting() const;
+
+    size_t
+    used() const;
+
+private:
+    friend class VAudioAccount;
+
+    // held 为该路已用字节数, 两级预算都放得下时计入总用量
+    bool
+    reserve(size_t held, size_t bytes);
+
+    void
+    release(size_t bytes);
+
+    // 要放下 bytes 还需腾出的字节数
+    size_t
+    excess(size_t held, size_t bytes) const;
+
+    size_t total_limit_ = 0; // 0 不限
+    size_t call_limit_ = 0;  // 0 不限
+    Policy policy_ = DROP_OLDEST;
+    unsigned reject_pct_ = 80;
+    std::atomic<size_t> used_ {0};
+};
+
+// 一路呼叫的缓冲记账, 属于 VAiPlayer, 随端口复用
+// 播放端和上行端在不同线程上记账, 计数为原子量
+class VAudioAccount
+{
+public:
+    VAudioAccount();
+    ~VAudioAccount();
+
+    // 绑定到呼叫, 之后的用量记入 voip_call_audio_buffer_bytes{call="<id>"}
+    void
+    attach(int call_id);
+
+    // 归还全部用量, 输出本路峰值
+    void
+    reset();
+
+    // 超出预算时不记账, 返回 false
+    bool
+    charge(size_t bytes);
+
+    void
+    release(size_t bytes);
+
+    // 要放下 bytes 还需腾出的字节数
+    size_t
+    excess(size_t bytes) const;
+
+    size_t
+    bytes() const;
+
+private:
+    int call_id_ = -1;
+    std::atomic<size_t> bytes_ {0};
+    std::atomic<size_t> peak_ {0};
+    std::atomic<VGauge *> gauge_ {nullptr};
+};
+
+} // namespace voip
+
+#endif // _VAUDIOBUDGET_H_
@@ -1,7 +1,19 @@
 #include "vaudiomediaport.h"
+#include "vlog.h"
+#include "vmetrics.h"
+#include "vtrace.h"
 
-#include <fstream>
-#include <iostream>
+namespace {
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VCounter &frames_tx = metrics.counter("voip_media_frames_total", "Frames handled by custom media ports", "dir=\"tx\"");
+voip::VCounter &frames_rx = metrics.counter("voip_media_frames_total", "Frames handled by custom media ports", "dir=\"rx\"");
+
+voip::VHistogram &frame_requested_latency = metrics.histogram("voip_callback_latency_seconds", "pjsua2 callback duration", "callback=\"onFrameRequested\"");
+voip::VHistogram &frame_received_latency = metrics.histogram("voip_callback_latency_seconds", "pjsua2 callback duration", "callback=\"onFrameReceived\"");
+
+} // namespace
 
 voip::VAudioMediaPort::VAudioMediaPort()
 {
@@ -13,16 +25,30 @@ voip::VAudioMediaPort::~VAudioMediaPort()
 
 void voip::VAudioMediaPort::onFrameRequested(pj::MediaFrame &frame)
 {
-    std::cout << "frame send" << std::endl;
+    VScopedLatency latency(frame_requested_latency);
+    frames_tx.inc();
+    VLOG_TRACE << "frame send";
+    traceFirstFrame();
 }
 
 void voip::VAudioMediaPort::onFrameReceived(pj::MediaFrame &frame)
 {
-    std::cout << "frame recv" << std::endl;
-    std::fstream recv_frame("recv.pcm", std::ios::binary | std::ios::app);
-    if (recv_frame.is_open()) {
-        recv_frame.write(reinterpret_cast<const char *>(frame.buf.data()), frame.size);
-        recv_frame.close();
+    VScopedLatency latency(frame_received_latency);
+    frames_rx.inc();
+    VLOG_TRACE << "frame recv";
+    traceFirstFrame();
+}
+
+void voip::VAudioMediaPort::setCallId(int call_id)
+{
+    call_id_ = call_id;
+}
+
+void voip::VAudioMediaPort::traceFirstFrame()
+{
+    if (!first_frame_.load(std::memory_order_relaxed) && !first_frame_.exchange(true)) {
+        VTRACE_END("media_to_first_frame", call_id_);
+        VTRACE_INSTANT("first_frame", call_id_);
     }
 }
 
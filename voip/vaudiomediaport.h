@@ -4,6 +4,8 @@
 #include <pjsua2.hpp>
 #include <pjsua2/media.hpp>
 
+#include <atomic>
+
 namespace voip {
 
 class VAudioMediaPort : public pj::AudioMediaPort
@@ -17,6 +19,17 @@ public:
 
     virtual void
     onFrameReceived(pj::MediaFrame &frame) override;
+
+    // 所属呼叫, 用于时间线追踪
+    void
+    setCallId(int call_id);
+
+private:
+    void
+    traceFirstFrame();
+
+    int call_id_ = PJSUA_INVALID_ID;
+    std::atomic<bool> first_frame_ {false};
 };
 
 // class VRecvAudioMediaPort : public VAudioMediaPort
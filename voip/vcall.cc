@@ -1,101 +1,369 @@
 #include "vcall.h"
 #include "vaccount.h"
+#include "vaipool.h"
+#include "vcallrecorder.h"
+#include "vlog.h"
+#include "vmetrics.h"
+#include "vtrace.h"
 
 #include <pjsua2/call.hpp>
-#include <iostream>
+
+#include <algorithm>
+
+namespace {
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VGauge &active_calls = metrics.gauge("voip_active_calls", "Calls in CONFIRMED state");
+voip::VCounter &calls_failed = metrics.counter("voip_calls_failed_total", "Calls that failed before being established");
+
+voip::VHistogram &call_state_latency = metrics.histogram("voip_callback_latency_seconds", "pjsua2 callback duration", "callback=\"onCallState\"");
+voip::VHistogram &ai_setup_latency = metrics.histogram("voip_ai_port_setup_seconds", "Time to take AI ports for a call and connect them to the call media");
+voip::VHistogram &media_state_latency = metrics.histogram("voip_callback_latency_seconds", "pjsua2 callback duration", "callback=\"onCallMediaState\"");
+
+} // namespace
 
 voip::VCall::VCall(voip::VAccount &acc, int call_id) :
     Call(acc, call_id),
-    acc_(acc)
+    acc_(acc),
+    setup_begin_(std::chrono::steady_clock::now()),
+    ai_wanted_(acc.aiAutoAttach())
 {
+    acc_.admission().callStarted();
 }
 
 voip::VCall::~VCall()
 {
+    {
+        std::lock_guard<std::mutex> lock(route_mutex_);
+        releaseAi();
+        graph_.teardown();
+    }
+    if (active_) {
+        active_calls.dec();
+    }
+    if (!ended_) {
+        acc_.admission().callEnded();
+    }
     if (acc_.cur_call == this) {
         acc_.cur_call = nullptr;
-        std::cout << ">>> Call object destroyed, account call pointer cleared." << std::endl;
+        VLOG_DEBUG << ">>> Call object destroyed, account call pointer cleared.";
     }
     else {
-        std::cout << ">>> Call object destroyed (was not the account's active call)." << std::endl;
+        VLOG_DEBUG << ">>> Call object destroyed (was not the account's active call).";
     }
 }
 
 void voip::VCall::onCallState(pj::OnCallStateParam &prm)
 {
     PJ_UNUSED_ARG(prm);
+    VScopedLatency latency(call_state_latency);
     try {
         pj::CallInfo ci = getInfo();
-        std::cout << ">>> call " << ci.id << " state: " << ci.stateText;
-        if (!ci.lastReason.empty()) {
-            std::cout << " (reason: " << ci.lastReason << ")";
-        }
-        std::cout << std::endl;
+        VLOG_INFO << ">>> call " << ci.id << " state: " << ci.stateText
+                  << (ci.lastReason.empty() ? "" : " (reason: " + ci.lastReason + ")");
 
         if (ci.state == PJSIP_INV_STATE_DISCONNECTED) {
-            std::cout << ">>> call " << ci.id << " disconnected." << std::endl;
+            VLOG_INFO << ">>> call " << ci.id << " disconnected.";
+            if (active_) {
+                active_ = false;
+                active_calls.dec();
+            }
+            else if (!confirmed_) {
+                calls_failed.inc();
+            }
+            {
+                std::lock_guard<std::mutex> lock(route_mutex_);
+                // 呼叫端口已随通话拆除, 与其相连的边无需再断开
+                graph_.detachNode("call");
+                call_med_idx_ = -1;
+                releaseAi();
+                if (recorder_) {
+                    recorder_->close();
+                }
+            }
+            if (!ended_) {
+                ended_ = true;
+                acc_.admission().callEnded();
+            }
+            if (outcome_handler_) {
+                VCallOutcome outcome;
+                outcome.call_id = ci.id;
+                outcome.status = ci.lastStatusCode;
+                outcome.answered = confirmed_;
+                auto setup_end = confirmed_ ? confirmed_at_ : std::chrono::steady_clock::now();
+                outcome.setup = std::chrono::duration_cast<std::chrono::milliseconds>(setup_end - setup_begin_);
+                outcome.duration = std::chrono::milliseconds(ci.connectDuration.sec * 1000 + ci.connectDuration.msec);
+                outcome.reason = ci.lastReason;
+                auto handler = std::move(outcome_handler_);
+                outcome_handler_ = nullptr;
+                handler(outcome);
+            }
             if (acc_.cur_call == this) {
                 acc_.cur_call = nullptr;
-                std::cout << ">>> account's active call pointer cleared due to DISCONNECTED state." << std::endl;
+                VLOG_DEBUG << ">>> account's active call pointer cleared due to DISCONNECTED state.";
             }
+            // 置位后主线程的 reapCalls 随时可能 delete 本对象, 必须是本分支最后一条访问 this 的语句
+            disconnected_ = true;
         }
         else if (ci.state == PJSIP_INV_STATE_CONFIRMED) {
-            std::cout << ">>> call " << ci.id << " connected/Confirmed." << std::endl;
+            VLOG_INFO << ">>> call " << ci.id << " connected/Confirmed.";
+            VTRACE_INSTANT("call_confirmed", ci.id);
+            if (!confirmed_) {
+                confirmed_at_ = std::chrono::steady_clock::now();
+            }
+            confirmed_ = true;
+            if (!active_) {
+                active_ = true;
+                active_calls.inc();
+            }
+            if (!media_seen_) {
+                VTRACE_BEGIN("confirmed_to_media", ci.id);
+            }
         }
     }
     catch (const pj::Error &err) {
-        std::cerr << ">>> error getting call info in onCallState: " << err.info() << std::endl;
+        VLOG_ERROR << ">>> error getting call info in onCallState: " << err.info();
     }
 }
 
 void voip::VCall::onCallMediaState(pj::OnCallMediaStateParam &prm)
 {
     PJ_UNUSED_ARG(prm);
+    VScopedLatency latency(media_state_latency);
     try {
         pj::CallInfo ci = getInfo();
-        std::cout << ">>> call " << ci.id << " Media State Changed" << std::endl;
-
-        // voip::VRecvAudioMediaPort *recv_aud_med = new voip::VRecvAudioMediaPort {};
-        // voip::VSendAudioMediaPort *send_aud_med = new voip::VSendAudioMediaPort {};
-        // pj::MediaFormatAudio med_for_aud;
-
-        // med_for_aud.init(PJMEDIA_FORMAT_PCM, 8000, 1, 20, 16);
-        // recv_aud_med->createPort("recv", med_for_aud);
-        // send_aud_med->createPort("send", med_for_aud);
-
-        pj::AudDevManager &mgr = pj::Endpoint::instance().audDevManager();
-        auto cap_dev_med = mgr.getCaptureDevMedia();
-        auto play_dev_med = mgr.getPlaybackDevMedia();
+        VLOG_INFO << ">>> call " << ci.id << " Media State Changed";
+        VTRACE_INSTANT("media_state", ci.id);
+        if (!media_seen_) {
+            media_seen_ = true;
+            if (confirmed_) {
+                VTRACE_END("confirmed_to_media", ci.id);
+            }
+            // 由挂在该呼叫上的媒体端口收到首帧时结束
+            VTRACE_BEGIN("media_to_first_frame", ci.id);
+        }
 
+        std::lock_guard<std::mutex> lock(route_mutex_);
         for (unsigned i = 0; i < ci.media.size(); ++i) {
             if (ci.media[i].type == PJMEDIA_TYPE_AUDIO && getMedia(i)) {
-                pj::AudioMedia aud_med = getAudioMedia(i);
-
+                if (call_med_idx_ >= 0 && call_med_idx_ != static_cast<int>(i)) {
+                    VLOG_INFO << ">>> call " << ci.id << " ignoring extra audio stream " << i;
+                    continue;
+                }
                 if (ci.media[i].status == PJSUA_CALL_MEDIA_ACTIVE) {
-                    try {
-                        cap_dev_med.startTransmit(aud_med);
-                        aud_med.startTransmit(play_dev_med);
-
-                        // recv_aud_med->startTransmit(*send_aud_med);
-                        // send_aud_med->startTransmit(play_dev_med);
-
-                        // play_dev_med.startTransmit(*recv_aud_med);
-                        // aud_med.startTransmit(*recv_aud_med);
-                        // recv_aud_med->startTransmit(aud_med);
-                    }
-                    catch (pj::Error &err) {
-                        std::cerr << ">>> failed to connect audio for call " << ci.id << ": " << err.info() << std::endl;
-                    }
+                    pj::AudioMedia aud_med = getAudioMedia(i);
+                    call_med_idx_ = static_cast<int>(i);
+                    declareRoutes(aud_med, ci.id);
+                }
+                else if (call_med_idx_ == static_cast<int>(i)) {
+                    // 保持或媒体出错: 先断开呼叫端口, AI 端口归还
+                    graph_.removeNode("call");
+                    call_med_idx_ = -1;
+                    releaseAi();
                 }
             }
             else if (ci.media[i].type != PJMEDIA_TYPE_AUDIO) {
-                std::cout << ">>> non-audio media stream detected (type: " << ci.media[i].type << ")" << std::endl;
+                VLOG_INFO << ">>> non-audio media stream detected (type: " << ci.media[i].type << ")";
+            }
+        }
+
+        // 只有变化的边会被断开或连接, re-INVITE 后端口未变时已有连接保持
+        unsigned failed = graph_.apply();
+        if (failed > 0) {
+            VLOG_ERROR << ">>> call " << ci.id << ": " << failed << " media edges failed";
+            // AI 路由不完整时归还端口, 下次媒体更新再取
+            if (ai_) {
+                releaseAi();
             }
         }
     }
     catch (const pj::Error &err) {
-        std::cerr << ">>> error in onCallMediaState: " << err.info() << std::endl;
+        VLOG_ERROR << ">>> error in onCallMediaState: " << err.info();
+    }
+}
+
+bool voip::VCall::disconnected() const
+{
+    return disconnected_.load();
+}
+
+int voip::VCall::streamIndex() const
+{
+    return call_med_idx_.load();
+}
+
+void voip::VCall::setOutcomeHandler(std::function<void(const VCallOutcome &)> handler)
+{
+    outcome_handler_ = std::move(handler);
+}
+
+bool voip::VCall::setAi(bool on)
+{
+    if (on && !acc_.aiPool()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(route_mutex_);
+    // 上次接入失败后端口已归还, 再次打开时重试
+    if (ai_wanted_ == on && (ai_ != nullptr) == on) {
+        return true;
+    }
+    ai_wanted_ = on;
+    int med_idx = call_med_idx_.load();
+    if (med_idx < 0) {
+        // 媒体建立时按 ai_wanted_ 声明
+        return true;
+    }
+    int call_id = getId();
+    pj::AudioMedia aud_med = getAudioMedia(med_idx);
+    declareRoutes(aud_med, call_id);
+    unsigned failed = graph_.apply();
+    if (failed > 0) {
+        VLOG_ERROR << ">>> call " << call_id << ": " << failed << " media edges failed switching AI " << (on ? "on" : "off");
+        if (ai_) {
+            releaseAi();
+        }
+        return false;
+    }
+    VLOG_INFO << ">>> call " << call_id << " AI " << (on ? "attached" : "detached");
+    return true;
+}
+
+bool voip::VCall::aiAttached()
+{
+    std::lock_guard<std::mutex> lock(route_mutex_);
+    return ai_ != nullptr;
+}
+
+bool voip::VCall::aiStats(VPlayoutStats &playout, VChunkStats &chunk)
+{
+    std::lock_guard<std::mutex> lock(route_mutex_);
+    if (!ai_) {
+        return false;
+    }
+    playout = ai_->player->playoutStats();
+    chunk = ai_->processor->chunkStats();
+    return true;
+}
+
+bool voip::VCall::playPrompt(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(route_mutex_);
+    if (!graph_.hasNode("call")) {
+        return false;
+    }
+    std::unique_ptr<pj::AudioMediaPlayer> player(new pj::AudioMediaPlayer);
+    try {
+        player->createPlayer(path, PJMEDIA_FILE_NO_LOOP);
+    }
+    catch (const pj::Error &err) {
+        VLOG_ERROR << ">>> cannot play " << path << ": " << err.info();
+        return false;
+    }
+    // 端口变化的节点在 apply 时重连, 旧播放器断开后再释放
+    graph_.setNode("prompt", *player);
+    graph_.connect("prompt", "call");
+    unsigned failed = graph_.apply();
+    prompt_ = std::move(player);
+    if (failed > 0) {
+        VLOG_ERROR << ">>> call " << getId() << ": prompt " << path << " not connected";
+        return false;
+    }
+    VLOG_INFO << ">>> call " << getId() << " playing " << path;
+    return true;
+}
+
+void voip::VCall::declareRoutes(pj::AudioMedia &aud_med, int call_id)
+{
+    graph_.setNode("call", aud_med);
+    declareRecorder(aud_med, call_id);
+
+    VAiPortPool *pool = acc_.aiPool();
+    if (pool && ai_wanted_) {
+        graph_.removeNode("capture");
+        graph_.removeNode("playback");
+        if (!ai_) {
+            VScopedLatency setup(ai_setup_latency);
+            // 端口格式可跟随协商的编解码器, 省去会议桥的重采样
+            unsigned codec_rate = 0;
+            unsigned codec_ptime_ms = 0;
+            try {
+                pj::StreamInfo si = getStreamInfo(static_cast<unsigned>(call_med_idx_.load()));
+                codec_rate = si.codecClockRate;
+                codec_ptime_ms = si.codecParam.info.frameLen * std::max(1u, si.codecParam.setting.frmPerPkt);
+            }
+            catch (const pj::Error &err) {
+                VLOG_DEBUG << ">>> no stream info for call " << call_id << ": " << err.info();
+            }
+            ai_ = pool->acquire(call_id, setup_begin_, codec_rate, codec_ptime_ms);
+        }
+        graph_.setNode("ai_in", *ai_->processor);
+        graph_.setNode("ai_out", *ai_->player);
+        graph_.connect("call", "ai_in");
+        graph_.connect("ai_out", "call");
+        return;
+    }
+
+    // 控制接口关闭 AI 时改回本地音频
+    releaseAi();
+
+    // recv_aud_med->startTransmit(*send_aud_med) 一类的本地环回同样在这里声明
+    try {
+        pj::AudDevManager &mgr = pj::Endpoint::instance().audDevManager();
+        graph_.setNode("capture", mgr.getCaptureDevMedia());
+        graph_.setNode("playback", mgr.getPlaybackDevMedia());
+        graph_.connect("capture", "call");
+        graph_.connect("call", "playback");
+    }
+    catch (const pj::Error &err) {
+        VLOG_ERROR << ">>> no sound device for call " << call_id << ": " << err.info();
+    }
+}
+
+void voip::VCall::declareRecorder(pj::AudioMedia &aud_med, int call_id)
+{
+    VRecordWriter &writer = VRecordWriter::instance();
+    if (recorder_ || !writer.recordCalls()) {
+        return;
+    }
+    // 与呼叫端口同频, 会议桥不必为录音重采样
+    unsigned rate = 8000;
+    try {
+        rate = aud_med.getPortInfo().format.clockRate;
+    }
+    catch (const pj::Error &err) {
+        VLOG_DEBUG << ">>> no port info for call " << call_id << ": " << err.info();
+    }
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    std::string path = writer.directory() + "/call-" + std::to_string(call_id) + "-"
+                       + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now).count()) + ".wav";
+
+    std::unique_ptr<VCallRecorder> recorder(new VCallRecorder);
+    if (!recorder->open(path, rate, 20, writer.maxCatchup()) || !recorder->createPorts("recorder" + std::to_string(call_id))) {
+        return;
+    }
+    recorder_ = std::move(recorder);
+    // 左声道录对端, 右声道录发给对端的本端音频; 本端节点随 AI / 本地模式切换出现或消失, 边一直声明着
+    graph_.setNode("recorder", recorder_->port(VCallRecorder::CALLER));
+    graph_.setNode("recorder_agent", recorder_->port(VCallRecorder::AGENT));
+    graph_.connect("call", "recorder");
+    graph_.connect("ai_out", "recorder_agent");
+    graph_.connect("prompt", "recorder_agent");
+    graph_.connect("capture", "recorder_agent");
+    VLOG_INFO << ">>> call " << call_id << " recording to " << path;
+}
+
+void voip::VCall::releaseAi()
+{
+    if (!ai_) {
+        return;
     }
+    // 边的声明保留, 端口节点去掉后 apply 只断开 AI 相关的边
+    graph_.removeNode("ai_in");
+    graph_.removeNode("ai_out");
+    graph_.apply();
+    acc_.aiPool()->release(ai_);
+    ai_ = nullptr;
 }
 
 // void voip::VCall::onStreamCreated(pj::OnStreamCreatedParam &prm)
@@ -1,11 +1,35 @@
 #ifndef _VCALL_H_
 #define _VCALL_H_
 
+#include "vmediagraph.h"
+
 #include <pjsua2.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
 namespace voip {
 
 class VAccount;
+class VCallRecorder;
+struct VAiPorts;
+struct VChunkStats;
+struct VPlayoutStats;
+
+// 呼叫的最终结果, 断开时回调 (pjsua 线程)
+struct VCallOutcome
+{
+    int call_id = -1;
+    int status = 0;                     // 最终状态码, 接通后正常挂断为 200
+    bool answered = false;              // 曾进入 CONFIRMED
+    std::chrono::milliseconds setup {0}; // 发起到接通; 未接通时为发起到失败
+    std::chrono::milliseconds duration {0}; // 通话时长
+    std::string reason;
+};
 
 class VCall : public pj::Call
 {
@@ -22,8 +46,80 @@ public:
     onCallMediaState(pj::OnCallMediaStateParam &prm) override;
     // virtual void onStreamCreated(pj::OnStreamCreatedParam &prm) override;
 
+    // 已进入 DISCONNECTED, 可以释放
+    bool
+    disconnected() const;
+
+    // 接入媒体图的音频流序号, 无活动音频时为 -1; 供统计线程读取
+    int
+    streamIndex() const;
+
+    // 在 makeCall 之前设置, 断开时调用一次
+    void
+    setOutcomeHandler(std::function<void(const VCallOutcome &)> handler);
+
+    // 控制接口调用 (主线程), 与媒体回调的路由更新互斥
+    // 打开或关闭本路的 AI 管线, 媒体已建立时立即切换路由; 未启用 AI (无端口池) 时打开返回 false
+    bool
+    setAi(bool on);
+
+    bool
+    aiAttached();
+
+    // 已接入 AI 端口时填入两端统计
+    bool
+    aiStats(VPlayoutStats &playout, VChunkStats &chunk);
+
+    // 向对端播放一段 WAV 提示音 (不循环), 与 AI 回复或本地采集混音; 替换正在播放的提示音
+    // 媒体未建立或文件打不开时返回 false
+    bool
+    playPrompt(const std::string &path);
+
 private:
+    // 按当前媒体状态声明路由: AI 端口可用时 call <-> ai_in / ai_out, 否则 capture -> call -> playback
+    void
+    declareRoutes(pj::AudioMedia &aud_med, int call_id);
+
+    // record.calls 打开时创建双声道录音端口: "call" -> "recorder", 本端音源 -> "recorder_agent"
+    // 由持有 route_mutex_ 的调用方调用
+    void
+    declareRecorder(pj::AudioMedia &aud_med, int call_id);
+
+    // 断开 AI 端口并归还到池; 以下两个函数由持有 route_mutex_ 的调用方调用
+    void
+    releaseAi();
+
     VAccount &acc_;
+
+    // 应答 (或呼出) 时刻
+    std::chrono::steady_clock::time_point setup_begin_;
+
+    // 保护 graph_ / ai_ / ai_wanted_ / prompt_: 媒体回调在 pjsua 线程, 控制接口在主线程
+    std::mutex route_mutex_;
+    VMediaGraph graph_;
+    // 接入媒体图的 "call" 节点对应的媒体序号
+    std::atomic<int> call_med_idx_ {-1};
+    VAiPorts *ai_ = nullptr;
+    // 有端口池时是否接 AI, 初值取 ai.auto_attach
+    bool ai_wanted_ = true;
+    // "prompt" 节点的播放器, 析构时先 teardown 断开再释放
+    std::unique_ptr<pj::AudioMediaPlayer> prompt_;
+    // "recorder" / "recorder_agent" 节点, 断开时关闭录音文件
+    std::unique_ptr<VCallRecorder> recorder_;
+
+    std::function<void(const VCallOutcome &)> outcome_handler_;
+    std::chrono::steady_clock::time_point confirmed_at_;
+
+    // 建立时延追踪
+    bool confirmed_ = false;
+    bool media_seen_ = false;
+
+    // 已计入 voip_active_calls
+    bool active_ = false;
+
+    // 已从 VAdmission 进行中计数里扣除
+    bool ended_ = false;
+    std::atomic<bool> disconnected_ {false};
 };
 
 } // namespace voip
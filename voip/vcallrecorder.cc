@@ -0,0 +1,213 @@
+#include "vcallrecorder.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VCounter &gap_frames = metrics.counter("voip_record_gap_frames_total", "Silent frames inserted into stereo call recordings from frame arrival times");
+
+// out[2i] = left[i], out[2i + 1] = right[i]
+void
+interleave(const int16_t *left, const int16_t *right, int16_t *out, size_t count)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    // 每次 8 个样本对, 两次 unpack 得到 16 个交织样本
+    for (; i + 8 <= count; i += 8) {
+        __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(left + i));
+        __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(right + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i + 8), _mm_unpackhi_epi16(l, r));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+} // namespace
+
+// 一个声道的会议桥端口, 只接收
+class voip::VCallRecorder::Leg : public pj::AudioMediaPort
+{
+public:
+    Leg(VCallRecorder &owner, Channel channel) :
+        owner_(owner),
+        channel_(channel)
+    {
+    }
+
+    ~Leg()
+    {
+    }
+
+    virtual void
+    onFrameRequested(pj::MediaFrame &frame) override
+    {
+        frame.type = PJMEDIA_FRAME_TYPE_NONE;
+        frame.size = 0;
+    }
+
+    virtual void
+    onFrameReceived(pj::MediaFrame &frame) override
+    {
+        auto now = std::chrono::steady_clock::now();
+        // 没有发送端时会议桥送 NONE 帧, 同样占一个时隙
+        if (frame.type == PJMEDIA_FRAME_TYPE_AUDIO && frame.size > 0) {
+            owner_.push(channel_, reinterpret_cast<const int16_t *>(frame.buf.data()), frame.size / sizeof(int16_t), now);
+        }
+        else {
+            owner_.push(channel_, nullptr, 0, now);
+        }
+    }
+
+private:
+    VCallRecorder &owner_;
+    Channel channel_;
+};
+
+voip::VCallRecorder::VCallRecorder()
+{
+}
+
+voip::VCallRecorder::~VCallRecorder()
+{
+    close();
+    // 端口析构时从会议桥移除, 之后不再有回调
+    legs_[CALLER].reset();
+    legs_[AGENT].reset();
+}
+
+bool voip::VCallRecorder::open(const std::string &path, unsigned clock_rate, unsigned ptime_ms, unsigned max_catchup)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    clock_rate_ = clock_rate;
+    ptime_ms_ = std::max(1u, ptime_ms);
+    frame_samples_ = clock_rate * ptime_ms_ / 1000;
+    ptime_ = std::chrono::milliseconds(ptime_ms_);
+    max_catchup_ = max_catchup;
+    for (int ch = CALLER; ch <= AGENT; ++ch) {
+        pending_[ch].assign(frame_samples_, 0);
+        seen_[ch] = false;
+    }
+    stereo_.assign(frame_samples_ * 2, 0);
+    if (!recording_.open(path, clock_rate, 2)) {
+        return false;
+    }
+    open_ = true;
+    started_ = false;
+    frames_ = 0;
+    gap_frames_ = 0;
+    return true;
+}
+
+bool voip::VCallRecorder::createPorts(const std::string &name)
+{
+    try {
+        for (int ch = CALLER; ch <= AGENT; ++ch) {
+            std::unique_ptr<Leg> leg(new Leg(*this, static_cast<Channel>(ch)));
+            pj::MediaFormatAudio fmt;
+            fmt.init(PJMEDIA_FORMAT_PCM, clock_rate_, 1, ptime_ms_ * 1000, 16);
+            leg->createPort(name + (ch == CALLER ? "-caller" : "-agent"), fmt);
+            legs_[ch] = std::move(leg);
+        }
+    }
+    catch (const pj::Error &err) {
+        VLOG_ERROR << ">>> cannot create recorder " << name << ": " << err.info();
+        return false;
+    }
+    return true;
+}
+
+void voip::VCallRecorder::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_) {
+        return;
+    }
+    if (started_) {
+        flush();
+    }
+    open_ = false;
+    recording_.close();
+}
+
+pj::AudioMediaPort &voip::VCallRecorder::port(Channel channel)
+{
+    return *legs_[channel];
+}
+
+uint64_t voip::VCallRecorder::frames()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return frames_;
+}
+
+uint64_t voip::VCallRecorder::gapFrames()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return gap_frames_;
+}
+
+void voip::VCallRecorder::push(Channel channel, const int16_t *samples, size_t count,
+                               std::chrono::steady_clock::time_point at)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_) {
+        return;
+    }
+    if (!started_) {
+        started_ = true;
+        tick_at_ = at;
+        grid_ = at;
+        slot_ = 0;
+    }
+    // 同一周期内两个端口的回调相隔远小于半帧; 本声道在当前时隙已有帧或相隔超过半帧, 说明会议桥进入了下一周期
+    else if (seen_[channel] || at - tick_at_ >= ptime_ / 2) {
+        flush();
+        int64_t next = slot_ + 1;
+        // 会议桥按 grid_ + n * ptime 的绝对时刻驱动; 落后不超过 max_catchup 帧时随后会补跑, 这一帧照常占下一个时隙,
+        // 超过时会议桥放弃了落后的帧 (或根本停送过), 这一帧属于更后面的时隙, 中间补静音
+        auto late = at - (grid_ + ptime_ * next);
+        int64_t behind = late.count() > 0 ? late / ptime_ : 0;
+        if (behind > static_cast<int64_t>(max_catchup_)) {
+            std::fill(stereo_.begin(), stereo_.end(), 0);
+            for (int64_t gap = 0; gap < behind; ++gap) {
+                recording_.write(stereo_.data(), stereo_.size());
+            }
+            frames_ += behind;
+            gap_frames_ += behind;
+            gap_frames.inc(behind);
+            next += behind;
+        }
+        // 网格取准时到达的周期, 每帧允许后移千分之一帧, 跟得上声卡时钟相对系统时钟的漂移
+        grid_ = std::min(grid_ + ptime_ / 1000, at - ptime_ * next);
+        slot_ = next;
+        tick_at_ = at;
+    }
+    if (samples) {
+        std::memcpy(pending_[channel].data(), samples, std::min(count, pending_[channel].size()) * sizeof(int16_t));
+    }
+    seen_[channel] = true;
+}
+
+void voip::VCallRecorder::flush()
+{
+    interleave(pending_[CALLER].data(), pending_[AGENT].data(), stereo_.data(), frame_samples_);
+    recording_.write(stereo_.data(), stereo_.size());
+    ++frames_;
+    for (int ch = CALLER; ch <= AGENT; ++ch) {
+        std::fill(pending_[ch].begin(), pending_[ch].end(), 0);
+        seen_[ch] = false;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef _VCALLRECORDER_H_
+#define _VCALLRECORDER_H_
+
+#include "vrecorder.h"
+
+#include <pjsua2.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace voip {
+
+// 双声道通话录音: 左声道为对端 (呼叫端口发出的音频), 右声道为本端 (AI 回复、提示音或麦克风)
+// 两个声道各是一个会议桥端口, 会议桥每个时钟周期各送一帧 (没有发送端时为 NONE 帧);
+// 同一周期的两帧归入同一时隙, 凑齐后交织 (SSE2) 成立体声写入 VRecording, 某一路本周期没有帧时该声道补静音
+// 每个周期占一个时隙, 晚到或追帧时挤在一起到达的帧依次排下去; 只有一帧比它的准点落后超过会议桥会补跑的帧数
+// (max_catchup: 时钟放弃补跑、保持、端口被禁用) 时才补静音, 两个声道共用时隙, 不会相互错位
+class VCallRecorder
+{
+public:
+    enum Channel {
+        CALLER = 0,
+        AGENT = 1
+    };
+
+    VCallRecorder();
+    ~VCallRecorder();
+
+    // 打开录音文件, clock_rate / ptime_ms 为端口格式
+    bool
+    open(const std::string &path, unsigned clock_rate, unsigned ptime_ms = 20, unsigned max_catchup = 5);
+
+    // 创建两个声道的会议桥端口, 需在 open 之后调用
+    bool
+    createPorts(const std::string &name);
+
+    // 写出最后一个时隙, 文件在写入线程上收尾; 端口仍留在会议桥上, 之后的帧被忽略
+    void
+    close();
+
+    // 对应声道的端口, 作为会议桥连接的目的端
+    pj::AudioMediaPort &
+    port(Channel channel);
+
+    // 一帧到达, samples 为空表示本周期该声道无音频; 端口在会议桥线程上调用, 基准程序可注入到达时刻
+    void
+    push(Channel channel, const int16_t *samples, size_t count, std::chrono::steady_clock::time_point at);
+
+    // 已写出的时隙数与其中按间隔补的静音时隙数
+    uint64_t
+    frames();
+
+    uint64_t
+    gapFrames();
+
+private:
+    class Leg;
+
+    // 交织并写出当前时隙, 由持有 mutex_ 的调用方调用
+    void
+    flush();
+
+    std::unique_ptr<Leg> legs_[2];
+
+    std::mutex mutex_;
+    VRecording recording_;
+    bool open_ = false;
+    unsigned clock_rate_ = 8000;
+    unsigned ptime_ms_ = 20;
+    unsigned frame_samples_ = 160; // 每声道每帧
+    std::chrono::nanoseconds ptime_ {20000000};
+    unsigned max_catchup_ = 5;
+
+    bool started_ = false;
+    std::chrono::steady_clock::time_point tick_at_; // 当前时隙第一帧的到达时刻
+    std::chrono::steady_clock::time_point grid_;    // 第 0 个时隙的准点, 第 n 个时隙为 grid_ + n * ptime_
+    int64_t slot_ = 0;                              // 当前时隙, 含补的静音
+    bool seen_[2] = {false, false};                 // 当前时隙各声道是否已到
+    std::vector<int16_t> pending_[2];               // 当前时隙各声道的样本, 未到的为零
+    std::vector<int16_t> stereo_;
+    uint64_t frames_ = 0;
+    uint64_t gap_frames_ = 0;
+};
+
+} // namespace voip
+
+#endif // _VCALLRECORDER_H_
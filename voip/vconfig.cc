@@ -0,0 +1,100 @@
+#include "vconfig.h"
+#include "vlog.h"
+
+#include <cstdlib>
+#include <fstream>
+
+namespace {
+
+std::string
+trim(const std::string &s)
+{
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+} // namespace
+
+bool voip::VConfig::load(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        VLOG_ERROR << ">>> failed to open config file " << path;
+        return false;
+    }
+
+    std::string line;
+    unsigned line_no = 0;
+    while (std::getline(in, line)) {
+        ++line_no;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            VLOG_WARN << ">>> " << path << ":" << line_no << ": expected key = value";
+            continue;
+        }
+        values_[trim(line.substr(0, eq))] = trim(line.substr(eq + 1));
+    }
+    return true;
+}
+
+bool voip::VConfig::has(const std::string &key) const
+{
+    return values_.count(key) != 0;
+}
+
+std::string voip::VConfig::getString(const std::string &key, const std::string &def) const
+{
+    auto it = values_.find(key);
+    return it == values_.end() ? def : it->second;
+}
+
+long voip::VConfig::getInt(const std::string &key, long def) const
+{
+    auto it = values_.find(key);
+    if (it == values_.end()) {
+        return def;
+    }
+    char *end = nullptr;
+    long v = std::strtol(it->second.c_str(), &end, 10);
+    return (end && *end == '\0') ? v : def;
+}
+
+double voip::VConfig::getDouble(const std::string &key, double def) const
+{
+    auto it = values_.find(key);
+    if (it == values_.end()) {
+        return def;
+    }
+    char *end = nullptr;
+    double v = std::strtod(it->second.c_str(), &end);
+    return (end && *end == '\0') ? v : def;
+}
+
+bool voip::VConfig::getBool(const std::string &key, bool def) const
+{
+    auto it = values_.find(key);
+    if (it == values_.end()) {
+        return def;
+    }
+    const std::string &v = it->second;
+    if (v == "1" || v == "true" || v == "yes" || v == "on") {
+        return true;
+    }
+    if (v == "0" || v == "false" || v == "no" || v == "off") {
+        return false;
+    }
+    return def;
+}
+
+void voip::VConfig::set(const std::string &key, const std::string &value)
+{
+    values_[key] = value;
+}
@@ -0,0 +1,42 @@
+#ifndef _VCONFIG_H_
+#define _VCONFIG_H_
+
+#include <map>
+#include <string>
+
+namespace voip {
+
+// 运行配置, 文件格式为每行 key = value, # 开头为注释
+// 各模块按需读取自己的 key, 缺省值由调用方给出, 可用 key 见 voip.conf
+class VConfig
+{
+public:
+    // 读取配置文件, 失败返回 false
+    bool
+    load(const std::string &path);
+
+    bool
+    has(const std::string &key) const;
+
+    std::string
+    getString(const std::string &key, const std::string &def = "") const;
+
+    long
+    getInt(const std::string &key, long def = 0) const;
+
+    double
+    getDouble(const std::string &key, double def = 0) const;
+
+    bool
+    getBool(const std::string &key, bool def = false) const;
+
+    void
+    set(const std::string &key, const std::string &value);
+
+private:
+    std::map<std::string, std::string> values_;
+};
+
+} // namespace voip
+
+#endif // _VCONFIG_H_
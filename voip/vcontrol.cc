@@ -0,0 +1,580 @@
+#include "vcontrol.h"
+#include "vaccount.h"
+#include "vaiport.h"
+#include "vaudiobudget.h"
+#include "vcall.h"
+#include "vconfig.h"
+#include "vdialer.h"
+#include "veventloop.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t MAX_LINE = 4096;
+const size_t MAX_PENDING_OUT = 4 * 1024 * 1024;
+const int READ_ROUNDS = 8;
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VCounter &requests_ok = metrics.counter("voip_control_requests_total", "Control socket requests", "result=\"ok\"");
+voip::VCounter &requests_err = metrics.counter("voip_control_requests_total", "Control socket requests", "result=\"err\"");
+voip::VGauge &connections = metrics.gauge("voip_control_connections", "Open control socket connections");
+
+// 取下一个以空白分隔的词, rest 为其后去掉前导空白的部分
+std::string
+nextWord(const std::string &text, std::string &rest)
+{
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        rest.clear();
+        return "";
+    }
+    size_t end = text.find_first_of(" \t", begin);
+    if (end == std::string::npos) {
+        rest.clear();
+        return text.substr(begin);
+    }
+    size_t next = text.find_first_not_of(" \t", end);
+    rest = next == std::string::npos ? "" : text.substr(next);
+    return text.substr(begin, end - begin);
+}
+
+bool
+parseCallId(const std::string &word, int &call_id)
+{
+    if (word.empty()) {
+        return false;
+    }
+    char *end = nullptr;
+    long value = std::strtol(word.c_str(), &end, 10);
+    if (*end != '\0' || value < 0) {
+        return false;
+    }
+    call_id = static_cast<int>(value);
+    return true;
+}
+
+// list 的一项不能含空白: "Name" <sip:a@b> 只取尖括号内的 URI
+std::string
+compactUri(const std::string &uri)
+{
+    size_t open = uri.find('<');
+    size_t close = uri.find('>', open);
+    std::string out = open != std::string::npos && close != std::string::npos ? uri.substr(open + 1, close - open - 1) : uri;
+    for (char &c : out) {
+        if (c == ' ' || c == '\t') {
+            c = '_';
+        }
+    }
+    return out;
+}
+
+std::string
+compactState(std::string state)
+{
+    for (char &c : state) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return state;
+}
+
+} // namespace
+
+voip::VControl::VControl(VEventLoop &loop, VAccount &acc) :
+    loop_(loop),
+    acc_(acc)
+{
+}
+
+voip::VControl::~VControl()
+{
+    stop();
+}
+
+bool voip::VControl::start(const VConfig &cfg)
+{
+    path_ = cfg.getString("control.socket", "");
+    if (path_.empty()) {
+        return true;
+    }
+    max_connections_ = static_cast<size_t>(std::max(1L, cfg.getInt("control.max_connections", 16)));
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path_.size() >= sizeof(addr.sun_path)) {
+        VLOG_ERROR << ">>> control socket path too long: " << path_;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path_.c_str(), path_.size());
+
+    // 上次未正常退出留下的套接字文件; 同名的其它文件不动
+    struct stat st;
+    if (lstat(path_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path_.c_str());
+    }
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0 || bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+        || listen(listen_fd_, 64) != 0) {
+        VLOG_ERROR << ">>> cannot listen on control socket " << path_ << ": " << std::strerror(errno);
+        if (listen_fd_ >= 0) {
+            ::close(listen_fd_);
+            listen_fd_ = -1;
+        }
+        return false;
+    }
+    // 同组用户可以控制
+    chmod(path_.c_str(), 0660);
+
+    loop_.add(listen_fd_, EPOLLIN, [this](uint32_t) { onAccept(); });
+    VLOG_INFO << ">>> control socket listening on " << path_;
+    return true;
+}
+
+void voip::VControl::stop()
+{
+    while (!connections_.empty()) {
+        close(connections_.begin()->first);
+    }
+    if (listen_fd_ >= 0) {
+        loop_.remove(listen_fd_);
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        unlink(path_.c_str());
+    }
+}
+
+void voip::VControl::setDialer(VDialer *dialer)
+{
+    dialer_ = dialer;
+}
+
+void voip::VControl::onAccept()
+{
+    for (;;) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                VLOG_WARN << ">>> control socket accept failed: " << std::strerror(errno);
+            }
+            return;
+        }
+        if (connections_.size() >= max_connections_) {
+            VLOG_WARN << ">>> control socket: too many connections, closing new one";
+            ::close(fd);
+            continue;
+        }
+        std::unique_ptr<Connection> conn(new Connection);
+        conn->fd = fd;
+        conn->events = EPOLLIN;
+        if (!loop_.add(fd, EPOLLIN, [this, fd](uint32_t events) { onEvents(fd, events); })) {
+            ::close(fd);
+            continue;
+        }
+        connections_[fd] = std::move(conn);
+        connections.inc();
+        VLOG_DEBUG << ">>> control connection " << fd << " opened";
+    }
+}
+
+void voip::VControl::onEvents(int fd, uint32_t events)
+{
+    auto it = connections_.find(fd);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection &conn = *it->second;
+    if (events & EPOLLERR) {
+        close(fd);
+        return;
+    }
+
+    for (;;) {
+        if (!conn.paused && !readRequests(conn)) {
+            close(fd);
+            return;
+        }
+        if (!flush(conn)) {
+            close(fd);
+            return;
+        }
+        // 回复发出去一部分后继续处理缓冲中剩下的请求
+        if (conn.paused && conn.out.size() - conn.out_pos < MAX_PENDING_OUT) {
+            conn.paused = false;
+            continue;
+        }
+        break;
+    }
+
+    if (conn.eof && !conn.paused && conn.out_pos == conn.out.size()) {
+        close(fd);
+        return;
+    }
+    updateEvents(conn);
+}
+
+bool voip::VControl::readRequests(Connection &conn)
+{
+    processLines(conn);
+    char buf[16384];
+    // 每次事件最多读这么多轮, 连接持续灌请求时其它 fd 和定时任务也能轮到
+    for (int rounds = 0; rounds < READ_ROUNDS && !conn.paused && !conn.eof;) {
+        ssize_t n = read(conn.fd, buf, sizeof(buf));
+        if (n > 0) {
+            conn.in.append(buf, static_cast<size_t>(n));
+            processLines(conn);
+            ++rounds;
+            continue;
+        }
+        if (n == 0) {
+            conn.eof = true;
+            // 最后一行可以不带换行
+            if (!conn.in.empty()) {
+                conn.in.push_back('\n');
+                processLines(conn);
+            }
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    return true;
+}
+
+void voip::VControl::processLines(Connection &conn)
+{
+    size_t pos = 0;
+    size_t eol;
+    while ((eol = conn.in.find('\n', pos)) != std::string::npos) {
+        if (conn.out.size() - conn.out_pos >= MAX_PENDING_OUT) {
+            conn.paused = true;
+            break;
+        }
+        size_t end = eol > pos && conn.in[eol - 1] == '\r' ? eol - 1 : eol;
+        handle(conn.in.substr(pos, end - pos), conn.out);
+        pos = eol + 1;
+    }
+    conn.in.erase(0, pos);
+    if (!conn.paused && conn.in.size() > MAX_LINE) {
+        conn.out += "- err line_too_long\n";
+        requests_err.inc();
+        conn.in.clear();
+        conn.eof = true;
+    }
+}
+
+bool voip::VControl::flush(Connection &conn)
+{
+    while (conn.out_pos < conn.out.size()) {
+        ssize_t n = send(conn.fd, conn.out.data() + conn.out_pos, conn.out.size() - conn.out_pos, MSG_NOSIGNAL);
+        if (n > 0) {
+            conn.out_pos += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // 已写出的前半段超过一半时再挪动, 避免每次部分写都拷贝
+            if (conn.out_pos > conn.out.size() / 2) {
+                conn.out.erase(0, conn.out_pos);
+                conn.out_pos = 0;
+            }
+            return true;
+        }
+        return false;
+    }
+    conn.out.clear();
+    conn.out_pos = 0;
+    return true;
+}
+
+void voip::VControl::updateEvents(Connection &conn)
+{
+    uint32_t events = 0;
+    if (!conn.paused && !conn.eof) {
+        events |= EPOLLIN;
+    }
+    if (conn.out_pos < conn.out.size()) {
+        events |= EPOLLOUT;
+    }
+    if (events != conn.events) {
+        loop_.modify(conn.fd, events);
+        conn.events = events;
+    }
+}
+
+void voip::VControl::close(int fd)
+{
+    loop_.remove(fd);
+    ::close(fd);
+    connections_.erase(fd);
+    connections.dec();
+    VLOG_DEBUG << ">>> control connection " << fd << " closed";
+}
+
+void voip::VControl::handle(const std::string &line, std::string &out)
+{
+    std::string rest;
+    std::string tag = nextWord(line, rest);
+    if (tag.empty()) {
+        return;
+    }
+    std::string args;
+    std::string op = nextWord(rest, args);
+
+    std::string result;
+    bool ok = false;
+    try {
+        if (op == "call") {
+            ok = opCall(args, result);
+        }
+        else if (op == "hangup") {
+            ok = opHangup(args, result);
+        }
+        else if (op == "list") {
+            ok = opList(result);
+        }
+        else if (op == "play") {
+            ok = opPlay(args, result);
+        }
+        else if (op == "ai") {
+            ok = opAi(args, result);
+        }
+        else if (op == "stats") {
+            ok = opStats(args, result);
+        }
+        else if (op == "campaign") {
+            ok = opCampaign(args, result);
+        }
+        else {
+            result = op.empty() ? "missing_op" : "unknown_op";
+        }
+    }
+    catch (const pj::Error &err) {
+        ok = false;
+        result = "pjsua_error " + std::to_string(err.status);
+    }
+
+    (ok ? requests_ok : requests_err).inc();
+    out += tag;
+    out += ok ? " ok" : " err";
+    if (!result.empty()) {
+        out += ' ';
+        out += result;
+    }
+    out += '\n';
+}
+
+bool voip::VControl::opCall(const std::string &args, std::string &result)
+{
+    std::string rest;
+    std::string uri = nextWord(args, rest);
+    if (uri.empty()) {
+        result = "usage";
+        return false;
+    }
+    VCall *call = acc_.makeCall(uri);
+    if (!call) {
+        result = "call_failed";
+        return false;
+    }
+    result = std::to_string(call->getId());
+    return true;
+}
+
+bool voip::VControl::opHangup(const std::string &args, std::string &result)
+{
+    std::string rest;
+    std::string target = nextWord(args, rest);
+    if (target == "all") {
+        acc_.hangupAll();
+        return true;
+    }
+    int call_id;
+    if (!parseCallId(target, call_id)) {
+        result = "usage";
+        return false;
+    }
+    VCall *call = acc_.findCall(call_id);
+    if (!call) {
+        result = "no_such_call";
+        return false;
+    }
+    pj::CallOpParam prm;
+    call->hangup(prm);
+    return true;
+}
+
+bool voip::VControl::opList(std::string &result)
+{
+    std::vector<VCall *> calls = acc_.calls();
+    result = std::to_string(calls.size());
+    for (VCall *call : calls) {
+        pj::CallInfo ci;
+        try {
+            ci = call->getInfo();
+        }
+        catch (const pj::Error &) {
+            // 列出期间刚刚结束的呼叫
+            continue;
+        }
+        result += ' ';
+        result += std::to_string(ci.id);
+        result += ',';
+        result += compactState(ci.stateText);
+        result += call->aiAttached() ? ",ai," : ",local,";
+        result += compactUri(ci.remoteUri);
+    }
+    return true;
+}
+
+bool voip::VControl::opPlay(const std::string &args, std::string &result)
+{
+    std::string path;
+    int call_id;
+    if (!parseCallId(nextWord(args, path), call_id) || path.empty()) {
+        result = "usage";
+        return false;
+    }
+    VCall *call = acc_.findCall(call_id);
+    if (!call) {
+        result = "no_such_call";
+        return false;
+    }
+    if (!call->playPrompt(path)) {
+        result = "play_failed";
+        return false;
+    }
+    return true;
+}
+
+bool voip::VControl::opAi(const std::string &args, std::string &result)
+{
+    std::string rest;
+    int call_id;
+    if (!parseCallId(nextWord(args, rest), call_id)) {
+        result = "usage";
+        return false;
+    }
+    std::string mode = nextWord(rest, rest);
+    if (!mode.empty() && mode != "on" && mode != "off") {
+        result = "usage";
+        return false;
+    }
+    VCall *call = acc_.findCall(call_id);
+    if (!call) {
+        result = "no_such_call";
+        return false;
+    }
+    bool on = mode != "off";
+    if (on && !acc_.aiPool()) {
+        result = "ai_disabled";
+        return false;
+    }
+    if (!call->setAi(on)) {
+        result = "media_failed";
+        return false;
+    }
+    return true;
+}
+
+bool voip::VControl::opStats(const std::string &args, std::string &result)
+{
+    std::string rest;
+    std::string target = nextWord(args, rest);
+    if (target.empty()) {
+        result = "calls=" + std::to_string(acc_.admission().callsInProgress());
+        result += " active=" + std::to_string(metrics.gauge("voip_active_calls", "Calls in CONFIRMED state").value());
+        result += " ai_pending="
+                  + std::to_string(metrics.gauge("voip_ai_pending_requests", "AI requests waiting for a response").value());
+        result += " audio_kb=" + std::to_string(VAudioBudget::instance().used() / 1024);
+        result += " control_connections=" + std::to_string(connections_.size());
+        return true;
+    }
+
+    int call_id;
+    if (!parseCallId(target, call_id)) {
+        result = "usage";
+        return false;
+    }
+    VCall *call = acc_.findCall(call_id);
+    if (!call) {
+        result = "no_such_call";
+        return false;
+    }
+    pj::CallInfo ci = call->getInfo();
+    result = "state=" + compactState(ci.stateText);
+    result += " duration_s=" + std::to_string(ci.connectDuration.sec);
+
+    VPlayoutStats playout;
+    VChunkStats chunk;
+    if (call->aiStats(playout, chunk)) {
+        result += " ai=on";
+        result += " playout_ms=" + std::to_string(playout.delay_ms);
+        result += " ttfa_ms=" + std::to_string(playout.ttfa_ms);
+        result += " turns=" + std::to_string(playout.turns);
+        result += " chunk_ms=" + std::to_string(chunk.chunk_ms);
+        result += " ai_rtt_ms=" + std::to_string(chunk.rtt_ms);
+        result += " ai_requests=" + std::to_string(chunk.requests);
+    }
+    else {
+        result += " ai=off";
+    }
+
+    std::vector<VStreamSample> samples = acc_.streamHistory(ci.id);
+    if (!samples.empty()) {
+        const VStreamSample &last = samples.back();
+        result += " rx_pkt=" + std::to_string(last.rx_pkt);
+        result += " rx_loss=" + std::to_string(last.rx_loss);
+        result += " jitter_us=" + std::to_string(last.rx_jitter_us);
+        result += " rtt_us=" + std::to_string(last.rtt_us);
+        result += " jb_ms=" + std::to_string(last.jb_delay_ms);
+    }
+    return true;
+}
+
+bool voip::VControl::opCampaign(const std::string &args, std::string &result)
+{
+    if (!dialer_) {
+        result = "no_campaign";
+        return false;
+    }
+    std::string rest;
+    std::string action = nextWord(args, rest);
+    if (action == "pause" || action == "resume") {
+        dialer_->pause(action == "pause");
+    }
+    else if (!action.empty()) {
+        result = "usage";
+        return false;
+    }
+    VDialer::Progress p = dialer_->progress();
+    result = "targets=" + std::to_string(p.targets);
+    result += " attempted=" + std::to_string(p.attempted);
+    result += " finished=" + std::to_string(p.finished);
+    result += " answered=" + std::to_string(p.answered);
+    result += " in_flight=" + std::to_string(p.in_flight);
+    result += " cps=" + std::to_string(p.rate_cps);
+    result += p.paused ? " paused=1" : " paused=0";
+    result += p.done ? " done=1" : " done=0";
+    return true;
+}
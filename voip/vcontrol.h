@@ -0,0 +1,121 @@
+#ifndef _VCONTROL_H_
+#define _VCONTROL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace voip {
+
+class VAccount;
+class VConfig;
+class VDialer;
+class VEventLoop;
+
+// 本地控制接口: Unix 域流套接字 (control.socket), 供编排脚本批量操作呼叫
+// 协议为文本行, 请求可以连续发送不等回复 (流水线), 回复按请求顺序返回:
+//   请求  <tag> <op> [参数...]\n
+//   回复  <tag> ok [结果...]\n  或  <tag> err <原因>\n
+// tag 为调用方自选的不含空白的串, 原样带回, 用于对应请求
+//   call <uri>                发起呼叫               -> ok <call_id>
+//   hangup <call_id>|all                             -> ok
+//   list                                             -> ok <n> <id>,<state>,<ai|local>,<remote> ...
+//   play <call_id> <wav>      向对端播放提示音        -> ok
+//   ai <call_id> [on|off]     打开 / 关闭 AI, 缺省 on -> ok
+//   stats [<call_id>]         全局或单路统计          -> ok key=value ...
+//   campaign [pause|resume]   外呼活动进度 / 暂停      -> ok key=value ...
+// 所有操作在主线程的事件循环上执行, 一次读到的请求全部处理完后合并成一次写
+// 单行超过 4 KiB 时回 "- err line_too_long" 并断开; 待发送超过 4 MiB 时暂停读取该连接
+class VControl
+{
+public:
+    VControl(VEventLoop &loop, VAccount &acc);
+    ~VControl();
+
+    // control.socket 为空时不启用, 返回 true; 监听失败返回 false
+    bool
+    start(const VConfig &cfg);
+
+    void
+    stop();
+
+    // 外呼活动, 未启用时 campaign 请求回 err no_campaign
+    void
+    setDialer(VDialer *dialer);
+
+private:
+    struct Connection
+    {
+        int fd = -1;
+        uint32_t events = 0;  // 当前在事件循环上关注的事件
+        std::string in;
+        std::string out;
+        size_t out_pos = 0;   // out 中已写出的字节
+        bool paused = false;  // 待发送过多, 暂停处理请求
+        bool eof = false;     // 对端已关闭写端, 处理完已收到的请求、发完回复后断开
+    };
+
+    void
+    onAccept();
+
+    void
+    onEvents(int fd, uint32_t events);
+
+    // 先处理缓冲中的完整行, 再读到 EAGAIN / EOF; 返回 false 表示连接出错
+    bool
+    readRequests(Connection &conn);
+
+    // 处理 in 中的完整行, 待发送超过上限时暂停
+    void
+    processLines(Connection &conn);
+
+    // 尽量写出, 返回 false 表示连接出错
+    bool
+    flush(Connection &conn);
+
+    void
+    updateEvents(Connection &conn);
+
+    void
+    close(int fd);
+
+    // 处理一行请求, 回复追加到 out
+    void
+    handle(const std::string &line, std::string &out);
+
+    // 各操作: 成功返回 true, result 为 ok / err 之后的内容
+    bool
+    opCall(const std::string &args, std::string &result);
+
+    bool
+    opHangup(const std::string &args, std::string &result);
+
+    bool
+    opList(std::string &result);
+
+    bool
+    opPlay(const std::string &args, std::string &result);
+
+    bool
+    opAi(const std::string &args, std::string &result);
+
+    bool
+    opStats(const std::string &args, std::string &result);
+
+    bool
+    opCampaign(const std::string &args, std::string &result);
+
+    VEventLoop &loop_;
+    VAccount &acc_;
+    VDialer *dialer_ = nullptr;
+    std::string path_;
+    int listen_fd_ = -1;
+    size_t max_connections_ = 16;
+    std::map<int, std::unique_ptr<Connection>> connections_;
+};
+
+} // namespace voip
+
+#endif // _VCONTROL_H_
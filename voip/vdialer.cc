@@ -0,0 +1,263 @@
+#include "vdialer.h"
+#include "vaccount.h"
+#include "vcall.h"
+#include "vconfig.h"
+#include "veventloop.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VCounter &attempts = metrics.counter("voip_dialer_attempts_total", "Outbound campaign calls placed");
+voip::VCounter &result_answered = metrics.counter("voip_dialer_results_total", "Outbound campaign call results", "result=\"answered\"");
+voip::VCounter &result_busy = metrics.counter("voip_dialer_results_total", "Outbound campaign call results", "result=\"busy\"");
+voip::VCounter &result_congestion = metrics.counter("voip_dialer_results_total", "Outbound campaign call results", "result=\"congestion\"");
+voip::VCounter &result_failed = metrics.counter("voip_dialer_results_total", "Outbound campaign call results", "result=\"failed\"");
+voip::VCounter &backoffs = metrics.counter("voip_dialer_backoffs_total", "Outbound campaign rate reductions after busy / overload responses");
+voip::VGauge &in_flight_calls = metrics.gauge("voip_dialer_in_flight_calls", "Outbound campaign calls placed and not yet ended");
+voip::VGauge &pace = metrics.gauge("voip_dialer_pace_per_minute", "Current outbound campaign call rate");
+voip::VHistogram &setup_latency = metrics.histogram("voip_dialer_setup_seconds", "Outbound campaign time from INVITE to answer");
+
+const std::chrono::seconds REPORT_INTERVAL(10);
+
+std::string
+trim(const std::string &line)
+{
+    size_t begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = line.find_last_not_of(" \t\r");
+    return line.substr(begin, end - begin + 1);
+}
+
+} // namespace
+
+voip::VDialer::VDialer(VEventLoop &loop, VAccount &acc) :
+    loop_(loop),
+    acc_(acc)
+{
+}
+
+voip::VDialer::~VDialer()
+{
+    // 退出时挂断的呼叫也记入日志
+    collect();
+    in_flight_calls.set(0);
+}
+
+bool voip::VDialer::start(const VConfig &cfg)
+{
+    std::string path = cfg.getString("dialer.targets", "");
+    if (path.empty()) {
+        return true;
+    }
+    domain_ = cfg.getString("dialer.domain", "");
+    cps_ = std::max(0.01, cfg.getDouble("dialer.cps", 10));
+    min_cps_ = std::min(cps_, std::max(0.01, cfg.getDouble("dialer.min_cps", 0.5)));
+    rate_ = cps_;
+    max_concurrent_ = static_cast<size_t>(std::max(1L, cfg.getInt("dialer.max_concurrent", 50)));
+    backoff_factor_ = std::min(1.0, std::max(0.05, cfg.getDouble("dialer.backoff_factor", 0.5)));
+    recover_pct_ = std::max(0.0, cfg.getDouble("dialer.recover_pct", 10));
+    hold_ = std::chrono::milliseconds(std::max(0L, cfg.getInt("dialer.hold_ms", 2000)));
+    tick_ = std::chrono::milliseconds(std::max(1L, cfg.getInt("dialer.tick_ms", 20)));
+
+    std::stringstream codes(cfg.getString("dialer.backoff_codes", "503,486"));
+    std::string code;
+    while (std::getline(codes, code, ',')) {
+        code = trim(code);
+        if (!code.empty()) {
+            backoff_codes_.insert(std::atoi(code.c_str()));
+        }
+    }
+
+    std::ifstream in(path);
+    if (!in) {
+        VLOG_ERROR << ">>> dialer: cannot read targets " << path;
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        line = trim(line);
+        if (!line.empty() && line[0] != '#') {
+            targets_.push_back(toUri(line));
+        }
+    }
+    started_at_.resize(targets_.size());
+
+    std::string log_path = cfg.getString("dialer.log", "dialer.csv");
+    log_.open(log_path, std::ios::app);
+    if (!log_) {
+        VLOG_ERROR << ">>> dialer: cannot open " << log_path;
+        return false;
+    }
+    if (log_.tellp() == 0) {
+        log_ << "attempt,uri,call_id,start_ms,status,answered,setup_ms,duration_ms\n";
+    }
+
+    begin_ = std::chrono::steady_clock::now();
+    last_tick_ = begin_;
+    last_report_ = begin_;
+    last_backoff_ = begin_ - hold_;
+    running_ = true;
+    pace.set(static_cast<int64_t>(rate_ * 60));
+    // 首个 tick 即可发起第一批, 令牌从一个开始
+    tokens_ = 1;
+    loop_.addTimer(tick_, [this]() { tick(); });
+    VLOG_INFO << ">>> dialer: " << targets_.size() << " targets from " << path << ", " << cps_ << " calls/s, at most "
+              << max_concurrent_ << " concurrent, results to " << log_path;
+    return true;
+}
+
+void voip::VDialer::pause(bool paused)
+{
+    if (paused_ != paused) {
+        VLOG_INFO << ">>> dialer " << (paused ? "paused" : "resumed") << " at " << next_ << "/" << targets_.size();
+    }
+    paused_ = paused;
+}
+
+voip::VDialer::Progress voip::VDialer::progress()
+{
+    Progress p;
+    p.targets = targets_.size();
+    p.attempted = next_;
+    p.finished = finished_count_;
+    p.answered = answered_count_;
+    p.in_flight = in_flight_;
+    p.rate_cps = rate_;
+    p.paused = paused_;
+    p.done = !running_ && !targets_.empty();
+    return p;
+}
+
+void voip::VDialer::tick()
+{
+    if (!running_) {
+        return;
+    }
+    collect();
+
+    auto now = std::chrono::steady_clock::now();
+    double dt = std::chrono::duration<double>(now - last_tick_).count();
+    last_tick_ = now;
+
+    // 降速后保持 hold_ms, 之后线性回升
+    if (rate_ < cps_ && now - last_backoff_ >= hold_) {
+        rate_ = std::min(cps_, rate_ + cps_ * recover_pct_ / 100 * dt);
+        pace.set(static_cast<int64_t>(rate_ * 60));
+    }
+
+    // 桶深为一个 tick 的量 (至少一个), 暂停或并发满时不攒突发
+    double depth = std::max(1.0, rate_ * std::chrono::duration<double>(tick_).count());
+    tokens_ = std::min(depth, tokens_ + rate_ * dt);
+    while (!paused_ && tokens_ >= 1 && in_flight_ < max_concurrent_ && next_ < targets_.size()) {
+        tokens_ -= 1;
+        dial(next_++);
+    }
+
+    if (next_ == targets_.size() && in_flight_ == 0) {
+        running_ = false;
+        log_.flush();
+        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - begin_).count();
+        VLOG_INFO << ">>> dialer finished: " << finished_count_ << " attempts, " << answered_count_ << " answered in "
+                  << elapsed << " s";
+        return;
+    }
+    if (now - last_report_ >= REPORT_INTERVAL) {
+        last_report_ = now;
+        log_.flush();
+        VLOG_INFO << ">>> dialer: " << next_ << "/" << targets_.size() << " placed, " << in_flight_ << " in flight, "
+                  << answered_count_ << " answered, " << rate_ << " calls/s";
+    }
+}
+
+void voip::VDialer::dial(size_t attempt)
+{
+    started_at_[attempt] = std::chrono::steady_clock::now();
+    attempts.inc();
+    ++in_flight_;
+    in_flight_calls.inc();
+    // 回调在 pjsua 线程, 只把结果交回, 统计和调速在 tick 里做
+    VCall *call = acc_.makeCall(targets_[attempt], [this, attempt](const VCallOutcome &outcome) {
+        Finished result;
+        result.attempt = attempt;
+        result.call_id = outcome.call_id;
+        result.status = outcome.status;
+        result.answered = outcome.answered;
+        result.setup_ms = static_cast<uint32_t>(outcome.setup.count());
+        result.duration_ms = static_cast<uint32_t>(outcome.duration.count());
+        std::lock_guard<std::mutex> lock(finished_mutex_);
+        finished_.push_back(result);
+    });
+    if (!call) {
+        // 本地即失败 (URI 非法、无传输等), 状态码记 0
+        Finished result {attempt, -1, 0, false, 0, 0};
+        std::lock_guard<std::mutex> lock(finished_mutex_);
+        finished_.push_back(result);
+    }
+}
+
+void voip::VDialer::collect()
+{
+    std::vector<Finished> results;
+    {
+        std::lock_guard<std::mutex> lock(finished_mutex_);
+        results.swap(finished_);
+    }
+    auto now = std::chrono::steady_clock::now();
+    for (const Finished &result : results) {
+        record(result);
+        --in_flight_;
+        in_flight_calls.dec();
+        ++finished_count_;
+
+        if (result.answered) {
+            ++answered_count_;
+            result_answered.inc();
+            setup_latency.observeUs(static_cast<uint64_t>(result.setup_ms) * 1000);
+        }
+        else if (result.status == 486 || result.status == 600) {
+            result_busy.inc();
+        }
+        else if (result.status == 503) {
+            result_congestion.inc();
+        }
+        else {
+            result_failed.inc();
+        }
+
+        // 同一批拒绝多半是同一次过载, hold_ms 内只降一次
+        if (!result.answered && backoff_codes_.count(result.status) && now - last_backoff_ >= hold_) {
+            last_backoff_ = now;
+            double before = rate_;
+            rate_ = std::max(min_cps_, rate_ * backoff_factor_);
+            tokens_ = std::min(tokens_, 1.0);
+            backoffs.inc();
+            pace.set(static_cast<int64_t>(rate_ * 60));
+            VLOG_WARN << ">>> dialer: " << result.status << " from trunk, rate " << before << " -> " << rate_ << " calls/s";
+        }
+    }
+}
+
+void voip::VDialer::record(const Finished &result)
+{
+    auto start_ms = std::chrono::duration_cast<std::chrono::milliseconds>(started_at_[result.attempt] - begin_).count();
+    log_ << result.attempt << ',' << targets_[result.attempt] << ',' << result.call_id << ',' << start_ms << ','
+         << result.status << ',' << (result.answered ? 1 : 0) << ',' << result.setup_ms << ',' << result.duration_ms
+         << '\n';
+}
+
+std::string voip::VDialer::toUri(const std::string &line) const
+{
+    if (line.compare(0, 4, "sip:") == 0 || line.compare(0, 5, "sips:") == 0) {
+        return line;
+    }
+    return domain_.empty() ? "sip:" + line : "sip:" + line + "@" + domain_;
+}
@@ -0,0 +1,121 @@
+#ifndef _VDIALER_H_
+#define _VDIALER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace voip {
+
+class VAccount;
+class VConfig;
+class VEventLoop;
+struct VCallOutcome;
+
+// 外呼活动 (dialer.*): 从 dialer.targets 逐行读取号码, 按速率和并发上限在事件循环上发起呼叫
+// 速率用令牌桶控制, 每 dialer.tick_ms 按经过的时间补充令牌, 桶深一个 tick 的量, 不攒突发
+// 对端回 dialer.backoff_codes (缺省 503, 486) 时速率乘以 backoff_factor,
+// 一个 hold_ms 内只降一次; 之后每秒回升 dialer.cps 的 recover_pct, 直到配置的速率
+// 每次尝试的结果 (状态码、建立时延、通话时长) 追加到 dialer.log (CSV)
+class VDialer
+{
+public:
+    // 活动进度, 供状态日志和控制接口
+    struct Progress
+    {
+        size_t targets = 0;
+        size_t attempted = 0;
+        size_t finished = 0;
+        size_t answered = 0;
+        size_t in_flight = 0;
+        double rate_cps = 0;
+        bool paused = false;
+        bool done = false;
+    };
+
+    VDialer(VEventLoop &loop, VAccount &acc);
+    ~VDialer();
+
+    // dialer.targets 未配置时不启用, 返回 true; 号码文件或日志打不开时返回 false
+    bool
+    start(const VConfig &cfg);
+
+    // 不再发起新呼叫, 已发起的呼叫照常结束并记录
+    void
+    pause(bool paused);
+
+    Progress
+    progress();
+
+private:
+    // 呼叫断开时由 pjsua 线程交回的结果
+    struct Finished
+    {
+        size_t attempt;
+        int call_id;
+        int status;
+        bool answered;
+        uint32_t setup_ms;
+        uint32_t duration_ms;
+    };
+
+    // 事件循环上每 tick_ms 调用
+    void
+    tick();
+
+    void
+    dial(size_t attempt);
+
+    // 事件循环上处理 pjsua 线程交回的结果: 写日志, 按状态码调速
+    void
+    collect();
+
+    void
+    record(const Finished &result);
+
+    // 号码补全为 URI: 不以 sip: / sips: 开头时拼上 dialer.domain
+    std::string
+    toUri(const std::string &line) const;
+
+    VEventLoop &loop_;
+    VAccount &acc_;
+
+    std::vector<std::string> targets_; // 已补全的 URI
+    std::string domain_;
+    size_t next_ = 0;
+    std::vector<std::chrono::steady_clock::time_point> started_at_; // 按尝试序号
+
+    double cps_ = 10;          // 配置的速率上限
+    double min_cps_ = 0.5;
+    double rate_ = 10;         // 当前速率
+    double backoff_factor_ = 0.5;
+    double recover_pct_ = 10;
+    std::chrono::milliseconds hold_ {2000};
+    std::chrono::milliseconds tick_ {20};
+    std::set<int> backoff_codes_;
+    size_t max_concurrent_ = 50;
+    double tokens_ = 0;
+    std::chrono::steady_clock::time_point last_tick_;
+    std::chrono::steady_clock::time_point last_backoff_;
+    std::chrono::steady_clock::time_point begin_;
+
+    size_t in_flight_ = 0;
+    size_t finished_count_ = 0;
+    size_t answered_count_ = 0;
+    bool paused_ = false;
+    bool running_ = false; // 号码未拨完或还有呼叫未结束
+    std::chrono::steady_clock::time_point last_report_;
+
+    std::mutex finished_mutex_;
+    std::vector<Finished> finished_;
+
+    std::ofstream log_;
+};
+
+} // namespace voip
+
+#endif // _VDIALER_H_
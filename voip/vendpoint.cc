@@ -0,0 +1,153 @@
+#include "vendpoint.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+namespace {
+
+const char *
+stateName(pjsip_transport_state state)
+{
+    switch (state) {
+    case PJSIP_TP_STATE_CONNECTED:
+        return "connected";
+    case PJSIP_TP_STATE_DISCONNECTED:
+        return "disconnected";
+    default:
+        return "other";
+    }
+}
+
+const char *
+transportName(pjsip_transport_type_e type)
+{
+    switch (type) {
+    case PJSIP_TRANSPORT_TCP:
+        return "tcp";
+    case PJSIP_TRANSPORT_TLS:
+        return "tls";
+    default:
+        return "udp";
+    }
+}
+
+} // namespace
+
+voip::VEndpoint::VEndpoint()
+{
+}
+
+voip::VEndpoint::~VEndpoint()
+{
+}
+
+void voip::VEndpoint::createTransports(const VConfig &cfg)
+{
+    // 连接复用: 请求 Via 带 alias (RFC 5923), 对端可沿同一条 TCP/TLS 连接回送请求, 不再反向建连
+    pjsip_cfg_t *sip_cfg = pjsip_cfg();
+    bool reuse = cfg.getBool("sip.reuse", true);
+    sip_cfg->endpt.req_has_via_alias = reuse ? PJ_TRUE : PJ_FALSE;
+    sip_cfg->tcp.keep_alive_interval = cfg.getInt("sip.tcp.keepalive_sec", 90);
+    sip_cfg->tls.keep_alive_interval = cfg.getInt("sip.tls.keepalive_sec", 90);
+
+    std::string bound_address = cfg.getString("sip.bind_address");
+
+    if (cfg.getBool("sip.udp.enabled", true)) {
+        pj::TransportConfig tcfg;
+        tcfg.port = cfg.getInt("sip.udp.port", 5060);
+        tcfg.boundAddress = bound_address;
+        udp_id_ = transportCreate(PJSIP_TRANSPORT_UDP, tcfg);
+    }
+
+    if (cfg.getBool("sip.tcp.enabled", false)) {
+        pj::TransportConfig tcfg;
+        tcfg.port = cfg.getInt("sip.tcp.port", 5060);
+        tcfg.boundAddress = bound_address;
+        tcp_id_ = transportCreate(PJSIP_TRANSPORT_TCP, tcfg);
+    }
+
+    if (cfg.getBool("sip.tls.enabled", false)) {
+        pj::TransportConfig tcfg;
+        tcfg.port = cfg.getInt("sip.tls.port", 5061);
+        tcfg.boundAddress = bound_address;
+        tcfg.tlsConfig.CaListFile = cfg.getString("sip.tls.ca_file");
+        tcfg.tlsConfig.certFile = cfg.getString("sip.tls.cert_file");
+        tcfg.tlsConfig.privKeyFile = cfg.getString("sip.tls.key_file");
+        tcfg.tlsConfig.password = cfg.getString("sip.tls.password");
+        tcfg.tlsConfig.verifyServer = cfg.getBool("sip.tls.verify_server", false);
+        tls_id_ = transportCreate(PJSIP_TRANSPORT_TLS, tcfg);
+    }
+
+    for (pj::TransportId id : {udp_id_, tcp_id_, tls_id_}) {
+        if (id != PJSUA_INVALID_ID) {
+            pj::TransportInfo ti = transportGetInfo(id);
+            VLOG_INFO << ">>> SIP transport " << ti.typeName << " listening on " << ti.localName;
+        }
+    }
+
+    std::string want = cfg.getString("sip.transport", "udp");
+    if (want == "tcp" && tcp_id_ != PJSUA_INVALID_ID) {
+        sip_type_ = PJSIP_TRANSPORT_TCP;
+    }
+    else if (want == "tls" && tls_id_ != PJSUA_INVALID_ID) {
+        sip_type_ = PJSIP_TRANSPORT_TLS;
+    }
+    else {
+        if (want != "udp") {
+            VLOG_WARN << ">>> sip.transport=" << want << " is not enabled, falling back to udp";
+        }
+        sip_type_ = PJSIP_TRANSPORT_UDP;
+    }
+    VLOG_INFO << ">>> account transport: " << transportName(sip_type_)
+              << ", connection reuse " << (reuse ? "on" : "off");
+}
+
+pj::TransportId voip::VEndpoint::sipTransportId() const
+{
+    switch (sip_type_) {
+    case PJSIP_TRANSPORT_TCP:
+        return tcp_id_;
+    case PJSIP_TRANSPORT_TLS:
+        return tls_id_;
+    default:
+        return udp_id_;
+    }
+}
+
+std::string voip::VEndpoint::uriTransportParam() const
+{
+    if (sip_type_ == PJSIP_TRANSPORT_UDP) {
+        return "";
+    }
+    return std::string(";transport=") + transportName(sip_type_);
+}
+
+void voip::VEndpoint::onTransportState(const pj::OnTransportStateParam &prm)
+{
+    VMetrics &metrics = VMetrics::instance();
+    std::string type_label = "type=\"" + prm.type + "\"";
+
+    // 传输状态变化频率低, 按需查找指标即可
+    metrics.counter("voip_sip_transport_events_total", "Connection-oriented SIP transport state changes",
+                    type_label + ",state=\"" + stateName(prm.state) + "\"")
+        .inc();
+
+    VGauge &open = metrics.gauge("voip_sip_transport_connections", "Open connection-oriented SIP transports", type_label);
+    {
+        // 建连或 TLS 握手失败同样报告 DISCONNECTED, 这些传输从未计入
+        std::lock_guard<std::mutex> lock(transports_mutex_);
+        if (prm.state == PJSIP_TP_STATE_CONNECTED) {
+            if (connected_.insert(prm.hnd).second) {
+                open.inc();
+            }
+        }
+        else if (prm.state == PJSIP_TP_STATE_DISCONNECTED || prm.state == PJSIP_TP_STATE_DESTROY) {
+            if (connected_.erase(prm.hnd) > 0) {
+                open.dec();
+            }
+        }
+    }
+
+    VLOG_DEBUG << ">>> transport " << prm.type << " " << stateName(prm.state)
+               << (prm.lastError != PJ_SUCCESS ? " (error " + std::to_string(prm.lastError) + ")" : "");
+}
@@ -0,0 +1,48 @@
+#ifndef _VENDPOINT_H_
+#define _VENDPOINT_H_
+
+#include <pjsua2.hpp>
+
+#include <mutex>
+#include <set>
+
+namespace voip {
+
+class VConfig;
+
+class VEndpoint : public pj::Endpoint
+{
+public:
+    VEndpoint();
+    ~VEndpoint();
+
+    // 按配置创建 UDP/TCP/TLS 传输, 并设置连接复用与保活; 需在 libInit 之后调用
+    void
+    createTransports(const VConfig &cfg);
+
+    // 账号绑定的传输 (sip.transport), 未创建时为 PJSUA_INVALID_ID
+    pj::TransportId
+    sipTransportId() const;
+
+    // 注册/呼叫 URI 需要追加的 ;transport= 参数, UDP 时为空
+    std::string
+    uriTransportParam() const;
+
+    // 面向连接的传输状态 (建立/断开), 计入 per-transport 统计
+    virtual void
+    onTransportState(const pj::OnTransportStateParam &prm) override;
+
+private:
+    pj::TransportId udp_id_ = PJSUA_INVALID_ID;
+    pj::TransportId tcp_id_ = PJSUA_INVALID_ID;
+    pj::TransportId tls_id_ = PJSUA_INVALID_ID;
+    pjsip_transport_type_e sip_type_ = PJSIP_TRANSPORT_UDP;
+
+    // 报告过 CONNECTED 的传输, 只有它们断开时才减少连接数
+    std::mutex transports_mutex_;
+    std::set<pj::TransportHandle> connected_;
+};
+
+} // namespace voip
+
+#endif // _VENDPOINT_H_
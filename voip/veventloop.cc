@@ -0,0 +1,173 @@
+#include "veventloop.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace {
+
+const int MAX_EVENTS = 64;
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VHistogram &dispatch_latency = metrics.histogram("voip_event_loop_dispatch_seconds", "Time spent in one event loop handler");
+voip::VCounter &timer_overruns = metrics.counter("voip_event_loop_timer_overruns_total", "Periodic event loop tasks skipped because the loop was busy");
+
+} // namespace
+
+voip::VEventLoop::VEventLoop()
+{
+    running_ = true;
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    add(wake_fd_, EPOLLIN, [this](uint32_t) {
+        uint64_t v;
+        ssize_t n = read(wake_fd_, &v, sizeof(v));
+        (void)n;
+    });
+}
+
+voip::VEventLoop::~VEventLoop()
+{
+    for (int fd : owned_fds_) {
+        close(fd);
+    }
+    close(wake_fd_);
+    close(epoll_fd_);
+}
+
+void voip::VEventLoop::blockSignals(const std::vector<int> &signals)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (int sig : signals) {
+        sigaddset(&mask, sig);
+    }
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+}
+
+bool voip::VEventLoop::add(int fd, uint32_t events, Handler handler)
+{
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        VLOG_DEBUG << ">>> event loop: cannot watch fd " << fd << ": " << std::strerror(errno);
+        return false;
+    }
+    handlers_[fd] = std::make_shared<Handler>(std::move(handler));
+    return true;
+}
+
+bool voip::VEventLoop::modify(int fd, uint32_t events)
+{
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void voip::VEventLoop::remove(int fd)
+{
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    handlers_.erase(fd);
+}
+
+bool voip::VEventLoop::addTimer(std::chrono::milliseconds period, std::function<void()> fn)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    itimerspec spec;
+    std::memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_sec = period.count() / 1000;
+    spec.it_interval.tv_nsec = (period.count() % 1000) * 1000000;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(fd, 0, &spec, nullptr);
+
+    bool ok = add(fd, EPOLLIN, [fd, fn](uint32_t) {
+        uint64_t expirations = 0;
+        if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            return;
+        }
+        // 错过的周期不补跑
+        if (expirations > 1) {
+            timer_overruns.inc(expirations - 1);
+        }
+        fn();
+    });
+    if (!ok) {
+        close(fd);
+        return false;
+    }
+    owned_fds_.push_back(fd);
+    return true;
+}
+
+bool voip::VEventLoop::addSignals(const std::vector<int> &signals, std::function<void(int)> fn)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    for (int sig : signals) {
+        sigaddset(&mask, sig);
+    }
+    int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = add(fd, EPOLLIN, [fd, fn](uint32_t) {
+        signalfd_siginfo info;
+        while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+            fn(static_cast<int>(info.ssi_signo));
+        }
+    });
+    if (!ok) {
+        close(fd);
+        return false;
+    }
+    owned_fds_.push_back(fd);
+    return true;
+}
+
+void voip::VEventLoop::run()
+{
+    epoll_event events[MAX_EVENTS];
+    while (running_) {
+        int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            VLOG_ERROR << ">>> event loop: epoll_wait failed: " << std::strerror(errno);
+            break;
+        }
+        for (int i = 0; i < n && running_; ++i) {
+            auto it = handlers_.find(events[i].data.fd);
+            if (it == handlers_.end()) {
+                continue;
+            }
+            std::shared_ptr<Handler> handler = it->second;
+            VScopedLatency latency(dispatch_latency);
+            (*handler)(events[i].events);
+        }
+    }
+}
+
+void voip::VEventLoop::stop()
+{
+    running_ = false;
+    uint64_t one = 1;
+    ssize_t n = write(wake_fd_, &one, sizeof(one));
+    (void)n;
+}
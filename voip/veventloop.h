@@ -0,0 +1,70 @@
+#ifndef _VEVENTLOOP_H_
+#define _VEVENTLOOP_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace voip {
+
+// 主线程的事件循环 (epoll)
+// 标准输入、控制连接等 fd, 周期任务 (timerfd) 和退出信号 (signalfd) 都在这一个线程上分发,
+// 定时任务不再依赖操作员输入才能执行; 处理函数不应阻塞
+// 主线程即 libCreate 的线程, 处理函数里可以直接调用 pjsua2
+class VEventLoop
+{
+public:
+    // events 为 epoll 事件位
+    using Handler = std::function<void(uint32_t events)>;
+
+    VEventLoop();
+    ~VEventLoop();
+
+    // 在创建任何线程之前调用: 之后创建的线程继承屏蔽, 这些信号只经 addSignals 的 signalfd 送达
+    static void
+    blockSignals(const std::vector<int> &signals);
+
+    // fd 不支持 epoll (普通文件等) 时返回 false
+    bool
+    add(int fd, uint32_t events, Handler handler);
+
+    bool
+    modify(int fd, uint32_t events);
+
+    // 分发中途移除也安全, 本轮尚未分发的事件被丢弃; 不关闭 fd
+    void
+    remove(int fd);
+
+    // 周期任务, 首次在一个周期后执行
+    bool
+    addTimer(std::chrono::milliseconds period, std::function<void()> fn);
+
+    // signals 须已由 blockSignals 屏蔽
+    bool
+    addSignals(const std::vector<int> &signals, std::function<void(int)> fn);
+
+    // 阻塞到 stop(), 只能运行一次
+    void
+    run();
+
+    // 任意线程可调用
+    void
+    stop();
+
+private:
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> running_ {false};
+    // 处理函数按 shared_ptr 取出后调用, 处理中 remove 自身不会销毁正在执行的函数
+    std::map<int, std::shared_ptr<Handler>> handlers_;
+    // 循环自建的 timerfd / signalfd, 析构时关闭
+    std::vector<int> owned_fds_;
+};
+
+} // namespace voip
+
+#endif // _VEVENTLOOP_H_
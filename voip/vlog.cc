@@ -0,0 +1,347 @@
+#include "vlog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t LOG_LINE_BYTES = 240;
+const size_t LOG_RING_SLOTS = 256;
+const int LOG_FLUSH_INTERVAL_MS = 20;
+
+struct LogRecord
+{
+    uint64_t ts_ns;
+    int level;
+    unsigned len;
+    char text[LOG_LINE_BYTES];
+};
+
+// 单生产者 (所属线程) / 单消费者 (刷新线程) 环形缓冲区
+struct LogRing
+{
+    LogRecord slots[LOG_RING_SLOTS];
+    std::atomic<size_t> head {0};
+    std::atomic<size_t> tail {0};
+
+    bool
+    push(int level, uint64_t ts_ns, const char *msg, size_t len)
+    {
+        size_t tail_pos = tail.load(std::memory_order_relaxed);
+        if (tail_pos - head.load(std::memory_order_acquire) >= LOG_RING_SLOTS) {
+            return false;
+        }
+        LogRecord &rec = slots[tail_pos % LOG_RING_SLOTS];
+        rec.ts_ns = ts_ns;
+        rec.level = level;
+        rec.len = static_cast<unsigned>(std::min(len, LOG_LINE_BYTES));
+        std::memcpy(rec.text, msg, rec.len);
+        tail.store(tail_pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool
+    pop(LogRecord &out)
+    {
+        size_t head_pos = head.load(std::memory_order_relaxed);
+        if (head_pos == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        const LogRecord &rec = slots[head_pos % LOG_RING_SLOTS];
+        out.ts_ns = rec.ts_ns;
+        out.level = rec.level;
+        out.len = rec.len;
+        std::memcpy(out.text, rec.text, rec.len);
+        head.store(head_pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool
+    empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
+
+// 定长格式化缓冲区, 超长部分截断
+class LineBuf : public std::streambuf
+{
+public:
+    LineBuf()
+    {
+        reset();
+    }
+
+    void
+    reset()
+    {
+        setp(buf_, buf_ + sizeof(buf_));
+    }
+
+    const char *
+    data() const
+    {
+        return pbase();
+    }
+
+    size_t
+    size() const
+    {
+        return pptr() - pbase();
+    }
+
+private:
+    char buf_[LOG_LINE_BYTES];
+};
+
+struct ThreadState
+{
+    LineBuf buf;
+    std::ostream os {&buf};
+    std::shared_ptr<LogRing> ring;
+};
+
+thread_local ThreadState tls;
+
+struct Sink
+{
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<LogRing>> rings;
+
+    std::atomic<int> level {VLOG_LEVEL_INFO};
+    std::atomic<bool> running {false};
+    std::atomic<unsigned long> dropped {0};
+    std::thread flusher;
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+};
+
+Sink &
+sink()
+{
+    static Sink s;
+    return s;
+}
+
+uint64_t
+nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+void
+formatRecord(std::string &out, const LogRecord &rec)
+{
+    static const char LEVEL_CHARS[] = "TDIWE";
+
+    time_t sec = static_cast<time_t>(rec.ts_ns / 1000000000ull);
+    unsigned msec = static_cast<unsigned>(rec.ts_ns / 1000000ull % 1000);
+    struct tm tm_buf;
+    localtime_r(&sec, &tm_buf);
+
+    char prefix[32];
+    int n = std::snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%03u %c ",
+                          tm_buf.tm_hour, tm_buf.tm_min, tm_buf.tm_sec, msec,
+                          LEVEL_CHARS[std::min(rec.level, VLOG_LEVEL_ERROR)]);
+    out.append(prefix, n);
+    out.append(rec.text, rec.len);
+    out.push_back('\n');
+}
+
+void
+writeOut(const std::string &out, const std::string &err)
+{
+    if (!out.empty()) {
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);
+    }
+    if (!err.empty()) {
+        std::fwrite(err.data(), 1, err.size(), stderr);
+    }
+}
+
+// 取出所有线程缓冲区内容, 按时间排序后一次写出; 已退出线程的空缓冲区在此回收
+void
+drain(std::vector<LogRecord> &batch)
+{
+    Sink &s = sink();
+    {
+        std::lock_guard<std::mutex> lock(s.rings_mutex);
+        LogRecord rec;
+        for (auto it = s.rings.begin(); it != s.rings.end();) {
+            while ((*it)->pop(rec)) {
+                batch.push_back(rec);
+            }
+            if (it->use_count() == 1 && (*it)->empty()) {
+                it = s.rings.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    if (batch.empty()) {
+        return;
+    }
+
+    std::stable_sort(batch.begin(), batch.end(), [](const LogRecord &a, const LogRecord &b) {
+        return a.ts_ns < b.ts_ns;
+    });
+
+    std::string out, err;
+    for (const LogRecord &rec : batch) {
+        formatRecord(rec.level >= VLOG_LEVEL_WARN ? err : out, rec);
+    }
+    writeOut(out, err);
+    batch.clear();
+}
+
+void
+flusherLoop()
+{
+    Sink &s = sink();
+    std::vector<LogRecord> batch;
+    batch.reserve(LOG_RING_SLOTS);
+    while (s.running.load()) {
+        {
+            std::unique_lock<std::mutex> lock(s.wake_mutex);
+            s.wake_cv.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+        }
+        drain(batch);
+    }
+    drain(batch);
+}
+
+LogRing &
+threadRing()
+{
+    if (!tls.ring) {
+        tls.ring = std::make_shared<LogRing>();
+        Sink &s = sink();
+        std::lock_guard<std::mutex> lock(s.rings_mutex);
+        s.rings.push_back(tls.ring);
+    }
+    return *tls.ring;
+}
+
+} // namespace
+
+void voip::VLog::start(int level)
+{
+    Sink &s = sink();
+    s.level = level;
+    if (s.running.exchange(true)) {
+        return;
+    }
+    s.flusher = std::thread(flusherLoop);
+}
+
+void voip::VLog::stop()
+{
+    Sink &s = sink();
+    if (!s.running.exchange(false)) {
+        return;
+    }
+    s.wake_cv.notify_one();
+    if (s.flusher.joinable()) {
+        s.flusher.join();
+    }
+    std::vector<LogRecord> batch;
+    drain(batch);
+}
+
+void voip::VLog::setLevel(int level)
+{
+    sink().level = level;
+}
+
+bool voip::VLog::enabled(int level)
+{
+    return level >= sink().level.load(std::memory_order_relaxed);
+}
+
+void voip::VLog::write(int level, const char *msg, size_t len)
+{
+    Sink &s = sink();
+    uint64_t ts_ns = nowNs();
+
+    if (!s.running.load(std::memory_order_acquire)) {
+        LogRecord rec;
+        rec.ts_ns = ts_ns;
+        rec.level = level;
+        rec.len = static_cast<unsigned>(std::min(len, LOG_LINE_BYTES));
+        std::memcpy(rec.text, msg, rec.len);
+        std::string line;
+        formatRecord(line, rec);
+        writeOut(level >= VLOG_LEVEL_WARN ? std::string() : line,
+                 level >= VLOG_LEVEL_WARN ? line : std::string());
+        return;
+    }
+
+    if (!threadRing().push(level, ts_ns, msg, len)) {
+        s.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+unsigned long voip::VLog::dropped()
+{
+    return sink().dropped.load();
+}
+
+voip::VLogLine::VLogLine(int level) :
+    level_(level)
+{
+    tls.buf.reset();
+    tls.os.clear();
+}
+
+voip::VLogLine::~VLogLine()
+{
+    VLog::write(level_, tls.buf.data(), tls.buf.size());
+}
+
+std::ostream &voip::VLogLine::stream()
+{
+    return tls.os;
+}
+
+void voip::VPjLogWriter::write(const pj::LogEntry &entry)
+{
+    int level;
+    if (entry.level <= 1) {
+        level = VLOG_LEVEL_ERROR;
+    }
+    else if (entry.level == 2) {
+        level = VLOG_LEVEL_WARN;
+    }
+    else if (entry.level == 3) {
+        level = VLOG_LEVEL_INFO;
+    }
+    else if (entry.level == 4) {
+        level = VLOG_LEVEL_DEBUG;
+    }
+    else {
+        level = VLOG_LEVEL_TRACE;
+    }
+    if (!VLog::enabled(level)) {
+        return;
+    }
+
+    size_t len = entry.msg.size();
+    while (len > 0 && (entry.msg[len - 1] == '\n' || entry.msg[len - 1] == '\r')) {
+        --len;
+    }
+    VLog::write(level, entry.msg.data(), len);
+}
@@ -0,0 +1,86 @@
+#ifndef _VLOG_H_
+#define _VLOG_H_
+
+#include <pjsua2.hpp>
+
+#include <ostream>
+
+#define VLOG_LEVEL_TRACE 0
+#define VLOG_LEVEL_DEBUG 1
+#define VLOG_LEVEL_INFO  2
+#define VLOG_LEVEL_WARN  3
+#define VLOG_LEVEL_ERROR 4
+#define VLOG_LEVEL_OFF   5
+
+// 编译期级别, 低于该级别的日志语句整条被消除 (参数表达式也不会求值)
+#ifndef VLOG_ACTIVE_LEVEL
+#define VLOG_ACTIVE_LEVEL VLOG_LEVEL_DEBUG
+#endif
+
+#define VLOG(level)                                                          \
+    if ((level) < VLOG_ACTIVE_LEVEL || !voip::VLog::enabled(level)) {       \
+    }                                                                        \
+    else                                                                     \
+        voip::VLogLine(level).stream()
+
+#define VLOG_TRACE VLOG(VLOG_LEVEL_TRACE)
+#define VLOG_DEBUG VLOG(VLOG_LEVEL_DEBUG)
+#define VLOG_INFO  VLOG(VLOG_LEVEL_INFO)
+#define VLOG_WARN  VLOG(VLOG_LEVEL_WARN)
+#define VLOG_ERROR VLOG(VLOG_LEVEL_ERROR)
+
+namespace voip {
+
+// 异步日志
+// 每个线程写自己的无锁环形缓冲区 (单生产者/单消费者), 后台线程统一刷到 stdout/stderr,
+// 回调线程不再争用 stdout 锁, 也不做阻塞写; 缓冲区满时丢弃并计数
+class VLog
+{
+public:
+    // 启动后台刷新线程, 未启动时日志同步写出
+    static void
+    start(int level = VLOG_LEVEL_INFO);
+
+    // 刷完剩余日志并停止后台线程
+    static void
+    stop();
+
+    static void
+    setLevel(int level);
+
+    static bool
+    enabled(int level);
+
+    static void
+    write(int level, const char *msg, size_t len);
+
+    // 因缓冲区满被丢弃的条数
+    static unsigned long
+    dropped();
+};
+
+// 单条日志, 在当前线程的格式化缓冲区中拼接, 析构时提交
+class VLogLine
+{
+public:
+    explicit VLogLine(int level);
+    ~VLogLine();
+
+    std::ostream &
+    stream();
+
+private:
+    int level_;
+};
+
+// pjlib 日志重定向到 VLog, 交给 EpConfig::logConfig.writer, 由 Endpoint 负责释放
+class VPjLogWriter : public pj::LogWriter
+{
+public:
+    virtual void
+    write(const pj::LogEntry &entry) override;
+};
+
+} // namespace voip
+
+#endif // _VLOG_H_
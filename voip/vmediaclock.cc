@@ -0,0 +1,146 @@
+#include "vmediaclock.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <sched.h>
+
+namespace {
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VCounter &clock_ticks = metrics.counter("voip_media_clock_ticks_total", "Conference bridge ticks driven by the headless media clock");
+voip::VCounter &clock_overruns = metrics.counter("voip_media_clock_overruns_total", "Headless clock ticks that woke up more than one frame late");
+voip::VCounter &clock_skipped = metrics.counter("voip_media_clock_skipped_ticks_total", "Headless clock ticks dropped to resynchronise after a long stall");
+voip::VHistogram &clock_lateness = metrics.histogram("voip_media_clock_lateness_seconds", "Headless clock wake-up time past the tick deadline");
+voip::VHistogram &clock_tick = metrics.histogram("voip_media_clock_tick_seconds", "Time to run one conference bridge tick");
+
+int64_t
+monotonicNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void
+updateMax(std::atomic<uint64_t> &max, uint64_t value)
+{
+    uint64_t cur = max.load(std::memory_order_relaxed);
+    while (value > cur && !max.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+voip::VMediaClock::VMediaClock()
+{
+}
+
+voip::VMediaClock::~VMediaClock()
+{
+    stop();
+}
+
+void voip::VMediaClock::start(pj::MediaPort port, const VConfig &cfg)
+{
+    if (running_) {
+        return;
+    }
+    port_ = static_cast<pjmedia_port *>(port);
+    unsigned rate = PJMEDIA_PIA_SRATE(&port_->info);
+    unsigned spf = PJMEDIA_PIA_SPF(&port_->info);
+    period_ns_ = static_cast<int64_t>(spf) * 1000000000 / rate;
+    max_catchup_ = cfg.getInt("media.clock.max_catchup", 5);
+    rt_priority_ = cfg.getInt("media.clock.rt_priority", 0);
+    buf_.assign(spf, 0);
+
+    running_ = true;
+    worker_ = std::thread(&VMediaClock::run, this);
+    VLOG_INFO << ">>> headless media clock: " << rate << " Hz, " << spf << " samples per tick ("
+              << period_ns_ / 1000 << " us)";
+}
+
+void voip::VMediaClock::stop()
+{
+    if (!running_.exchange(false)) {
+        return;
+    }
+    worker_.join();
+    VMediaClockStats s = stats();
+    VLOG_INFO << ">>> headless media clock stopped: " << s.ticks << " ticks, " << s.overruns << " overruns, "
+              << s.skipped << " skipped, max lateness " << s.max_lateness_us << " us, max tick " << s.max_tick_us << " us";
+}
+
+voip::VMediaClockStats voip::VMediaClock::stats() const
+{
+    VMediaClockStats s;
+    s.ticks = ticks_.load(std::memory_order_relaxed);
+    s.overruns = overruns_.load(std::memory_order_relaxed);
+    s.skipped = skipped_.load(std::memory_order_relaxed);
+    s.max_lateness_us = max_lateness_us_.load(std::memory_order_relaxed);
+    s.max_tick_us = max_tick_us_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void voip::VMediaClock::run()
+{
+    // 会议桥的回调会进入 pjlib, 线程需先注册
+    pj_thread_desc desc;
+    pj_thread_t *thread = nullptr;
+    std::memset(desc, 0, sizeof(desc));
+    pj_thread_register("media_clock", desc, &thread);
+
+    if (rt_priority_ > 0) {
+        sched_param param;
+        param.sched_priority = rt_priority_;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            VLOG_WARN << ">>> media clock: SCHED_FIFO " << rt_priority_ << " not applied: " << std::strerror(err);
+        }
+    }
+
+    pjmedia_frame frame;
+    int64_t deadline = monotonicNs() + period_ns_;
+    while (running_.load(std::memory_order_relaxed)) {
+        timespec ts;
+        ts.tv_sec = deadline / 1000000000;
+        ts.tv_nsec = deadline % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+        }
+
+        int64_t now = monotonicNs();
+        int64_t late = now - deadline;
+        clock_lateness.observeUs(static_cast<uint64_t>(late / 1000));
+        updateMax(max_lateness_us_, static_cast<uint64_t>(late / 1000));
+        if (late > period_ns_) {
+            overruns_.fetch_add(1, std::memory_order_relaxed);
+            clock_overruns.inc();
+            // 停顿太久时不再逐帧补跑, 从当前时刻重新对齐
+            int64_t behind = late / period_ns_;
+            if (behind > static_cast<int64_t>(max_catchup_)) {
+                skipped_.fetch_add(behind, std::memory_order_relaxed);
+                clock_skipped.inc(behind);
+                deadline += behind * period_ns_;
+            }
+        }
+
+        frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+        frame.buf = buf_.data();
+        frame.size = buf_.size() * sizeof(int16_t);
+        frame.timestamp.u64 = 0;
+        frame.bit_info = 0;
+        pjmedia_port_get_frame(port_, &frame);
+
+        int64_t tick_us = (monotonicNs() - now) / 1000;
+        clock_tick.observeUs(static_cast<uint64_t>(tick_us));
+        updateMax(max_tick_us_, static_cast<uint64_t>(tick_us));
+        ticks_.fetch_add(1, std::memory_order_relaxed);
+        clock_ticks.inc();
+        deadline += period_ns_;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef _VMEDIACLOCK_H_
+#define _VMEDIACLOCK_H_
+
+#include <pjsua2.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace voip {
+
+class VConfig;
+
+// 媒体时钟统计
+struct VMediaClockStats
+{
+    uint64_t ticks = 0;
+    uint64_t overruns = 0;        // 醒来时已晚于一整帧
+    uint64_t skipped = 0;         // 积压过多时放弃补跑的帧
+    uint64_t max_lateness_us = 0;
+    uint64_t max_tick_us = 0;     // 单次驱动会议桥的最长耗时
+};
+
+// 无声卡模式下驱动会议桥的专用时钟 (media.headless)
+// setNoDev() 之后会议桥没有时钟源, 由本线程按绝对时刻 (clock_nanosleep TIMER_ABSTIME) 每帧调用一次
+// pjmedia_port_get_frame, 偏差不随调度抖动累积; 醒来晚于一帧时补跑, 积压超过 max_catchup 帧时放弃并重新对齐
+class VMediaClock
+{
+public:
+    VMediaClock();
+    ~VMediaClock();
+
+    // port 为 setNoDev() 返回的会议桥主端口, 帧长和采样率取自端口
+    void
+    start(pj::MediaPort port, const VConfig &cfg);
+
+    // 需在 libDestroy 之前调用
+    void
+    stop();
+
+    VMediaClockStats
+    stats() const;
+
+private:
+    void
+    run();
+
+    pjmedia_port *port_ = nullptr;
+    int64_t period_ns_ = 20000000;
+    unsigned max_catchup_ = 5;
+    int rt_priority_ = 0;
+    std::vector<int16_t> buf_;
+
+    std::atomic<bool> running_ {false};
+    std::thread worker_;
+
+    std::atomic<uint64_t> ticks_ {0};
+    std::atomic<uint64_t> overruns_ {0};
+    std::atomic<uint64_t> skipped_ {0};
+    std::atomic<uint64_t> max_lateness_us_ {0};
+    std::atomic<uint64_t> max_tick_us_ {0};
+};
+
+} // namespace voip
+
+#endif // _VMEDIACLOCK_H_
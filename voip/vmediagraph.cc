@@ -0,0 +1,173 @@
+#include "vmediagraph.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+namespace {
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VCounter &edges_started = metrics.counter("voip_media_graph_edges_total", "Media graph edge changes applied to the conference bridge", "op=\"start\"");
+voip::VCounter &edges_stopped = metrics.counter("voip_media_graph_edges_total", "Media graph edge changes applied to the conference bridge", "op=\"stop\"");
+voip::VCounter &edges_kept = metrics.counter("voip_media_graph_edges_total", "Media graph edge changes applied to the conference bridge", "op=\"keep\"");
+voip::VCounter &resampled_ports = metrics.counter("voip_media_resampled_ports_total", "Media graph ports whose clock rate differs from the conference bridge");
+voip::VCounter &edge_errors = metrics.counter("voip_media_graph_edge_errors_total", "Media graph edges that failed to connect or disconnect");
+
+} // namespace
+
+voip::VMediaGraph::VMediaGraph()
+{
+}
+
+voip::VMediaGraph::~VMediaGraph()
+{
+}
+
+void voip::VMediaGraph::setNode(const std::string &name, const pj::AudioMedia &media)
+{
+    nodes_[name] = media;
+}
+
+void voip::VMediaGraph::removeNode(const std::string &name)
+{
+    nodes_.erase(name);
+}
+
+void voip::VMediaGraph::detachNode(const std::string &name)
+{
+    nodes_.erase(name);
+    for (auto it = applied_.begin(); it != applied_.end();) {
+        if (it->first.first == name || it->first.second == name) {
+            it = applied_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+bool voip::VMediaGraph::hasNode(const std::string &name) const
+{
+    return nodes_.count(name) > 0;
+}
+
+void voip::VMediaGraph::connect(const std::string &src, const std::string &dst)
+{
+    edges_.insert(Edge(src, dst));
+}
+
+void voip::VMediaGraph::disconnect(const std::string &src, const std::string &dst)
+{
+    edges_.erase(Edge(src, dst));
+}
+
+unsigned voip::VMediaGraph::apply()
+{
+    unsigned failed = 0;
+
+    // 先断开: 不再声明的边, 端点不存在的边, 端点端口已变化的边
+    for (auto it = applied_.begin(); it != applied_.end();) {
+        const Edge &edge = it->first;
+        auto src = nodes_.find(edge.first);
+        auto dst = nodes_.find(edge.second);
+        bool keep = edges_.count(edge) > 0 && src != nodes_.end() && dst != nodes_.end()
+                    && src->second.getPortId() == it->second.src.getPortId()
+                    && dst->second.getPortId() == it->second.dst.getPortId();
+        if (keep) {
+            edges_kept.inc();
+            ++it;
+            continue;
+        }
+        if (!stop(edge, it->second)) {
+            ++failed;
+        }
+        it = applied_.erase(it);
+    }
+
+    // 再连接新增的边, 端点未就绪的边等节点出现后再连
+    unsigned bridge_rate = 0;
+    for (const Edge &edge : edges_) {
+        if (applied_.count(edge)) {
+            continue;
+        }
+        auto src = nodes_.find(edge.first);
+        auto dst = nodes_.find(edge.second);
+        if (src == nodes_.end() || dst == nodes_.end()) {
+            continue;
+        }
+        try {
+            if (bridge_rate == 0) {
+                bridge_rate = pj::AudioMedia::getPortInfoFromId(0).format.clockRate;
+            }
+            checkRate(edge.first, src->second, bridge_rate);
+            checkRate(edge.second, dst->second, bridge_rate);
+            src->second.startTransmit(dst->second);
+            applied_.insert(std::make_pair(edge, Applied {src->second, dst->second}));
+            errors_.erase(edge);
+            edges_started.inc();
+        }
+        catch (const pj::Error &err) {
+            VLOG_ERROR << ">>> media graph: connect " << edge.first << " -> " << edge.second << " failed: " << err.info();
+            errors_[edge] = err.info();
+            edge_errors.inc();
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+void voip::VMediaGraph::teardown()
+{
+    for (const auto &applied : applied_) {
+        stop(applied.first, applied.second);
+    }
+    applied_.clear();
+}
+
+std::vector<voip::VEdgeStatus> voip::VMediaGraph::status() const
+{
+    std::vector<VEdgeStatus> result;
+    for (const Edge &edge : edges_) {
+        VEdgeStatus s;
+        s.src = edge.first;
+        s.dst = edge.second;
+        s.connected = applied_.count(edge) > 0;
+        auto err = errors_.find(edge);
+        if (err != errors_.end()) {
+            s.error = err->second;
+        }
+        result.push_back(s);
+    }
+    return result;
+}
+
+bool voip::VMediaGraph::stop(const Edge &edge, const Applied &applied)
+{
+    // 呼叫已结束时会议桥可能已拆掉呼叫端口, 断开失败只记 DEBUG
+    try {
+        applied.src.stopTransmit(applied.dst);
+        edges_stopped.inc();
+        return true;
+    }
+    catch (const pj::Error &err) {
+        VLOG_DEBUG << ">>> media graph: disconnect " << edge.first << " -> " << edge.second << ": " << err.info();
+        errors_[edge] = err.info();
+        edge_errors.inc();
+        return false;
+    }
+}
+
+void voip::VMediaGraph::checkRate(const std::string &name, const pj::AudioMedia &media, unsigned bridge_rate)
+{
+    int port_id = media.getPortId();
+    auto checked = rate_checked_.find(name);
+    if (checked != rate_checked_.end() && checked->second == port_id) {
+        return;
+    }
+    rate_checked_[name] = port_id;
+    unsigned rate = media.getPortInfo().format.clockRate;
+    if (rate != bridge_rate) {
+        resampled_ports.inc();
+        VLOG_INFO << ">>> media graph: " << name << " runs at " << rate << " Hz, bridge at " << bridge_rate
+                  << " Hz, resampled every frame";
+    }
+}
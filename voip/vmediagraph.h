@@ -0,0 +1,93 @@
+#ifndef _VMEDIAGRAPH_H_
+#define _VMEDIAGRAPH_H_
+
+#include <pjsua2.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace voip {
+
+// 一条边的应用结果
+struct VEdgeStatus
+{
+    std::string src;
+    std::string dst;
+    bool connected = false;
+    std::string error; // 最近一次 startTransmit / stopTransmit 失败的原因
+};
+
+// 一路呼叫的声明式媒体路由
+// 节点为具名的会议桥端口 (call, ai_in, ai_out, recorder, recorder_agent, prompt, mixer, capture, playback ...), 边为单向 src -> dst
+// 调用方只声明期望的节点和边, apply() 与已连接的边做差集: 只断开不再需要或端口已变化的边, 只连接新增的边
+// re-INVITE 后呼叫端口不变时已有连接保持不动; 每条边单独记录错误, 一条失败不影响其它边
+// 连接时检查两端端口与会议桥 (0 号端口) 的采样率, 不同则会议桥每帧重采样, 计入 voip_media_resampled_ports_total
+class VMediaGraph
+{
+public:
+    VMediaGraph();
+    ~VMediaGraph();
+
+    // 新增或替换节点, 保存端口的副本; 端口 id 变化的节点上已连接的边在 apply() 时重连
+    void
+    setNode(const std::string &name, const pj::AudioMedia &media);
+
+    // 删除节点, 与其相连的边在 apply() 时断开, 声明保留, 节点重新出现后再连
+    void
+    removeNode(const std::string &name);
+
+    // 端口已被会议桥移除 (呼叫结束): 删除节点, 相关的边直接作废, 不再 stopTransmit
+    void
+    detachNode(const std::string &name);
+
+    bool
+    hasNode(const std::string &name) const;
+
+    void
+    connect(const std::string &src, const std::string &dst);
+
+    void
+    disconnect(const std::string &src, const std::string &dst);
+
+    // 差量应用, 返回本次失败的边数
+    unsigned
+    apply();
+
+    // 断开所有已连接的边, 节点和边的声明保留
+    void
+    teardown();
+
+    std::vector<VEdgeStatus>
+    status() const;
+
+private:
+    using Edge = std::pair<std::string, std::string>;
+
+    // 已连接的边, 保存连接时两端端口的副本, 节点删除后仍能断开
+    struct Applied
+    {
+        pj::AudioMedia src;
+        pj::AudioMedia dst;
+    };
+
+    // 断开一条已连接的边, 失败时记录到 errors_ 并返回 false
+    bool
+    stop(const Edge &edge, const Applied &applied);
+
+    // 节点端口采样率与会议桥不同时计数并记录, 同一节点端口只计一次
+    void
+    checkRate(const std::string &name, const pj::AudioMedia &media, unsigned bridge_rate);
+
+    std::map<std::string, pj::AudioMedia> nodes_;
+    std::set<Edge> edges_;
+    std::map<Edge, Applied> applied_;
+    std::map<Edge, std::string> errors_;
+    std::map<std::string, int> rate_checked_; // 节点名 -> 已检查的端口 id
+};
+
+} // namespace voip
+
+#endif // _VMEDIAGRAPH_H_
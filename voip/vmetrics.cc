@@ -0,0 +1,254 @@
+#include "vmetrics.h"
+#include "vlog.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+const uint64_t voip::VHistogram::BOUNDS_US[voip::VHistogram::BUCKETS] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000};
+
+void voip::VHistogram::observeUs(uint64_t us)
+{
+    unsigned i = 0;
+    while (i < BUCKETS && us > BOUNDS_US[i]) {
+        ++i;
+    }
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(us, std::memory_order_relaxed);
+}
+
+voip::VMetrics &voip::VMetrics::instance()
+{
+    static VMetrics metrics;
+    return metrics;
+}
+
+voip::VMetrics::Entry &voip::VMetrics::find(const std::string &name, const std::string &help,
+                                            const std::string &labels, Type type)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Entry &e : entries_) {
+        if (e.name == name && e.labels == labels) {
+            return e;
+        }
+    }
+    entries_.emplace_back();
+    Entry &e = entries_.back();
+    e.name = name;
+    e.help = help;
+    e.labels = labels;
+    e.type = type;
+    return e;
+}
+
+voip::VCounter &voip::VMetrics::counter(const std::string &name, const std::string &help, const std::string &labels)
+{
+    return find(name, help, labels, COUNTER).counter;
+}
+
+voip::VGauge &voip::VMetrics::gauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+    return find(name, help, labels, GAUGE).gauge;
+}
+
+voip::VHistogram &voip::VMetrics::histogram(const std::string &name, const std::string &help, const std::string &labels)
+{
+    return find(name, help, labels, HISTOGRAM).histogram;
+}
+
+std::string voip::VMetrics::render() const
+{
+    static const char *TYPE_NAMES[] = {"counter", "gauge", "histogram"};
+
+    std::map<std::string, std::vector<const Entry *>> families;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const Entry &e : entries_) {
+            families[e.name].push_back(&e);
+        }
+    }
+
+    std::string out;
+    char line[512];
+    for (const auto &family : families) {
+        const Entry &first = *family.second.front();
+        out += "# HELP " + first.name + " " + first.help + "\n";
+        out += "# TYPE " + first.name + " " + TYPE_NAMES[first.type] + "\n";
+
+        for (const Entry *e : family.second) {
+            std::string braces = e->labels.empty() ? "" : "{" + e->labels + "}";
+            if (e->type == COUNTER) {
+                std::snprintf(line, sizeof(line), "%s%s %llu\n", e->name.c_str(), braces.c_str(),
+                              static_cast<unsigned long long>(e->counter.value()));
+                out += line;
+            }
+            else if (e->type == GAUGE) {
+                std::snprintf(line, sizeof(line), "%s%s %lld\n", e->name.c_str(), braces.c_str(),
+                              static_cast<long long>(e->gauge.value()));
+                out += line;
+            }
+            else {
+                std::string sep = e->labels.empty() ? "" : e->labels + ",";
+                uint64_t cumulative = 0;
+                for (unsigned i = 0; i <= VHistogram::BUCKETS; ++i) {
+                    cumulative += e->histogram.bucket(i);
+                    if (i < VHistogram::BUCKETS) {
+                        std::snprintf(line, sizeof(line), "%s_bucket{%sle=\"%g\"} %llu\n", e->name.c_str(), sep.c_str(),
+                                      VHistogram::BOUNDS_US[i] / 1e6, static_cast<unsigned long long>(cumulative));
+                    }
+                    else {
+                        std::snprintf(line, sizeof(line), "%s_bucket{%sle=\"+Inf\"} %llu\n", e->name.c_str(), sep.c_str(),
+                                      static_cast<unsigned long long>(cumulative));
+                    }
+                    out += line;
+                }
+                std::snprintf(line, sizeof(line), "%s_sum%s %g\n%s_count%s %llu\n",
+                              e->name.c_str(), braces.c_str(), e->histogram.sumUs() / 1e6,
+                              e->name.c_str(), braces.c_str(), static_cast<unsigned long long>(e->histogram.count()));
+                out += line;
+            }
+        }
+    }
+    return out;
+}
+
+voip::VMetricsServer::VMetricsServer()
+{
+}
+
+voip::VMetricsServer::~VMetricsServer()
+{
+    stop();
+}
+
+bool voip::VMetricsServer::start(const std::string &address, unsigned port)
+{
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        VLOG_ERROR << ">>> invalid metrics address " << address;
+        return false;
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        VLOG_ERROR << ">>> metrics socket failed: " << std::strerror(errno);
+        return false;
+    }
+    int on = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listen_fd_, 16) < 0) {
+        VLOG_ERROR << ">>> metrics listen on " << address << ":" << port << " failed: " << std::strerror(errno);
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    if (pipe(wake_fd_) < 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    thread_ = std::thread(&VMetricsServer::serveLoop, this);
+    VLOG_INFO << ">>> metrics listening on http://" << address << ":" << port << "/metrics";
+    return true;
+}
+
+void voip::VMetricsServer::stop()
+{
+    if (!thread_.joinable()) {
+        return;
+    }
+    char c = 0;
+    (void)!write(wake_fd_[1], &c, 1);
+    thread_.join();
+    close(listen_fd_);
+    close(wake_fd_[0]);
+    close(wake_fd_[1]);
+    listen_fd_ = wake_fd_[0] = wake_fd_[1] = -1;
+}
+
+void voip::VMetricsServer::serveLoop()
+{
+    pollfd fds[2];
+    fds[0].fd = listen_fd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_fd_[0];
+    fds[1].events = POLLIN;
+
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                handleClient(fd);
+                close(fd);
+            }
+        }
+    }
+}
+
+void voip::VMetricsServer::handleClient(int fd)
+{
+    // 抓取端请求很短, 一次读取请求行即可; 设超时避免慢客户端卡住监听线程
+    timeval tv = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    char req[1024];
+    ssize_t n = read(fd, req, sizeof(req) - 1);
+    if (n <= 0) {
+        return;
+    }
+    req[n] = '\0';
+
+    std::string body;
+    const char *status;
+    if (std::strncmp(req, "GET /metrics", 12) == 0) {
+        status = "200 OK";
+        body = VMetrics::instance().render();
+    }
+    else {
+        status = "404 Not Found";
+        body = "not found\n";
+    }
+
+    char header[256];
+    int len = std::snprintf(header, sizeof(header),
+                            "HTTP/1.1 %s\r\n"
+                            "Content-Type: text/plain; version=0.0.4\r\n"
+                            "Content-Length: %zu\r\n"
+                            "Connection: close\r\n\r\n",
+                            status, body.size());
+    std::string resp(header, len);
+    resp += body;
+
+    size_t off = 0;
+    while (off < resp.size()) {
+        // 抓取端中途断开时不能触发 SIGPIPE 杀掉进程
+        ssize_t w = ::send(fd, resp.data() + off, resp.size() - off, MSG_NOSIGNAL);
+        if (w <= 0) {
+            break;
+        }
+        off += w;
+    }
+}
@@ -0,0 +1,196 @@
+#ifndef _VMETRICS_H_
+#define _VMETRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace voip {
+
+class VCounter
+{
+public:
+    void
+    inc(uint64_t n = 1)
+    {
+        value_.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t
+    value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value_ {0};
+};
+
+class VGauge
+{
+public:
+    void
+    inc(int64_t n = 1)
+    {
+        value_.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    void
+    dec(int64_t n = 1)
+    {
+        value_.fetch_sub(n, std::memory_order_relaxed);
+    }
+
+    void
+    set(int64_t v)
+    {
+        value_.store(v, std::memory_order_relaxed);
+    }
+
+    int64_t
+    value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> value_ {0};
+};
+
+// 固定桶延迟直方图, 单位微秒, 输出时换算为秒
+class VHistogram
+{
+public:
+    static const unsigned BUCKETS = 12;
+    static const uint64_t BOUNDS_US[BUCKETS];
+
+    void
+    observeUs(uint64_t us);
+
+    uint64_t
+    bucket(unsigned i) const
+    {
+        return buckets_[i].load(std::memory_order_relaxed);
+    }
+
+    uint64_t
+    count() const
+    {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t
+    sumUs() const
+    {
+        return sum_us_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> buckets_[BUCKETS + 1] {};
+    std::atomic<uint64_t> count_ {0};
+    std::atomic<uint64_t> sum_us_ {0};
+};
+
+// 作用域计时, 析构时记入直方图
+class VScopedLatency
+{
+public:
+    explicit VScopedLatency(VHistogram &hist) :
+        hist_(hist),
+        start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~VScopedLatency()
+    {
+        hist_.observeUs(std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start_)
+                            .count());
+    }
+
+private:
+    VHistogram &hist_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// 指标注册表
+// 指标在启动阶段注册, 返回的引用一直有效; 调用方缓存引用, 热路径上只做原子操作
+class VMetrics
+{
+public:
+    static VMetrics &
+    instance();
+
+    // labels 形如 state="registered", 同名不同 labels 为同一指标族
+    VCounter &
+    counter(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    VGauge &
+    gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    VHistogram &
+    histogram(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    // Prometheus 文本格式
+    std::string
+    render() const;
+
+private:
+    enum Type {
+        COUNTER,
+        GAUGE,
+        HISTOGRAM
+    };
+
+    struct Entry
+    {
+        std::string name;
+        std::string help;
+        std::string labels;
+        Type type;
+        VCounter counter;
+        VGauge gauge;
+        VHistogram histogram;
+    };
+
+    Entry &
+    find(const std::string &name, const std::string &help, const std::string &labels, Type type);
+
+    mutable std::mutex mutex_;
+    std::deque<Entry> entries_;
+};
+
+// 嵌入式 HTTP 监听, 独立线程, GET /metrics 返回 VMetrics::render()
+// 只读原子量, 抓取不会触碰 pjsua 锁
+class VMetricsServer
+{
+public:
+    VMetricsServer();
+    ~VMetricsServer();
+
+    // 失败返回 false
+    bool
+    start(const std::string &address, unsigned port);
+
+    void
+    stop();
+
+private:
+    void
+    serveLoop();
+
+    void
+    handleClient(int fd);
+
+    int listen_fd_ = -1;
+    int wake_fd_[2] = {-1, -1};
+    std::thread thread_;
+};
+
+} // namespace voip
+
+#endif // _VMETRICS_H_
@@ -1,47 +1,247 @@
 #include "vaccount.h"
+#include "vaudiobudget.h"
 #include "vcall.h"
+#include "vconfig.h"
+#include "vcontrol.h"
+#include "vdialer.h"
+#include "vendpoint.h"
+#include "veventloop.h"
+#include "vlog.h"
+#include "vmediaclock.h"
+#include "vmetrics.h"
+#include "vrecorder.h"
+#include "vtrace.h"
 
 #include <pjsua2.hpp>
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <memory>
 #include <iostream>
-#include <limits>
+#include <sstream>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <vector>
 
 #define SIP_USER      "1003"
 #define SIP_DOMAIN    "192.168.10.51:5060"
 #define SIP_PASSWORD  "1003"
 #define SIP_REGISTRAR "sip:" SIP_DOMAIN
 
-int main()
+// 宽带模式下未配置 media.codecs 时的优先级: G.722 与 16 kHz Opus 在前, 窄带编解码器仅作兜底
+static const char *WIDEBAND_CODECS = "G722/16000,opus/48000,PCMA/8000,PCMU/8000";
+
+// media.codecs = PCMA/8000,PCMU/8000 时只启用列出的编解码器, 按顺序设置优先级, 其余禁用
+static void applyCodecConfig(pj::Endpoint &ep, const voip::VConfig &cfg, bool wideband)
 {
-    pj::Endpoint ep;
+    std::string codecs = cfg.getString("media.codecs", wideband ? WIDEBAND_CODECS : "");
+    if (codecs.empty()) {
+        return;
+    }
+
+    if (wideband) {
+        // Opus 以 16 kHz 单声道编码, 与会议桥同频, 不经过重采样
+        try {
+            pj::CodecOpusConfig opus = ep.getCodecOpusConfig();
+            opus.sample_rate = 16000;
+            opus.channel_cnt = 1;
+            ep.setCodecOpusConfig(opus);
+        }
+        catch (const pj::Error &err) {
+            VLOG_WARN << ">>> opus codec not configured: " << err.info();
+        }
+    }
+
+    std::vector<std::string> wanted;
+    std::stringstream ss(codecs);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t begin = item.find_first_not_of(' ');
+        size_t end = item.find_last_not_of(' ');
+        if (begin != std::string::npos) {
+            wanted.push_back(item.substr(begin, end - begin + 1));
+        }
+    }
+
+    for (const pj::CodecInfo &ci : ep.codecEnum2()) {
+        pj_uint8_t priority = 0;
+        for (size_t i = 0; i < wanted.size(); ++i) {
+            if (ci.codecId.compare(0, wanted[i].size(), wanted[i]) == 0) {
+                priority = static_cast<pj_uint8_t>(255 - i);
+                break;
+            }
+        }
+        ep.codecSetPriority(ci.codecId, priority);
+        VLOG_DEBUG << ">>> codec " << ci.codecId << " priority " << unsigned(priority);
+    }
+}
+
+// 常驻内存 (kB), 读取 /proc/self/status
+static long readStatusKb(const char *field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t len = std::char_traits<char>::length(field);
+    while (std::getline(status, line)) {
+        if (line.compare(0, len, field) == 0) {
+            return std::strtol(line.c_str() + len + 1, nullptr, 10);
+        }
+    }
+    return -1;
+}
+
+// 处理一行操作员命令, q 返回 false
+static bool handleCommand(voip::VAccount &acc, const std::string &command_line)
+{
+    if (command_line.empty()) {
+        return true;
+    }
+
+    char action = command_line[0];
+    if (action == 'q') {
+        return false;
+    }
+    else if (action == 'm') {
+        if (acc.cur_call) {
+            VLOG_ERROR << ">>> cannot make a new call. A call is already active.";
+            return true;
+        }
+        if (command_line.length() < 3 || command_line[1] != ' ') {
+            VLOG_ERROR << ">>> invalid format. Use: m <sip:user@domain>";
+            return true;
+        }
+        if (voip::VCall *call = acc.makeCall(command_line.substr(2))) {
+            acc.cur_call = call;
+        }
+    }
+    else if (action == 'h') {
+        if (!acc.cur_call) {
+            VLOG_ERROR << ">>> no active call to hang up";
+            return true;
+        }
+        VLOG_INFO << ">>> hanging up call";
+        pj::CallOpParam prm;
+        try {
+            acc.cur_call->hangup(prm);
+        }
+        catch (const pj::Error &err) {
+            VLOG_ERROR << ">>> failed to hang up call: " << err.info();
+        }
+    }
+    else {
+        VLOG_ERROR << ">>> unknown command: " << action;
+    }
+    return true;
+}
+
+// 周期状态行, 进程无人值守时也能从日志看到是否正常
+static void logStatus(voip::VAccount &acc)
+{
+    bool registered = false;
+    try {
+        registered = acc.isValid() && acc.getInfo().regIsActive;
+    }
+    catch (const pj::Error &) {
+    }
+    voip::VMetrics &metrics = voip::VMetrics::instance();
+    VLOG_INFO << ">>> status: " << acc.admission().callsInProgress() << " calls, registration "
+              << (registered ? "active" : "inactive") << ", "
+              << metrics.gauge("voip_ai_pending_requests", "AI requests waiting for a response").value()
+              << " AI requests pending, " << voip::VAudioBudget::instance().used() / 1024 << " KiB audio buffered";
+}
+
+// 用法: voip [voip.conf]
+int main(int argc, char *argv[])
+{
+    auto startup_begin = std::chrono::steady_clock::now();
+    voip::VEndpoint ep;
     std::unique_ptr<voip::VAccount> acc;
+    voip::VConfig cfg;
+    voip::VMetricsServer metrics_server;
+    voip::VMediaClock media_clock;
+
+    // 退出信号只经事件循环的 signalfd 送达, 须在创建任何线程之前屏蔽
+    voip::VEventLoop::blockSignals({SIGINT, SIGTERM});
+    voip::VEventLoop loop;
+
+    voip::VLog::start(VLOG_LEVEL_INFO);
+
+    if (argc > 1 && !cfg.load(argv[1])) {
+        voip::VLog::stop();
+        return 1;
+    }
+
+    if (cfg.getBool("metrics.enabled", true)) {
+        metrics_server.start(cfg.getString("metrics.address", "127.0.0.1"),
+                             cfg.getInt("metrics.port", 9464));
+    }
+
+    // VOIP_TRACE=<file> 开启呼叫建立时间线
+    if (const char *trace_path = std::getenv("VOIP_TRACE")) {
+        voip::VTrace::start(trace_path);
+    }
 
     try {
-        std::cout << "initializing Endpoint" << std::endl;
+        VLOG_INFO << "initializing Endpoint";
         ep.libCreate();
         pj::EpConfig ep_cfg;
+        ep_cfg.logConfig.writer = new voip::VPjLogWriter;
+        // 宽带: 会议桥和 AI 端口都跑 16 kHz, 配合宽带编解码器全程不重采样
+        bool wideband = cfg.getBool("media.wideband", false);
+        if (wideband) {
+            ep_cfg.medConfig.clockRate = 16000;
+            ep_cfg.medConfig.sndClockRate = 16000;
+            if (!cfg.has("ai.clock_rate")) {
+                cfg.set("ai.clock_rate", "16000");
+            }
+        }
         ep.libInit(ep_cfg);
 
-        pj::TransportConfig tcfg;
-        tcfg.port = 5060;
-        ep.transportCreate(PJSIP_TRANSPORT_UDP, tcfg);
+        ep.createTransports(cfg);
+
+        applyCodecConfig(ep, cfg, wideband);
 
         ep.libStart();
-        std::cout << "Pjsua2 library start" << std::endl;
+        VLOG_INFO << "Pjsua2 library start";
+
+        {
+#ifdef VOIP_AUDIO_ONLY
+            const char *profile = "audio-only";
+#else
+            const char *profile = "full";
+#endif
+            auto startup_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                  std::chrono::steady_clock::now() - startup_begin)
+                                  .count();
+            long rss_kb = readStatusKb("VmRSS");
+            VLOG_INFO << ">>> startup (" << profile << " build): " << startup_ms << " ms, rss " << rss_kb << " kB";
+
+            voip::VMetrics &metrics = voip::VMetrics::instance();
+            metrics.gauge("voip_startup_milliseconds", "Time from main() to libStart() completion").set(startup_ms);
+            metrics.gauge("voip_startup_rss_bytes", "Resident memory after libStart()").set(rss_kb * 1024);
+        }
 
         try {
             pj::AudDevManager &mgr = ep.audDevManager();
-            if (mgr.getDevCount() > 0) {
-                std::cout << ">>> default capture device: " << mgr.getCaptureDev() << std::endl;
-                std::cout << ">>> default playback device: " << mgr.getPlaybackDev() << std::endl;
+            if (cfg.getBool("media.headless", false)) {
+                // 纯 AI 呼叫不需要声卡, 会议桥由专用时钟驱动, 不依赖 null 声卡的时钟
+                VLOG_INFO << ">>> headless media: conference bridge driven by dedicated clock";
+                media_clock.start(mgr.setNoDev(), cfg);
+            }
+            else if (mgr.getDevCount() > 0) {
+                VLOG_INFO << ">>> default capture device: " << mgr.getCaptureDev();
+                VLOG_INFO << ">>> default playback device: " << mgr.getPlaybackDev();
             }
             else {
-                std::cout << ">>> no audio devices found. Using NULL audio device" << std::endl;
+                VLOG_INFO << ">>> no audio devices found. Using NULL audio device";
                 ep.audDevManager().setNullDev();
             }
         }
         catch (const pj::Error &err) {
-            std::cerr << ">>> error setting audio devices: " << err.info() << std::endl;
+            VLOG_ERROR << ">>> error setting audio devices: " << err.info();
             try {
                 ep.audDevManager().setNullDev();
             }
@@ -51,119 +251,106 @@ int main()
 
         pj::AccountConfig acc_cfg;
         acc_cfg.idUri = "sip:" SIP_USER "@" SIP_DOMAIN;
-        acc_cfg.regConfig.registrarUri = SIP_REGISTRAR;
+        acc_cfg.regConfig.registrarUri = SIP_REGISTRAR + ep.uriTransportParam();
+        acc_cfg.sipConfig.transportId = ep.sipTransportId();
         pj::AuthCredInfo cred("digest", "*", SIP_USER, 0, SIP_PASSWORD);
         acc_cfg.sipConfig.authCreds.push_back(cred);
 
         acc = std::make_unique<voip::VAccount>();
+        acc->configure(cfg);
         acc->create(acc_cfg);
-        std::cout << "*** Account created for " << acc_cfg.idUri << ". Registering..." << std::endl;
-
-        std::cout << "\nCommands:\n";
-        std::cout << "  m <sip:user@domain>  : 拨号\n";
-        std::cout << "  h                    : 挂断\n";
-        std::cout << "  q                    : 退出\n\n";
-
-        char cmd[100];
-        while (true) {
-            std::cout << "> ";
-            if (!std::cin.getline(cmd, sizeof(cmd))) {
-                if (std::cin.eof())
-                    break;
-                std::cin.clear();
-                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-                std::cerr << ">>> input error. please try again" << std::endl;
-                continue;
-            }
-
-            std::string command_line = cmd;
-            if (command_line.empty())
-                continue;
-
-            char action = command_line[0];
-
-            if (action == 'q') {
-                break;
-            }
-            else if (action == 'm') {
-                if (acc->cur_call) {
-                    std::cerr << ">>> cannot make a new call. A call is already active." << std::endl;
-                    continue;
-                }
-                if (command_line.length() < 3 || command_line[1] != ' ') {
-                    std::cerr << ">>> invalid format. Use: m <sip:user@domain>" << std::endl;
-                    continue;
-                }
-                std::string target_uri = command_line.substr(2);
-                std::cout << ">>> placing call to: " << target_uri << std::endl;
+        VLOG_INFO << "*** Account created for " << acc_cfg.idUri << ". Registering...";
 
-                voip::VCall *call = new voip::VCall(*acc);
-                pj::CallOpParam prm(true);
-
-                try {
-                    call->makeCall(target_uri, prm);
-                    acc->cur_call = call;
-                }
-                catch (const pj::Error &err) {
-                    std::cerr << ">>> failed to make call: " << err.info() << std::endl;
-                    delete call;
-                }
+        // 标准输入按行处理; 不能 epoll 的标准输入 (/dev/null, 普通文件) 时只能用信号退出
+        std::string input;
+        auto prompt = []() { std::cout << "> " << std::flush; };
+        bool interactive = loop.add(STDIN_FILENO, EPOLLIN, [&](uint32_t) {
+            char buf[256];
+            ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+            if (n <= 0) {
+                loop.stop();
+                return;
             }
-            else if (action == 'h') {
-                if (!acc->cur_call) {
-                    std::cerr << ">>> no active call to hang up" << std::endl;
-                    continue;
-                }
-                std::cout << ">>> hanging up call" << std::endl;
-                pj::CallOpParam prm;
-                try {
-                    acc->cur_call->hangup(prm);
-                }
-                catch (const pj::Error &err) {
-                    std::cerr << ">>> failed to hang up call: " << err.info() << std::endl;
+            input.append(buf, static_cast<size_t>(n));
+            size_t eol;
+            while ((eol = input.find('\n')) != std::string::npos) {
+                std::string command_line = input.substr(0, eol);
+                input.erase(0, eol + 1);
+                if (!handleCommand(*acc, command_line)) {
+                    loop.stop();
+                    return;
                 }
+                // 释放已断开的呼叫
+                acc->reapCalls();
             }
-            else {
-                std::cerr << ">>> unknown command: " << action << std::endl;
-            }
+            prompt();
+        });
+        if (interactive) {
+            std::cout << "\nCommands:\n";
+            std::cout << "  m <sip:user@domain>  : 拨号\n";
+            std::cout << "  h                    : 挂断\n";
+            std::cout << "  q                    : 退出\n\n";
+            prompt();
+        }
+        else {
+            VLOG_INFO << ">>> stdin is not interactive, stop with SIGINT / SIGTERM";
+        }
 
-            if (acc->cur_call) {
-                try {
-                    pj::CallInfo ci = acc->cur_call->getInfo();
-                    if (ci.state == PJSIP_INV_STATE_DISCONNECTED) {
-                        std::cout << ">>> detected disconnected call in main loop, attempting cleanup." << std::endl;
-                        delete acc->cur_call;
-                        acc->cur_call = nullptr;
-                    }
-                }
-                catch (const pj::Error &err) {
-                    std::cerr << ">>> error checking call state in main loop (might be already deleted): " << err.info() << std::endl;
-                    acc->cur_call = nullptr;
-                }
-            }
+        // 定时清理已断开的呼叫, 不再等操作员输入
+        long housekeeping_ms = std::max(10L, cfg.getInt("main.housekeeping_ms", 1000));
+        loop.addTimer(std::chrono::milliseconds(housekeeping_ms), [&]() { acc->reapCalls(); });
+        long status_sec = cfg.getInt("main.status_interval_sec", 60);
+        if (status_sec > 0) {
+            loop.addTimer(std::chrono::seconds(status_sec), [&]() { logStatus(*acc); });
+        }
+        // 编排脚本经 control.socket 批量操作呼叫, 与标准输入命令在同一线程上执行
+        voip::VControl control(loop, *acc);
+        if (!control.start(cfg)) {
+            VLOG_WARN << ">>> control socket disabled";
         }
 
-        std::cout << "shutting down" << std::endl;
-        if (acc->cur_call) {
-            std::cout << ">>> hanging up active call before exit..." << std::endl;
-            pj::CallOpParam prm;
-            try {
-                acc->cur_call->hangup(prm);
-            }
-            catch (const pj::Error &err) {
-            }
+        // dialer.targets 配置时启动外呼活动, 号码只写号码时拼上注册域
+        if (!cfg.has("dialer.domain")) {
+            cfg.set("dialer.domain", SIP_DOMAIN);
+        }
+        voip::VDialer dialer(loop, *acc);
+        if (dialer.start(cfg)) {
+            control.setDialer(&dialer);
+        }
+        else {
+            VLOG_ERROR << ">>> outbound campaign not started";
+        }
+
+        loop.addSignals({SIGINT, SIGTERM}, [&](int sig) {
+            VLOG_INFO << ">>> received " << strsignal(sig);
+            loop.stop();
+        });
+
+        loop.run();
+
+        VLOG_INFO << "shutting down";
+        control.stop();
+        if (acc->admission().callsInProgress() > 0) {
+            VLOG_INFO << ">>> hanging up active calls before exit...";
+            acc->hangupAll();
             pj_thread_sleep(500);
-            delete acc->cur_call;
-            acc->cur_call = nullptr;
         }
 
+        // 剩余呼叫随账号一起释放
         acc.reset();
+        // 写完录音并补好 WAV 头
+        voip::VRecordWriter::instance().stop();
 
+        media_clock.stop();
         ep.libDestroy();
-        std::cout << "Pjsua2 library destroy" << std::endl;
+        VLOG_INFO << "Pjsua2 library destroy";
+        metrics_server.stop();
+        voip::VTrace::stop();
+        voip::VLog::stop();
     }
     catch (const pj::Error &err) {
-        std::cerr << "[Exception]: " << err.info() << std::endl;
+        VLOG_ERROR << "[Exception]: " << err.info();
+        media_clock.stop();
         try {
             if (ep.libGetState() != PJSUA_STATE_NULL) {
                 ep.libDestroy();
@@ -171,6 +358,8 @@ int main()
         }
         catch (...) {
         }
+        voip::VTrace::stop();
+        voip::VLog::stop();
         return 1;
     }
 
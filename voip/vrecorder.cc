@@ -0,0 +1,769 @@
+#include "vrecorder.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <linux/io_uring.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+const size_t WAV_HEADER_BYTES = 44;
+const size_t BLOCK_ALIGN = 4096;
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VGauge &files_active = metrics.gauge("voip_record_files_active", "Recording files open or waiting to be finalized");
+voip::VCounter &bytes_written = metrics.counter("voip_record_bytes_total", "Recording bytes written to disk");
+voip::VCounter &bytes_dropped = metrics.counter("voip_record_dropped_bytes_total", "Recording bytes replaced by silence because the writer was behind");
+voip::VCounter &write_errors = metrics.counter("voip_record_write_errors_total", "Recording writes that failed");
+voip::VCounter &syscalls_uring = metrics.counter("voip_record_syscalls_total", "System calls made by the recording writer", "op=\"io_uring_enter\"");
+voip::VCounter &syscalls_pwrite = metrics.counter("voip_record_syscalls_total", "System calls made by the recording writer", "op=\"pwrite\"");
+voip::VCounter &syscalls_fallocate = metrics.counter("voip_record_syscalls_total", "System calls made by the recording writer", "op=\"fallocate\"");
+voip::VHistogram &batch_latency = metrics.histogram("voip_record_batch_seconds", "Time to write one batch of recording blocks");
+
+void
+put16(char *p, uint16_t v)
+{
+    p[0] = static_cast<char>(v & 0xff);
+    p[1] = static_cast<char>(v >> 8);
+}
+
+void
+put32(char *p, uint32_t v)
+{
+    put16(p, static_cast<uint16_t>(v & 0xffff));
+    put16(p + 2, static_cast<uint16_t>(v >> 16));
+}
+
+// 16 位 PCM 的 WAV 头; 未收尾的文件 data_bytes 为 0
+void
+wavHeader(char *out, unsigned clock_rate, unsigned channels, uint64_t data_bytes)
+{
+    uint32_t data = static_cast<uint32_t>(std::min<uint64_t>(data_bytes, 0xffffffffu - 36));
+    std::memcpy(out, "RIFF", 4);
+    put32(out + 4, 36 + data);
+    std::memcpy(out + 8, "WAVEfmt ", 8);
+    put32(out + 16, 16);
+    put16(out + 20, 1);
+    put16(out + 22, static_cast<uint16_t>(channels));
+    put32(out + 24, clock_rate);
+    put32(out + 28, clock_rate * channels * 2);
+    put16(out + 32, static_cast<uint16_t>(channels * 2));
+    put16(out + 34, 16);
+    std::memcpy(out + 36, "data", 4);
+    put32(out + 40, data);
+}
+
+// 写满 len 字节, 返回是否成功
+bool
+pwriteAll(int fd, const char *data, size_t len, uint64_t offset)
+{
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, static_cast<off_t>(offset));
+        syscalls_pwrite.inc();
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+struct voip::VRecordWriter::File
+{
+    int fd = -1;
+    std::string path;
+    unsigned clock_rate = 8000;
+    unsigned channels = 1;
+    uint64_t data_bytes = 0; // close 时设置
+    uint64_t allocated = 0;  // 已预分配到的偏移, 只在写入线程上访问
+    bool prealloc = true;    // 文件系统不支持 fallocate 时关闭
+    // 录音本身持有一个, 每个在途的块一个; 归零时收尾
+    std::atomic<unsigned> refs {1};
+    std::atomic<bool> failed {false};
+};
+
+struct voip::VRecordWriter::Block
+{
+    std::shared_ptr<File> file;
+    char *data = nullptr; // 为空时是关闭标记, 释放录音持有的引用
+    uint64_t offset = 0;
+    size_t len = 0;
+};
+
+// 最小的 io_uring 封装: 只用 IORING_OP_WRITE, 一批提交后等全部完成
+class voip::VRecordWriter::Uring
+{
+public:
+    ~Uring()
+    {
+        if (sq_ptr_ && sq_ptr_ != MAP_FAILED) {
+            munmap(sq_ptr_, sq_len_);
+        }
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_ && cq_ptr_ != MAP_FAILED) {
+            munmap(cq_ptr_, cq_len_);
+        }
+        if (sqes_ && sqes_ != MAP_FAILED) {
+            munmap(sqes_, sqes_len_);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    bool
+    setup(unsigned entries)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) {
+            return false;
+        }
+        entries_ = params.sq_entries;
+        sq_len_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_len_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) {
+            sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+        }
+        sq_ptr_ = mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED) {
+            return false;
+        }
+        cq_ptr_ = single ? sq_ptr_
+                         : mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED) {
+            return false;
+        }
+        sqes_len_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe *>(
+            mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED) {
+            return false;
+        }
+        char *sq = static_cast<char *>(sq_ptr_);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        char *cq = static_cast<char *>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    unsigned
+    entries() const
+    {
+        return entries_;
+    }
+
+    // 提交 blocks (不超过 entries()), 等全部完成, 每块恰好回调一次 done(block, res, recycle)
+    // 环出错时未提交的块按 -EIO 回调; 已提交却等不到完成的块按 -ECANCELED 回调且 recycle 为 false,
+    // 内核可能仍在读它的缓冲区, 调用方不得复用; 返回 false 表示环已不可用
+    template <typename Done>
+    bool
+    writeAll(const std::vector<Block *> &blocks, Done done)
+    {
+        size_t count = blocks.size();
+        unsigned tail = *sq_tail_;
+        for (size_t i = 0; i < count; ++i) {
+            Block *block = blocks[i];
+            unsigned index = tail & sq_mask_;
+            io_uring_sqe &sqe = sqes_[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_WRITE;
+            sqe.fd = block->file->fd;
+            sqe.addr = reinterpret_cast<uint64_t>(block->data);
+            sqe.len = static_cast<uint32_t>(block->len);
+            sqe.off = block->offset;
+            sqe.user_data = i;
+            sq_array_[index] = index;
+            ++tail;
+        }
+        __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+        // 完成顺序与提交顺序无关, 按 user_data 逐块记录
+        std::vector<bool> completed(count, false);
+        size_t reaped = 0;
+        auto reap = [&]() {
+            unsigned head = *cq_head_;
+            unsigned ready = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            for (; head != ready; ++head) {
+                io_uring_cqe &cqe = cqes_[head & cq_mask_];
+                size_t i = static_cast<size_t>(cqe.user_data);
+                if (i < count && !completed[i]) {
+                    completed[i] = true;
+                    ++reaped;
+                    done(blocks[i], cqe.res, true);
+                }
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        };
+
+        unsigned to_submit = static_cast<unsigned>(count);
+        unsigned backoff_us = 0;
+        bool ok = true;
+        while (reaped < count) {
+            // 一次调用提交整批并等全部完成
+            unsigned wait = static_cast<unsigned>(count - reaped);
+            int ret = static_cast<int>(
+                syscall(__NR_io_uring_enter, fd_, to_submit, wait, IORING_ENTER_GETEVENTS, nullptr, 0));
+            syscalls_uring.inc();
+            if (ret >= 0) {
+                to_submit -= std::min<unsigned>(to_submit, static_cast<unsigned>(ret));
+                backoff_us = 0;
+            }
+            else if (errno == EAGAIN || errno == EBUSY) {
+                // 内核资源不足或完成队列满: 先收走已完成的, 再退避重试
+                reap();
+                backoff_us = std::min(10000u, std::max(100u, backoff_us * 2));
+                std::this_thread::sleep_for(std::chrono::microseconds(backoff_us));
+                continue;
+            }
+            else if (errno != EINTR) {
+                VLOG_ERROR << ">>> io_uring_enter failed: " << std::strerror(errno);
+                ok = false;
+                break;
+            }
+            reap();
+        }
+        if (ok) {
+            return true;
+        }
+
+        // 内核按顺序取走 SQE, 未取走的是最后 to_submit 块: 收回后按失败回调, 由调用方同步补写
+        __atomic_store_n(sq_tail_, tail - to_submit, __ATOMIC_RELEASE);
+        for (size_t i = count - to_submit; i < count; ++i) {
+            completed[i] = true;
+            ++reaped;
+            done(blocks[i], -EIO, true);
+        }
+        // 已提交的块在完成队列上再等一会, 不再进入内核
+        for (unsigned waited_ms = 0; reaped < count && waited_ms < 1000; ++waited_ms) {
+            reap();
+            if (reaped < count) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!completed[i]) {
+                done(blocks[i], -ECANCELED, false);
+            }
+        }
+        return false;
+    }
+
+private:
+    int fd_ = -1;
+    unsigned entries_ = 0;
+    void *sq_ptr_ = nullptr;
+    void *cq_ptr_ = nullptr;
+    size_t sq_len_ = 0;
+    size_t cq_len_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_len_ = 0;
+    unsigned *sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned *sq_array_ = nullptr;
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+};
+
+voip::VRecordWriter &voip::VRecordWriter::instance()
+{
+    static VRecordWriter writer;
+    return writer;
+}
+
+voip::VRecordWriter::VRecordWriter()
+{
+}
+
+voip::VRecordWriter::~VRecordWriter()
+{
+    stop();
+    for (Block *block : free_) {
+        std::free(block->data);
+        delete block;
+    }
+}
+
+void voip::VRecordWriter::configure(const VConfig &cfg)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return;
+    }
+    stopped_ = false;
+    record_calls_ = cfg.getBool("record.calls", false);
+    directory_ = cfg.getString("record.dir", ".");
+    max_catchup_ = static_cast<unsigned>(std::max(0L, cfg.getInt("media.clock.max_catchup", 5)));
+    size_t block_kb = static_cast<size_t>(std::max(4L, cfg.getInt("record.block_kb", 64)));
+    block_bytes_ = (block_kb * 1024 + BLOCK_ALIGN - 1) / BLOCK_ALIGN * BLOCK_ALIGN;
+    prealloc_bytes_ = static_cast<uint64_t>(std::max(0L, cfg.getInt("record.prealloc_mb", 8))) * 1024 * 1024;
+    batch_ms_ = static_cast<unsigned>(std::max(1L, cfg.getInt("record.batch_ms", 20)));
+    max_pending_bytes_ = static_cast<size_t>(std::max(1L, cfg.getInt("record.max_pending_mb", 64))) * 1024 * 1024;
+
+    backend_name_ = cfg.getString("record.backend", "auto");
+    queue_depth_ = static_cast<unsigned>(std::max(8L, cfg.getInt("record.queue_depth", 256)));
+    threads_ = static_cast<unsigned>(std::max(1L, cfg.getInt("record.threads", 2)));
+}
+
+void voip::VRecordWriter::start()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_ || stopped_) {
+        return;
+    }
+    backend_ = THREADS;
+    if (backend_name_ == "auto" || backend_name_ == "io_uring") {
+        std::unique_ptr<Uring> uring(new Uring);
+        if (uring->setup(queue_depth_)) {
+            uring_ = std::move(uring);
+            backend_ = URING;
+        }
+        else {
+            VLOG_WARN << ">>> io_uring unavailable (" << std::strerror(errno) << "), recording with pwrite threads";
+        }
+    }
+    else if (backend_name_ != "threads") {
+        VLOG_WARN << ">>> unknown record.backend " << backend_name_ << ", using threads";
+    }
+
+    running_ = true;
+    if (backend_ == THREADS) {
+        startPool();
+    }
+    writer_ = std::thread(&VRecordWriter::run, this);
+    VLOG_INFO << ">>> recording writer: " << (backend_ == URING ? "io_uring" : "pwrite threads") << ", "
+              << block_bytes_ / 1024 << " KiB blocks, batch " << batch_ms_ << " ms";
+}
+
+void voip::VRecordWriter::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    cv_.notify_all();
+    writer_.join();
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        pool_running_ = false;
+    }
+    pool_cv_.notify_all();
+    for (std::thread &thread : pool_) {
+        thread.join();
+    }
+    pool_.clear();
+    uring_.reset();
+}
+
+voip::VRecordWriter::Backend voip::VRecordWriter::backend() const
+{
+    return backend_;
+}
+
+bool voip::VRecordWriter::recordCalls() const
+{
+    return record_calls_;
+}
+
+const std::string &voip::VRecordWriter::directory() const
+{
+    return directory_;
+}
+
+unsigned voip::VRecordWriter::maxCatchup() const
+{
+    return max_catchup_;
+}
+
+voip::VRecordWriter::Block *voip::VRecordWriter::takeBlock()
+{
+    size_t pending = pending_bytes_.load(std::memory_order_relaxed);
+    do {
+        if (pending + block_bytes_ > max_pending_bytes_) {
+            return nullptr;
+        }
+    } while (!pending_bytes_.compare_exchange_weak(pending, pending + block_bytes_, std::memory_order_relaxed));
+
+    {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        if (!free_.empty()) {
+            Block *block = free_.back();
+            free_.pop_back();
+            return block;
+        }
+    }
+    Block *block = new Block;
+    void *data = nullptr;
+    if (posix_memalign(&data, BLOCK_ALIGN, block_bytes_) != 0) {
+        delete block;
+        pending_bytes_.fetch_sub(block_bytes_, std::memory_order_relaxed);
+        return nullptr;
+    }
+    block->data = static_cast<char *>(data);
+    return block;
+}
+
+void voip::VRecordWriter::enqueue(Block *block)
+{
+    if (block->data) {
+        block->file->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    bool wake = false;
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_) {
+            wake = queue_.empty();
+            queue_.push_back(block);
+            queued = true;
+        }
+    }
+    if (!queued) {
+        // 写入线程已停 (退出时才关闭的录音): 在调用线程上同步写完
+        complete(block, !block->data || pwriteAll(block->file->fd, block->data, block->len, block->offset));
+        return;
+    }
+    // 一批只唤醒一次, 之后的块等 batch_ms 内一起写
+    if (wake) {
+        cv_.notify_one();
+    }
+}
+
+void voip::VRecordWriter::run()
+{
+    std::vector<Block *> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return !queue_.empty() || !running_; });
+            if (running_) {
+                cv_.wait_for(lock, std::chrono::milliseconds(batch_ms_), [this]() { return !running_; });
+            }
+            batch.swap(queue_);
+            if (batch.empty() && !running_) {
+                break;
+            }
+        }
+        writeBatch(batch);
+        batch.clear();
+    }
+}
+
+void voip::VRecordWriter::writeBatch(std::vector<Block *> &batch)
+{
+    VScopedLatency latency(batch_latency);
+    std::vector<Block *> data;
+    std::vector<Block *> closes;
+    for (Block *block : batch) {
+        if (block->data) {
+            preallocate(*block);
+            data.push_back(block);
+        }
+        else {
+            closes.push_back(block);
+        }
+    }
+
+    if (backend_ == URING) {
+        std::vector<Block *> chunk;
+        for (size_t i = 0; i < data.size(); i += chunk.size()) {
+            size_t n = std::min<size_t>(uring_->entries(), data.size() - i);
+            chunk.assign(data.begin() + i, data.begin() + i + n);
+            bool ring_ok = uring_->writeAll(chunk, [this](Block *block, int res, bool recycle) {
+                bool ok = res == static_cast<int>(block->len);
+                if (!ok) {
+                    // 短写或出错时同步补写剩余部分
+                    size_t done = res > 0 ? static_cast<size_t>(res) : 0;
+                    ok = pwriteAll(block->file->fd, block->data + done, block->len - done, block->offset + done);
+                }
+                complete(block, ok, recycle);
+            });
+            if (!ring_ok) {
+                // 本批剩下的和以后的块都交给 pwrite 线程
+                VLOG_ERROR << ">>> io_uring ring unusable, recording with pwrite threads";
+                uring_.reset();
+                backend_ = THREADS;
+                startPool();
+                data.erase(data.begin(), data.begin() + i + n);
+                writeThreads(data);
+                break;
+            }
+        }
+    }
+    else {
+        writeThreads(data);
+    }
+
+    // 关闭标记在本批的数据之后处理; 块还在 pwrite 线程上时由最后完成的块收尾
+    for (Block *block : closes) {
+        complete(block, true);
+    }
+}
+
+void voip::VRecordWriter::startPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if (pool_running_) {
+            return;
+        }
+        pool_running_ = true;
+    }
+    for (unsigned i = 0; i < threads_; ++i) {
+        pool_.emplace_back(&VRecordWriter::poolRun, this);
+    }
+}
+
+void voip::VRecordWriter::writeThreads(std::vector<Block *> &batch)
+{
+    if (batch.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        pool_queue_.insert(pool_queue_.end(), batch.begin(), batch.end());
+    }
+    pool_cv_.notify_all();
+}
+
+void voip::VRecordWriter::poolRun()
+{
+    for (;;) {
+        Block *block;
+        {
+            std::unique_lock<std::mutex> lock(pool_mutex_);
+            pool_cv_.wait(lock, [this]() { return !pool_queue_.empty() || !pool_running_; });
+            if (pool_queue_.empty()) {
+                return;
+            }
+            block = pool_queue_.back();
+            pool_queue_.pop_back();
+        }
+        complete(block, pwriteAll(block->file->fd, block->data, block->len, block->offset));
+    }
+}
+
+void voip::VRecordWriter::preallocate(Block &block)
+{
+    File &file = *block.file;
+    uint64_t end = block.offset + block.len;
+    if (!file.prealloc || prealloc_bytes_ == 0 || end <= file.allocated) {
+        return;
+    }
+    uint64_t length = std::max(prealloc_bytes_, end - file.allocated);
+    syscalls_fallocate.inc();
+    if (fallocate(file.fd, 0, static_cast<off_t>(file.allocated), static_cast<off_t>(length)) != 0) {
+        VLOG_DEBUG << ">>> no fallocate for " << file.path << ": " << std::strerror(errno);
+        file.prealloc = false;
+        return;
+    }
+    file.allocated += length;
+}
+
+void voip::VRecordWriter::complete(Block *block, bool ok, bool recycle)
+{
+    std::shared_ptr<File> file = std::move(block->file);
+    if (block->data) {
+        if (ok) {
+            bytes_written.inc(block->len);
+        }
+        else {
+            write_errors.inc();
+            if (!file->failed.exchange(true)) {
+                VLOG_ERROR << ">>> recording write failed for " << file->path;
+            }
+        }
+    }
+    if (recycle) {
+        freeBlock(block);
+    }
+    else {
+        // 缓冲区可能仍被内核读取, 有意不释放
+        pending_bytes_.fetch_sub(block_bytes_, std::memory_order_relaxed);
+        delete block;
+    }
+    if (file->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        finalize(*file);
+    }
+}
+
+void voip::VRecordWriter::finalize(File &file)
+{
+    char header[WAV_HEADER_BYTES];
+    wavHeader(header, file.clock_rate, file.channels, file.data_bytes);
+    bool ok = pwriteAll(file.fd, header, sizeof(header), 0);
+    // 去掉预分配多出的部分
+    if (ftruncate(file.fd, static_cast<off_t>(WAV_HEADER_BYTES + file.data_bytes)) != 0) {
+        ok = false;
+    }
+    ::close(file.fd);
+    file.fd = -1;
+    files_active.dec();
+    if (!ok || file.failed) {
+        VLOG_WARN << ">>> recording " << file.path << " finalized with errors";
+    }
+    else {
+        VLOG_DEBUG << ">>> recording " << file.path << " closed, " << file.data_bytes << " bytes";
+    }
+}
+
+void voip::VRecordWriter::freeBlock(Block *block)
+{
+    if (!block->data) {
+        delete block;
+        return;
+    }
+    block->len = 0;
+    pending_bytes_.fetch_sub(block_bytes_, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(free_mutex_);
+    free_.push_back(block);
+}
+
+voip::VRecording::VRecording()
+{
+}
+
+voip::VRecording::~VRecording()
+{
+    close();
+}
+
+bool voip::VRecording::open(const std::string &path, unsigned clock_rate, unsigned channels)
+{
+    close();
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        VLOG_ERROR << ">>> cannot create recording " << path << ": " << std::strerror(errno);
+        return false;
+    }
+    VRecordWriter::instance().start();
+    std::shared_ptr<VRecordWriter::File> file = std::make_shared<VRecordWriter::File>();
+    file->fd = fd;
+    file->path = path;
+    file->clock_rate = clock_rate;
+    file->channels = channels;
+    files_active.inc();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_ = std::move(file);
+    block_offset_ = 0;
+    data_bytes_ = 0;
+    block_ = VRecordWriter::instance().takeBlock();
+    // 第一块的开头留给 WAV 头, 块边界与文件偏移保持对齐
+    if (block_) {
+        wavHeader(block_->data, clock_rate, channels, 0);
+    }
+    fill_ = WAV_HEADER_BYTES;
+    return true;
+}
+
+void voip::VRecording::write(const int16_t *samples, size_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_) {
+        return;
+    }
+    VRecordWriter &writer = VRecordWriter::instance();
+    const char *src = reinterpret_cast<const char *>(samples);
+    size_t len = count * sizeof(int16_t);
+    data_bytes_ += len;
+    while (len > 0) {
+        size_t n = std::min(len, writer.block_bytes_ - fill_);
+        if (block_) {
+            std::memcpy(block_->data + fill_, src, n);
+        }
+        else {
+            // 积压超限: 这段不写, 文件里是预分配的零 (静音)
+            bytes_dropped.inc(n);
+        }
+        fill_ += n;
+        src += n;
+        len -= n;
+        if (fill_ == writer.block_bytes_) {
+            rotate();
+        }
+    }
+}
+
+void voip::VRecording::rotate()
+{
+    VRecordWriter &writer = VRecordWriter::instance();
+    if (block_ && fill_ > 0) {
+        block_->file = file_;
+        block_->offset = block_offset_;
+        block_->len = fill_;
+        writer.enqueue(block_);
+        block_ = nullptr;
+    }
+    block_offset_ += fill_;
+    fill_ = 0;
+    block_ = writer.takeBlock();
+}
+
+void voip::VRecording::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_) {
+        return;
+    }
+    VRecordWriter &writer = VRecordWriter::instance();
+    if (block_ && fill_ > 0) {
+        block_->file = file_;
+        block_->offset = block_offset_;
+        block_->len = fill_;
+        writer.enqueue(block_);
+    }
+    else if (block_) {
+        writer.freeBlock(block_);
+    }
+    block_ = nullptr;
+    file_->data_bytes = data_bytes_;
+
+    // 关闭标记带走录音持有的引用
+    VRecordWriter::Block *marker = new VRecordWriter::Block;
+    marker->file = std::move(file_);
+    writer.enqueue(marker);
+}
+
+bool voip::VRecording::isOpen()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_ != nullptr;
+}
+
+uint64_t voip::VRecording::bytes()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return data_bytes_;
+}
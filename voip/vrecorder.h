@@ -0,0 +1,187 @@
+#ifndef _VRECORDER_H_
+#define _VRECORDER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace voip {
+
+class VConfig;
+class VRecording;
+
+// 所有录音文件共用的写入线程 (record.*)
+// 媒体线程只把样本拷进按 record.block_kb 对齐的块, 写满一块交给写入线程;
+// 写入线程每 record.batch_ms 收一批, 所有录音的块在一次 io_uring_enter 里提交 (IORING_OP_WRITE, 带偏移),
+// 内核不支持 io_uring 或被禁用时交给 record.threads 个线程 pwrite
+// 文件按 record.prealloc_mb 分段 fallocate 预分配, 关闭时写入 WAV 头并截到实际长度
+// 积压超过 record.max_pending_mb 时丢弃新块, 文件中留下同长度的静音, 时间轴不变
+class VRecordWriter
+{
+public:
+    enum Backend {
+        URING,
+        THREADS
+    };
+
+    static VRecordWriter &
+    instance();
+
+    // 读取配置, 需在打开录音之前调用; 写入线程、io_uring 和 pwrite 线程等第一个录音打开时才创建
+    void
+    configure(const VConfig &cfg);
+
+    // 创建写入线程, VRecording::open 自动调用; stop 之后不再启动, 直到再次 configure
+    void
+    start();
+
+    // 写完所有已提交的块, 收尾已关闭的文件后退出; 仍打开的录音之后的写入在调用线程上同步完成
+    void
+    stop();
+
+    // start 之后有效
+    Backend
+    backend() const;
+
+    // record.calls: 每路呼叫录音到 record.dir
+    bool
+    recordCalls() const;
+
+    const std::string &
+    directory() const;
+
+    // media.clock.max_catchup: 会议桥时钟落后不超过该帧数时会逐帧补跑, 双声道录音据此判断是否缺帧
+    unsigned
+    maxCatchup() const;
+
+private:
+    friend class VRecording;
+
+    struct File;
+    struct Block;
+    class Uring;
+
+    VRecordWriter();
+    ~VRecordWriter();
+
+    // 取一个空块, 积压超限时返回空
+    Block *
+    takeBlock();
+
+    void
+    enqueue(Block *block);
+
+    void
+    run();
+
+    // 写一批块, 完成的块交给 complete
+    void
+    writeBatch(std::vector<Block *> &batch);
+
+    void
+    writeThreads(std::vector<Block *> &batch);
+
+    // 启动 pwrite 线程, 由写入线程或 configure 调用
+    void
+    startPool();
+
+    void
+    poolRun();
+
+    // 确保块所在区间已预分配
+    void
+    preallocate(Block &block);
+
+    // 块写完 (或为关闭标记), 文件的最后一个引用释放时收尾; recycle 为 false 时块的缓冲区不再复用
+    void
+    complete(Block *block, bool ok, bool recycle = true);
+
+    void
+    finalize(File &file);
+
+    void
+    freeBlock(Block *block);
+
+    Backend backend_ = THREADS;
+    size_t block_bytes_ = 64 * 1024;
+    uint64_t prealloc_bytes_ = 8 * 1024 * 1024;
+    unsigned batch_ms_ = 20;
+    size_t max_pending_bytes_ = 64 * 1024 * 1024;
+    bool record_calls_ = false;
+    std::string directory_ = ".";
+    unsigned max_catchup_ = 5;
+    std::string backend_name_ = "auto"; // record.backend
+    unsigned queue_depth_ = 256;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Block *> queue_;
+    bool running_ = false;
+    bool stopped_ = false;
+    std::thread writer_;
+    std::unique_ptr<Uring> uring_;
+
+    std::atomic<size_t> pending_bytes_ {0};
+
+    // 空块复用
+    std::mutex free_mutex_;
+    std::vector<Block *> free_;
+
+    // THREADS 后端的 pwrite 线程
+    std::mutex pool_mutex_;
+    std::condition_variable pool_cv_;
+    std::vector<Block *> pool_queue_;
+    unsigned threads_ = 2;
+    bool pool_running_ = false;
+    std::vector<std::thread> pool_;
+};
+
+// 一个 WAV 录音文件, 写入由 VRecordWriter 异步完成
+// write 可在媒体线程调用, 只做拷贝; close 可在任意线程调用
+class VRecording
+{
+public:
+    VRecording();
+    ~VRecording();
+
+    // 16 位 PCM, channels 声道交织
+    bool
+    open(const std::string &path, unsigned clock_rate, unsigned channels = 1);
+
+    // count 为样本数 (各声道合计)
+    void
+    write(const int16_t *samples, size_t count);
+
+    // 交出最后一块, 文件在写入线程上收尾
+    void
+    close();
+
+    bool
+    isOpen();
+
+    // 已写入的音频字节数 (不含头)
+    uint64_t
+    bytes();
+
+private:
+    // 交出当前块, 取下一块
+    void
+    rotate();
+
+    std::mutex mutex_;
+    std::shared_ptr<VRecordWriter::File> file_;
+    VRecordWriter::Block *block_ = nullptr;
+    uint64_t block_offset_ = 0; // 当前块在文件中的偏移
+    size_t fill_ = 0;           // 当前块已用字节
+    uint64_t data_bytes_ = 0;
+};
+
+} // namespace voip
+
+#endif // _VRECORDER_H_
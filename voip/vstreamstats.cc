@@ -0,0 +1,185 @@
+#include "vstreamstats.h"
+#include "vconfig.h"
+#include "vlog.h"
+#include "vmetrics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+namespace {
+
+voip::VMetrics &metrics = voip::VMetrics::instance();
+
+voip::VHistogram &rx_jitter = metrics.histogram("voip_rtp_jitter_seconds", "Receive interarrival jitter of active calls, sampled periodically");
+voip::VHistogram &rtt_hist = metrics.histogram("voip_rtp_rtt_seconds", "RTCP round-trip time of active calls, sampled periodically");
+voip::VHistogram &jb_delay = metrics.histogram("voip_jbuf_delay_seconds", "Jitter buffer average delay of active calls, sampled periodically");
+voip::VCounter &rx_packets = metrics.counter("voip_rtp_packets_total", "RTP packets seen by sampled calls", "type=\"received\"");
+voip::VCounter &rx_lost = metrics.counter("voip_rtp_packets_total", "RTP packets seen by sampled calls", "type=\"lost\"");
+voip::VCounter &sample_errors = metrics.counter("voip_stream_stat_errors_total", "Stream statistics queries that failed");
+voip::VHistogram &sample_latency = metrics.histogram("voip_stream_stat_query_seconds", "Time to query one call's stream statistics");
+
+} // namespace
+
+voip::VStreamSampler::VStreamSampler()
+{
+}
+
+voip::VStreamSampler::~VStreamSampler()
+{
+    stop();
+}
+
+void voip::VStreamSampler::start(const VConfig &cfg, Source source)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return;
+    }
+    interval_ = std::chrono::seconds(cfg.getInt("stats.interval_sec", 5));
+    history_ = static_cast<size_t>(std::max(1L, cfg.getInt("stats.history", 12)));
+    if (interval_.count() <= 0) {
+        return;
+    }
+    source_ = std::move(source);
+    running_ = true;
+    worker_ = std::thread(&VStreamSampler::run, this);
+    VLOG_INFO << ">>> stream stats every " << interval_.count() << " s, " << history_ << " samples per call";
+}
+
+void voip::VStreamSampler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    cv_.notify_one();
+    worker_.join();
+    for (const auto &ring : rings_) {
+        finish(ring.first, ring.second);
+    }
+    rings_.clear();
+}
+
+std::vector<voip::VStreamSample> voip::VStreamSampler::history(int call_id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<VStreamSample> out;
+    auto it = rings_.find(call_id);
+    if (it == rings_.end()) {
+        return out;
+    }
+    const Ring &ring = it->second;
+    out.reserve(ring.count);
+    size_t begin = (ring.next + ring.samples.size() - ring.count) % ring.samples.size();
+    for (size_t i = 0; i < ring.count; ++i) {
+        out.push_back(ring.samples[(begin + i) % ring.samples.size()]);
+    }
+    return out;
+}
+
+void voip::VStreamSampler::run()
+{
+    pj_thread_desc desc;
+    pj_thread_t *thread = nullptr;
+    std::memset(desc, 0, sizeof(desc));
+    pj_thread_register("stream_stats", desc, &thread);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        cv_.wait_for(lock, interval_);
+        if (!running_) {
+            break;
+        }
+        lock.unlock();
+        sampleAll();
+        lock.lock();
+    }
+}
+
+void voip::VStreamSampler::sampleAll()
+{
+    std::vector<VStreamRef> streams = source_();
+    std::set<int> live;
+    auto now = std::chrono::steady_clock::now();
+
+    for (const VStreamRef &ref : streams) {
+        live.insert(ref.call_id);
+        if (ref.med_idx < 0) {
+            continue;
+        }
+        // 一次查询只持有 pjsua 锁很短时间, 呼叫之间释放, 不在 mutex_ 下调用
+        pjsua_stream_stat stat;
+        pj_status_t status;
+        {
+            VScopedLatency latency(sample_latency);
+            status = pjsua_call_get_stream_stat(ref.call_id, static_cast<unsigned>(ref.med_idx), &stat);
+        }
+        if (status != PJ_SUCCESS) {
+            sample_errors.inc();
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Ring &ring = rings_[ref.call_id];
+        if (ring.samples.empty()) {
+            ring.samples.resize(history_);
+            ring.first = now;
+        }
+        VStreamSample &s = ring.samples[ring.next];
+        s.uptime_s = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(now - ring.first).count());
+        s.rx_pkt = stat.rtcp.rx.pkt;
+        s.rx_loss = stat.rtcp.rx.loss;
+        s.rx_jitter_us = static_cast<uint32_t>(std::max(0, stat.rtcp.rx.jitter.last));
+        s.rtt_us = static_cast<uint32_t>(std::max(0, stat.rtcp.rtt.last));
+        s.jb_delay_ms = static_cast<uint16_t>(stat.jbuf.avg_delay);
+        s.jb_prefetch = static_cast<uint16_t>(stat.jbuf.prefetch);
+        s.jb_lost = stat.jbuf.lost;
+        s.jb_discard = stat.jbuf.discard;
+        s.jb_empty = stat.jbuf.empty;
+        ring.next = (ring.next + 1) % ring.samples.size();
+        ring.count = std::min(ring.count + 1, ring.samples.size());
+
+        rx_jitter.observeUs(s.rx_jitter_us);
+        if (s.rtt_us > 0) {
+            rtt_hist.observeUs(s.rtt_us);
+        }
+        jb_delay.observeUs(static_cast<uint64_t>(s.jb_delay_ms) * 1000);
+        // pjsua 给出的是累计值, 指标按增量累加; 计数回退 (媒体重建) 时从新值开始
+        rx_packets.inc(s.rx_pkt >= ring.last_rx_pkt ? s.rx_pkt - ring.last_rx_pkt : s.rx_pkt);
+        rx_lost.inc(s.rx_loss >= ring.last_rx_loss ? s.rx_loss - ring.last_rx_loss : s.rx_loss);
+        ring.last_rx_pkt = s.rx_pkt;
+        ring.last_rx_loss = s.rx_loss;
+        ring.max_jitter_us = std::max(ring.max_jitter_us, s.rx_jitter_us);
+
+        VLOG_DEBUG << ">>> call " << ref.call_id << " rtp: pkt " << s.rx_pkt << " loss " << s.rx_loss
+                   << " jitter " << s.rx_jitter_us << " us rtt " << s.rtt_us << " us, jbuf " << s.jb_delay_ms
+                   << " ms (prefetch " << s.jb_prefetch << ", lost " << s.jb_lost << ", discard " << s.jb_discard
+                   << ", empty " << s.jb_empty << ")";
+    }
+
+    // 已不在快照中的呼叫视为结束
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = rings_.begin(); it != rings_.end();) {
+        if (live.count(it->first)) {
+            ++it;
+            continue;
+        }
+        finish(it->first, it->second);
+        it = rings_.erase(it);
+    }
+}
+
+void voip::VStreamSampler::finish(int call_id, const Ring &ring)
+{
+    if (ring.count == 0) {
+        return;
+    }
+    const VStreamSample &last = ring.samples[(ring.next + ring.samples.size() - 1) % ring.samples.size()];
+    VLOG_INFO << ">>> call " << call_id << " rtp summary: " << last.rx_pkt << " packets, " << last.rx_loss
+              << " lost, jitter max " << ring.max_jitter_us << " us, rtt " << last.rtt_us << " us, jbuf "
+              << last.jb_delay_ms << " ms (lost " << last.jb_lost << ", discard " << last.jb_discard << ")";
+}
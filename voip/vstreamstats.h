@@ -0,0 +1,98 @@
+#ifndef _VSTREAMSTATS_H_
+#define _VSTREAMSTATS_H_
+
+#include <pjsua2.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace voip {
+
+class VConfig;
+
+// 一次采样, 取自 pjsua_stream_stat (与 pj::StreamStat 同源), 只保留关联 AI 时延需要的字段
+struct VStreamSample
+{
+    uint32_t uptime_s = 0;     // 距呼叫首次采样的秒数
+    uint32_t rx_pkt = 0;
+    uint32_t rx_loss = 0;
+    uint32_t rx_jitter_us = 0; // 最近一次
+    uint32_t rtt_us = 0;       // 最近一次, 对端未发 RTCP 时为 0
+    uint16_t jb_delay_ms = 0;  // 抖动缓冲平均时延
+    uint16_t jb_prefetch = 0;
+    uint32_t jb_lost = 0;
+    uint32_t jb_discard = 0;
+    uint32_t jb_empty = 0;
+};
+
+// 被采样的流: 呼叫 id 与其音频媒体序号
+struct VStreamRef
+{
+    int call_id;
+    int med_idx;
+};
+
+// 周期性采集所有活动呼叫的 RTP / RTCP / 抖动缓冲统计
+// 后台线程每 stats.interval_sec 取一次呼叫快照, 逐个调用 pjsua_call_get_stream_stat,
+// 每次只持有 pjsua 锁一次查询的时间, 不触碰 VCall 对象, 不会阻塞会议桥的时钟
+// 每路呼叫保留最近 stats.history 次采样的定长环形缓冲, 呼叫结束时输出汇总
+class VStreamSampler
+{
+public:
+    using Source = std::function<std::vector<VStreamRef>()>;
+
+    VStreamSampler();
+    ~VStreamSampler();
+
+    void
+    start(const VConfig &cfg, Source source);
+
+    void
+    stop();
+
+    // 该呼叫的采样, 从旧到新
+    std::vector<VStreamSample>
+    history(int call_id);
+
+private:
+    struct Ring
+    {
+        std::vector<VStreamSample> samples; // 容量固定为 history_
+        size_t next = 0;
+        size_t count = 0;
+        std::chrono::steady_clock::time_point first;
+        uint32_t last_rx_pkt = 0;
+        uint32_t last_rx_loss = 0;
+        uint32_t max_jitter_us = 0;
+    };
+
+    void
+    run();
+
+    void
+    sampleAll();
+
+    // 呼叫结束, 输出汇总
+    void
+    finish(int call_id, const Ring &ring);
+
+    std::chrono::seconds interval_ {5};
+    size_t history_ = 12;
+    Source source_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool running_ = false;
+    std::thread worker_;
+    std::map<int, Ring> rings_;
+};
+
+} // namespace voip
+
+#endif // _VSTREAMSTATS_H_
@@ -0,0 +1,147 @@
+#include "vtrace.h"
+#include "vlog.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+const size_t TRACE_EVENTS_PER_THREAD = 16384;
+
+struct TraceEvent
+{
+    const char *name;
+    int64_t ts_us;
+    int call_id;
+    char ph;
+};
+
+// 单线程写入, 导出时按已发布的 count 读取
+struct TraceBuffer
+{
+    explicit TraceBuffer(int id) :
+        tid(id),
+        events(new TraceEvent[TRACE_EVENTS_PER_THREAD])
+    {
+    }
+
+    int tid;
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<size_t> count {0};
+};
+
+struct TraceState
+{
+    std::mutex mutex;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    std::string path;
+    int next_tid = 1;
+};
+
+TraceState &
+state()
+{
+    static TraceState s;
+    return s;
+}
+
+thread_local std::shared_ptr<TraceBuffer> tls_buffer;
+
+int64_t
+nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void
+record(char ph, const char *name, int call_id)
+{
+    if (!tls_buffer) {
+        TraceState &s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        tls_buffer = std::make_shared<TraceBuffer>(s.next_tid++);
+        s.buffers.push_back(tls_buffer);
+    }
+
+    size_t n = tls_buffer->count.load(std::memory_order_relaxed);
+    if (n >= TRACE_EVENTS_PER_THREAD) {
+        return;
+    }
+    TraceEvent &ev = tls_buffer->events[n];
+    ev.name = name;
+    ev.ts_us = nowUs();
+    ev.call_id = call_id;
+    ev.ph = ph;
+    tls_buffer->count.store(n + 1, std::memory_order_release);
+}
+
+} // namespace
+
+std::atomic<bool> voip::VTrace::enabled_ {false};
+
+void voip::VTrace::start(const std::string &path)
+{
+    TraceState &s = state();
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.path = path;
+    }
+    enabled_.store(true);
+    VLOG_INFO << ">>> tracing enabled, output: " << path;
+}
+
+void voip::VTrace::stop()
+{
+    if (!enabled_.exchange(false)) {
+        return;
+    }
+
+    TraceState &s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    FILE *fp = std::fopen(s.path.c_str(), "w");
+    if (!fp) {
+        VLOG_ERROR << ">>> failed to open trace output " << s.path;
+        return;
+    }
+
+    size_t total = 0;
+    std::fputs("{\"traceEvents\":[\n", fp);
+    for (const auto &buf : s.buffers) {
+        size_t n = buf->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; ++i) {
+            const TraceEvent &ev = buf->events[i];
+            std::fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"voip\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":%d",
+                         total ? ",\n" : "", ev.name, ev.ph, static_cast<long long>(ev.ts_us), buf->tid);
+            if (ev.ph == 'i') {
+                std::fprintf(fp, ",\"s\":\"t\",\"args\":{\"call\":%d}}", ev.call_id);
+            }
+            else {
+                std::fprintf(fp, ",\"id\":%d,\"args\":{\"call\":%d}}", ev.call_id, ev.call_id);
+            }
+            ++total;
+        }
+    }
+    std::fputs("\n],\"displayTimeUnit\":\"ms\"}\n", fp);
+    std::fclose(fp);
+    VLOG_INFO << ">>> wrote " << total << " trace events to " << s.path;
+}
+
+void voip::VTrace::instant(const char *name, int call_id)
+{
+    record('i', name, call_id);
+}
+
+void voip::VTrace::begin(const char *name, int call_id)
+{
+    record('b', name, call_id);
+}
+
+void voip::VTrace::end(const char *name, int call_id)
+{
+    record('e', name, call_id);
+}
@@ -0,0 +1,63 @@
+#ifndef _VTRACE_H_
+#define _VTRACE_H_
+
+#include <atomic>
+#include <string>
+
+// 未开启时每个埋点只有一次 relaxed 原子读
+#define VTRACE_INSTANT(name, call_id)                \
+    do {                                             \
+        if (voip::VTrace::enabled())                 \
+            voip::VTrace::instant(name, call_id);    \
+    } while (0)
+
+#define VTRACE_BEGIN(name, call_id)                  \
+    do {                                             \
+        if (voip::VTrace::enabled())                 \
+            voip::VTrace::begin(name, call_id);      \
+    } while (0)
+
+#define VTRACE_END(name, call_id)                    \
+    do {                                             \
+        if (voip::VTrace::enabled())                 \
+            voip::VTrace::end(name, call_id);        \
+    } while (0)
+
+namespace voip {
+
+// 呼叫建立时间线, 输出 Chrome trace JSON (chrome://tracing / Perfetto 可直接打开)
+// 事件写入各线程自己的定长缓冲区, 写满后丢弃; span 以 call id 为 async id, 可跨线程开始/结束
+// name 必须是字符串字面量, 只保存指针
+class VTrace
+{
+public:
+    // 开启记录, stop() 时写入 path
+    static void
+    start(const std::string &path);
+
+    // 停止记录并输出 JSON
+    static void
+    stop();
+
+    static bool
+    enabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    static void
+    instant(const char *name, int call_id);
+
+    static void
+    begin(const char *name, int call_id);
+
+    static void
+    end(const char *name, int call_id);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+} // namespace voip
+
+#endif // _VTRACE_H_